@@ -0,0 +1,105 @@
+#include <BinaryCommandWriter.hpp>
+#include <CommandPrinter.hpp>
+#include <Commands.hpp>
+#include <benchmark/benchmark.h>
+#include <ostream>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// Counts the output bytes and discards them.
+class CountingBuffer : public std::streambuf
+{
+    std::size_t written_ = 0;
+
+protected:
+    std::streamsize xsputn(const char*, std::streamsize count) override
+    {
+        written_ += static_cast<std::size_t>(count);
+        return count;
+    }
+
+    int_type overflow(int_type ch) override
+    {
+        written_++;
+        return traits_type::not_eof(ch);
+    }
+
+public:
+    [[nodiscard]] std::size_t written() const { return written_; }
+};
+
+// A batch of commands as decoded from a mixed stream: random ids, short command 1 data.
+static std::vector<Command> make_batch()
+{
+    std::mt19937 random(1);
+    std::vector<std::string> strings;
+    for (int i = 0; i < 64; i++)
+    {
+        strings.emplace_back(random() % 32, static_cast<char>('a' + random() % 26));
+    }
+    std::vector<Command> batch;
+    for (int i = 0; i < 1000; i++)
+    {
+        switch (random() % 3)
+        {
+        case 0:
+            batch.emplace_back(Command1{strings[random() % strings.size()]});
+            break;
+        case 1:
+            batch.emplace_back(Command2{static_cast<uint8_t>(random())});
+            break;
+        default:
+            batch.emplace_back(Command3{static_cast<uint16_t>(random()), static_cast<uint8_t>(random())});
+        }
+    }
+    return batch;
+}
+
+// Passes the batch to the handler and reports commands/s and output bytes per command.
+template <typename Handler>
+static void run_batches(benchmark::State& state, CountingBuffer& buffer, Handler& handler)
+{
+    static const auto batch = make_batch();
+    for (auto _ : state)
+    {
+        handler.handle_batch(batch);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch.size()));
+    state.counters["bytes_per_command"] =
+        static_cast<double>(buffer.written()) / static_cast<double>(state.iterations() * batch.size());
+}
+
+// The text format for comparison.
+static void BM_TextBatch(benchmark::State& state)
+{
+    auto buffer = CountingBuffer{};
+    auto stream = std::ostream{&buffer};
+    auto printer = CommandPrinter{stream};
+    run_batches(state, buffer, printer);
+}
+BENCHMARK(BM_TextBatch);
+
+static void BM_BinaryBatch(benchmark::State& state)
+{
+    auto buffer = CountingBuffer{};
+    auto stream = std::ostream{&buffer};
+    auto writer = BinaryCommandWriter{stream, {}};
+    run_batches(state, buffer, writer);
+}
+BENCHMARK(BM_BinaryBatch);
+
+static void BM_BinaryCompressedBatch(benchmark::State& state)
+{
+    if constexpr (!binary_format::compression_supported)
+    {
+        state.SkipWithError("built without zlib");
+        return;
+    }
+    auto buffer = CountingBuffer{};
+    auto stream = std::ostream{&buffer};
+    auto writer = BinaryCommandWriter{stream, {.compress = true}};
+    run_batches(state, buffer, writer);
+}
+BENCHMARK(BM_BinaryCompressedBatch);
@@ -0,0 +1,111 @@
+#include <CommandPrinter.hpp>
+#include <Commands.hpp>
+#include <InternTable.hpp>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// A stream buffer that discards everything, so only the formatting is measured.
+class DiscardBuffer : public std::streambuf
+{
+    std::array<char, 64 * 1024> buffer_{};
+    std::size_t written_ = 0;
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        written_ += static_cast<std::size_t>(pptr() - pbase());
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            sputc(traits_type::to_char_type(ch));
+        }
+        return traits_type::not_eof(ch);
+    }
+
+public:
+    DiscardBuffer() { setp(buffer_.data(), buffer_.data() + buffer_.size()); }
+
+    [[nodiscard]] std::size_t written() const { return written_ + static_cast<std::size_t>(pptr() - pbase()); }
+};
+
+// Calls the printer for every command and reports commands/s and output bytes/s.
+template <typename Print>
+static void run_printer(benchmark::State& state, Print print, InternTable* intern_table = nullptr)
+{
+    auto buffer = DiscardBuffer{};
+    auto stream = std::ostream{&buffer};
+    auto printer = CommandPrinter{stream};
+    printer.set_intern_table(intern_table);
+    for (auto _ : state)
+    {
+        print(printer);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(buffer.written()));
+}
+
+static void BM_PrinterCommand1(benchmark::State& state)
+{
+    const auto data = std::string(static_cast<std::size_t>(state.range(0)), 'X');
+    run_printer(state, [&data](const CommandPrinter& printer) { printer.handle_command_1(data); });
+}
+BENCHMARK(BM_PrinterCommand1)->Arg(0)->Arg(16)->Arg(255);
+
+// A vocabulary of 64 payloads of the given length printed as interned ids.
+static void BM_PrinterCommand1Interned(benchmark::State& state)
+{
+    auto payloads = std::vector<std::string>{};
+    for (int i = 0; i < 64; i++)
+    {
+        auto payload = std::string(static_cast<std::size_t>(state.range(0)), 'X');
+        payload[0] = static_cast<char>('A' + i % 26);
+        payload[1] = static_cast<char>('a' + i / 26);
+        payloads.push_back(payload);
+    }
+    auto table = InternTable{{.max_entries = 1024}};
+    std::size_t next = 0;
+    run_printer(
+        state,
+        [&payloads, &next](const CommandPrinter& printer) { printer.handle_command_1(payloads[next++ % 64]); },
+        &table);
+}
+BENCHMARK(BM_PrinterCommand1Interned)->Arg(16)->Arg(255);
+
+static void BM_PrinterCommand2(benchmark::State& state)
+{
+    run_printer(state, [](const CommandPrinter& printer) { printer.handle_command_2(0xab); });
+}
+BENCHMARK(BM_PrinterCommand2);
+
+static void BM_PrinterCommand3(benchmark::State& state)
+{
+    run_printer(state, [](const CommandPrinter& printer) { printer.handle_command_3(0x1234, 0xab); });
+}
+BENCHMARK(BM_PrinterCommand3);
+
+// A batch of mixed commands, items are batches.
+static void BM_PrinterBatch(benchmark::State& state)
+{
+    auto batch = std::vector<Command>{};
+    for (int i = 0; i < state.range(0); i++)
+    {
+        switch (i % 3)
+        {
+        case 0:
+            batch.emplace_back(Command1{"ABCDE-12345"});
+            break;
+        case 1:
+            batch.emplace_back(Command2{static_cast<uint8_t>(i)});
+            break;
+        default:
+            batch.emplace_back(Command3{static_cast<uint16_t>(i * 31), static_cast<uint8_t>(i)});
+            break;
+        }
+    }
+    run_printer(state, [&batch](const CommandPrinter& printer) { printer.handle_batch(batch); });
+}
+BENCHMARK(BM_PrinterBatch)->Arg(64);
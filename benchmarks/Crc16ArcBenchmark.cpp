@@ -0,0 +1,79 @@
+#include <Crc16Arc.hpp>
+#include <benchmark/benchmark.h>
+#include <boost/crc.hpp>
+#include <string>
+
+// Checksummed part of a packet is the 2 byte command id followed by 1..256 data bytes.
+static void payload_lengths(benchmark::internal::Benchmark* b)
+{
+    for (const int length : {1, 3, 5, 8, 16, 32, 64, 100, 128, 200, 257})
+    {
+        b->Arg(length);
+    }
+}
+
+static std::string make_payload(std::size_t length)
+{
+    auto data = std::string(length, '\0');
+    for (std::size_t i = 0; i < length; i++)
+    {
+        data[i] = static_cast<char>(i * 31 + 7);
+    }
+    return data;
+}
+
+// The previous PacketParser implementation - one byte at a time.
+static void BM_BoostCrcBytewise(benchmark::State& state)
+{
+    const auto data = make_payload(state.range(0));
+    for (auto _ : state)
+    {
+        boost::crc_16_type crc;
+        for (const char c : data)
+        {
+            crc.process_byte(c);
+        }
+        benchmark::DoNotOptimize(crc.checksum());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BoostCrcBytewise)->Apply(payload_lengths);
+
+static void BM_BoostCrc(benchmark::State& state)
+{
+    const auto data = make_payload(state.range(0));
+    for (auto _ : state)
+    {
+        boost::crc_16_type crc;
+        crc.process_bytes(data.data(), data.size());
+        benchmark::DoNotOptimize(crc.checksum());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BoostCrc)->Apply(payload_lengths);
+
+static void BM_Crc16ArcTable(benchmark::State& state)
+{
+    const auto data = make_payload(state.range(0));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(Crc16Arc::update_table(0, data));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Crc16ArcTable)->Apply(payload_lengths);
+
+static void BM_Crc16ArcClmul(benchmark::State& state)
+{
+    if (!Crc16Arc::clmul_supported())
+    {
+        state.SkipWithError("PCLMULQDQ is not supported by this CPU");
+    }
+    const auto data = make_payload(state.range(0));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(Crc16Arc::update_clmul(0, data));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Crc16ArcClmul)->Apply(payload_lengths);
@@ -0,0 +1,28 @@
+#include <HeaderScanner.hpp>
+#include <benchmark/benchmark.h>
+#include <string>
+
+// Line noise without any header, so every kernel has to scan the whole buffer.
+static std::string make_noise(std::size_t length)
+{
+    auto data = std::string(length, '\0');
+    for (std::size_t i = 0; i < length; i++)
+    {
+        data[i] = "CMxDC-M?"[(i * 7 + i / 5) % 8];
+    }
+    return data;
+}
+
+template <std::size_t (*find)(std::span<const char>, std::string_view)>
+static void BM_HeaderScanner(benchmark::State& state)
+{
+    const auto data = make_noise(state.range(0));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(find(data, "CMD"));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HeaderScanner<HeaderScanner::find_fallback>)->Arg(256)->Arg(64 << 10);
+BENCHMARK(BM_HeaderScanner<HeaderScanner::find_sse2>)->Arg(256)->Arg(64 << 10);
+BENCHMARK(BM_HeaderScanner<HeaderScanner::find_avx2>)->Arg(256)->Arg(64 << 10);
@@ -0,0 +1,251 @@
+#include <Crc16Arc.hpp>
+#include <PacketParser.hpp>
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Counts the commands without doing anything else, so only the parser itself is measured.
+struct CountingHandler
+{
+    uint64_t commands = 0;
+    uint64_t checksum = 0;
+
+    void handle_command_1(std::string_view data_1)
+    {
+        commands++;
+        checksum += data_1.size();
+    }
+
+    void handle_command_2(uint8_t data_2)
+    {
+        commands++;
+        checksum += data_2;
+    }
+
+    void handle_command_3(uint16_t data_3_1, uint8_t data_3_2)
+    {
+        commands++;
+        checksum += data_3_1 + data_3_2;
+    }
+};
+
+// A test stream and the number of valid packets in it.
+struct Stream
+{
+    std::string data;
+    uint64_t packets = 0;
+};
+
+// Size of the generated streams, large enough to not fit into L2 cache.
+static constexpr std::size_t stream_size = 4 << 20;
+
+static std::string make_packet(uint16_t cmd_id, std::string_view data, bool valid_crc = true)
+{
+    auto packet = std::string("CMD");
+    packet += static_cast<char>(cmd_id >> 8);
+    packet += static_cast<char>(cmd_id & 0xff);
+    packet += data;
+    auto crc = Crc16Arc::update(0, std::span(packet).subspan(3));
+    if (!valid_crc)
+    {
+        crc ^= 0x1234;
+    }
+    packet += static_cast<char>(crc >> 8);
+    packet += static_cast<char>(crc & 0xff);
+    return packet;
+}
+
+// A random valid packet of the given (or random if zero) id.
+static std::string make_random_packet(std::mt19937& random, uint16_t cmd_id = 0, bool valid_crc = true)
+{
+    if (cmd_id == 0)
+    {
+        cmd_id = static_cast<uint16_t>(std::uniform_int_distribution<int>(1, 3)(random));
+    }
+    auto byte = [&random] { return static_cast<char>(std::uniform_int_distribution<int>(0, 255)(random)); };
+    auto data = std::string();
+    switch (cmd_id)
+    {
+    case 1:
+        data += static_cast<char>(std::uniform_int_distribution<int>(0, 32)(random));
+        for (int i = 0; i < static_cast<uint8_t>(data[0]); i++)
+        {
+            data += static_cast<char>(std::uniform_int_distribution<int>('A', 'Z')(random));
+        }
+        break;
+    case 2:
+        data += byte();
+        break;
+    default:
+        data += byte();
+        data += byte();
+        data += byte();
+        break;
+    }
+    return make_packet(cmd_id, data, valid_crc);
+}
+
+// Concatenates packets from the generator until the stream is large enough.
+template <typename Generator>
+static Stream make_stream(Generator generator)
+{
+    auto stream = Stream{};
+    while (stream.data.size() < stream_size)
+    {
+        stream.packets += generator(stream.data);
+    }
+    return stream;
+}
+
+// Feeds the stream to a parser in chunks of the given size and reports packets/s and bytes/s.
+static void run_parser(benchmark::State& state, const Stream& stream, std::size_t chunk_size, bool bulk = true)
+{
+    auto handler = CountingHandler{};
+    const auto data = std::span<const char>(stream.data);
+    for (auto _ : state)
+    {
+        auto parser = PacketParser<CountingHandler>{handler};
+        parser.set_bulk_decoding(bulk);
+        for (std::size_t pos = 0; pos < data.size(); pos += chunk_size)
+        {
+            parser(data.subspan(pos, std::min(chunk_size, data.size() - pos)));
+        }
+        benchmark::DoNotOptimize(handler.checksum);
+    }
+    if (handler.commands != stream.packets * state.iterations())
+    {
+        state.SkipWithError("Unexpected number of parsed packets");
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * stream.data.size()));
+    state.counters["packets"] = benchmark::Counter(static_cast<double>(state.iterations() * stream.packets),
+                                                   benchmark::Counter::kIsRate);
+}
+
+// Typical socket read size.
+static constexpr std::size_t default_chunk_size = 64 << 10;
+
+// Short valid packets of a single type.
+static void BM_ParserValid(benchmark::State& state)
+{
+    std::mt19937 random(1);
+    const auto stream = make_stream(
+        [&random](std::string& data)
+        {
+            data += make_random_packet(random, 3);
+            return 1;
+        });
+    run_parser(state, stream, default_chunk_size);
+}
+BENCHMARK(BM_ParserValid);
+
+// Same stream through the state machine only, without the bulk decoding fast path.
+static void BM_ParserValidStateMachine(benchmark::State& state)
+{
+    std::mt19937 random(1);
+    const auto stream = make_stream(
+        [&random](std::string& data)
+        {
+            data += make_random_packet(random, 3);
+            return 1;
+        });
+    run_parser(state, stream, default_chunk_size, false);
+}
+BENCHMARK(BM_ParserValidStateMachine);
+
+// Valid packets with random ids and lengths.
+static void BM_ParserMixed(benchmark::State& state)
+{
+    std::mt19937 random(2);
+    const auto stream = make_stream(
+        [&random](std::string& data)
+        {
+            data += make_random_packet(random);
+            return 1;
+        });
+    run_parser(state, stream, default_chunk_size);
+}
+BENCHMARK(BM_ParserMixed);
+
+static void BM_ParserMixedStateMachine(benchmark::State& state)
+{
+    std::mt19937 random(2);
+    const auto stream = make_stream(
+        [&random](std::string& data)
+        {
+            data += make_random_packet(random);
+            return 1;
+        });
+    run_parser(state, stream, default_chunk_size, false);
+}
+BENCHMARK(BM_ParserMixedStateMachine);
+
+// Command 1 with the maximal length.
+static void BM_ParserMaxCommand1(benchmark::State& state)
+{
+    const auto packet = make_packet(1, "\xff" + std::string(255, 'X'));
+    const auto stream = make_stream(
+        [&packet](std::string& data)
+        {
+            data += packet;
+            return 1;
+        });
+    run_parser(state, stream, default_chunk_size);
+}
+BENCHMARK(BM_ParserMaxCommand1);
+
+// Mixed packets delivered in small reads. The argument is the read size.
+static void BM_ParserFragmented(benchmark::State& state)
+{
+    std::mt19937 random(2);
+    const auto stream = make_stream(
+        [&random](std::string& data)
+        {
+            data += make_random_packet(random);
+            return 1;
+        });
+    run_parser(state, stream, static_cast<std::size_t>(state.range(0)));
+}
+BENCHMARK(BM_ParserFragmented)->Arg(1)->Arg(7)->Arg(64)->Arg(1500);
+
+// Mixed packets, the argument is the percentage of packets with a wrong checksum.
+static void BM_ParserCrcFailures(benchmark::State& state)
+{
+    std::mt19937 random(3);
+    const auto failure_percent = static_cast<int>(state.range(0));
+    const auto stream = make_stream(
+        [&random, failure_percent](std::string& data)
+        {
+            const bool valid = std::uniform_int_distribution<int>(0, 99)(random) >= failure_percent;
+            data += make_random_packet(random, 0, valid);
+            return valid ? 1 : 0;
+        });
+    run_parser(state, stream, default_chunk_size);
+}
+BENCHMARK(BM_ParserCrcFailures)->Arg(10)->Arg(50)->Arg(100);
+
+// Valid packets separated by random garbage. The argument is the share of garbage bytes in percent.
+static void BM_ParserGarbage(benchmark::State& state)
+{
+    std::mt19937 random(4);
+    const auto garbage_percent = static_cast<std::size_t>(state.range(0));
+    const auto stream = make_stream(
+        [&random, garbage_percent](std::string& data)
+        {
+            const auto packet = make_random_packet(random);
+            const auto garbage_length = packet.size() * garbage_percent / (100 - garbage_percent);
+            for (std::size_t i = 0; i < garbage_length; i++)
+            {
+                // Contains header fragments to exercise the scanner's candidate checks. Complete headers may appear
+                // too, but a letter is never a valid command id.
+                data += "CM-xyzD!"[std::uniform_int_distribution<int>(0, 7)(random)];
+            }
+            data += packet;
+            return 1;
+        });
+    run_parser(state, stream, default_chunk_size);
+}
+BENCHMARK(BM_ParserGarbage)->Arg(50)->Arg(90)->Arg(99);
@@ -0,0 +1,240 @@
+#include <TcpServer.hpp>
+#include <UnixServer.hpp>
+#include <algorithm>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <unistd.h>
+#include <utility>
+
+// Per-read overhead of the session read loops, measured on reads of this many bytes in batches of reads_per_batch.
+static constexpr std::size_t read_size = 64;
+static constexpr std::size_t reads_per_batch = 1024;
+
+namespace
+{
+    // A completion handler bound to its arguments. Keeps the associated allocator of the handler like asio's binders.
+    template <typename Handler>
+    struct BoundHandler
+    {
+        Handler handler;
+        boost::system::error_code ec;
+        std::size_t length;
+
+        using allocator_type = boost::asio::associated_allocator_t<Handler>;
+
+        allocator_type get_allocator() const noexcept { return boost::asio::get_associated_allocator(handler); }
+
+        void operator()() { handler(ec, length); }
+    };
+
+    /**
+     * An AsyncReadStream over nothing: every read completes through the io_context like a socket read of queued data,
+     * but without the system call, so only the cost of the read loop itself is measured.
+     */
+    class MemoryStream
+    {
+        boost::asio::io_context& io_context_;
+        std::size_t remaining_ = 0;
+
+    public:
+        using executor_type = boost::asio::io_context::executor_type;
+
+        explicit MemoryStream(boost::asio::io_context& io_context) : io_context_{io_context} {}
+
+        executor_type get_executor() { return io_context_.get_executor(); }
+
+        // The next reads get this many bytes in total, then the stream ends.
+        void fill(std::size_t size) { remaining_ = size; }
+
+        template <typename Token>
+        auto async_read_some(boost::asio::mutable_buffer buffer, Token&& token)
+        {
+            return boost::asio::async_initiate<Token, void(boost::system::error_code, std::size_t)>(
+                [this, buffer](auto handler)
+                {
+                    const auto length = std::min(buffer.size(), remaining_);
+                    remaining_ -= length;
+                    const auto ec = length > 0 ? boost::system::error_code{} : boost::asio::error::eof;
+                    boost::asio::post(io_context_,
+                                      BoundHandler<decltype(handler)>{std::move(handler), ec, length});
+                },
+                token);
+        }
+    };
+
+    // Counts the received bytes, the buffer handler of the loops.
+    struct CountingSession
+    {
+        explicit CountingSession(boost::asio::io_context& io_context) : stream{io_context} {}
+
+        MemoryStream stream;
+        std::array<char, read_size> buffer{};
+        tcp_server::HandlerMemory memory;
+        std::size_t received = 0;
+
+        void handle(std::span<char> data) { received += data.size(); }
+    };
+
+    // The former session read loop: every read handler holds a new copy of the shared_ptr to the session.
+    struct CopyingSession : CountingSession, std::enable_shared_from_this<CopyingSession>
+    {
+        using CountingSession::CountingSession;
+
+        void read()
+        {
+            stream.async_read_some(boost::asio::buffer(buffer),
+                                   tcp_server::HandlerWithMemory(memory,
+                                                                 [self = shared_from_this()](
+                                                                     boost::system::error_code ec, std::size_t length)
+                                                                 { self->do_read(ec, length); }));
+        }
+
+        void do_read(boost::system::error_code ec, std::size_t length)
+        {
+            handle(std::span(buffer).first(length));
+            if (!ec)
+            {
+                read();
+            }
+        }
+    };
+
+    // The read loop of StreamServer sessions: the shared_ptr is moved from every read handler to the next one.
+    struct MovingSession : CountingSession
+    {
+        using CountingSession::CountingSession;
+
+        static void read(std::shared_ptr<MovingSession> self)
+        {
+            auto& session = *self;
+            session.stream.async_read_some(boost::asio::buffer(session.buffer),
+                                           tcp_server::HandlerWithMemory(session.memory,
+                                                                         [self = std::move(self)](
+                                                                             boost::system::error_code ec,
+                                                                             std::size_t length) mutable
+                                                                         { do_read(std::move(self), ec, length); }));
+        }
+
+        static void do_read(std::shared_ptr<MovingSession> self, boost::system::error_code ec, std::size_t length)
+        {
+            self->handle(std::span(self->buffer).first(length));
+            if (!ec)
+            {
+                read(std::move(self));
+            }
+        }
+    };
+
+    // The same loop as a coroutine with asio's own coroutine support (co_spawn and use_awaitable).
+    boost::asio::awaitable<void> awaitable_read_loop(std::shared_ptr<CountingSession> self)
+    {
+        auto& session = *self;
+        while (true)
+        {
+            boost::system::error_code ec;
+            const auto length = co_await session.stream.async_read_some(
+                boost::asio::buffer(session.buffer), boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            session.handle(std::span(session.buffer).first(length));
+            if (ec)
+            {
+                co_return;
+            }
+        }
+    }
+
+    // Runs a read loop over batches of reads, items are reads.
+    template <typename Session, typename Start>
+    void run_read_loop(benchmark::State& state, Start start)
+    {
+        boost::asio::io_context io_context{1};
+        auto session = std::make_shared<Session>(io_context);
+        while (state.KeepRunningBatch(reads_per_batch))
+        {
+            session->stream.fill(reads_per_batch * read_size);
+            start(session);
+            io_context.restart();
+            io_context.run();
+        }
+        benchmark::DoNotOptimize(session->received);
+        state.SetItemsProcessed(state.iterations());
+    }
+} // namespace
+
+static void BM_ReadLoopCopiedReference(benchmark::State& state)
+{
+    run_read_loop<CopyingSession>(state, [](const std::shared_ptr<CopyingSession>& session) { session->read(); });
+}
+BENCHMARK(BM_ReadLoopCopiedReference);
+
+static void BM_ReadLoopMovedReference(benchmark::State& state)
+{
+    run_read_loop<MovingSession>(state, [](const std::shared_ptr<MovingSession>& session)
+                                 { MovingSession::read(session); });
+}
+BENCHMARK(BM_ReadLoopMovedReference);
+
+static void BM_ReadLoopAwaitable(benchmark::State& state)
+{
+    run_read_loop<CountingSession>(state,
+                                   [](const std::shared_ptr<CountingSession>& session)
+                                   {
+                                       boost::asio::co_spawn(session->stream.get_executor(),
+                                                             awaitable_read_loop(session), boost::asio::detached);
+                                   });
+}
+BENCHMARK(BM_ReadLoopAwaitable);
+
+namespace
+{
+    struct CountingHandler
+    {
+        std::size_t& received;
+
+        void operator()(std::span<char> data) { received += data.size(); }
+    };
+
+    struct CountingFactory
+    {
+        std::size_t& received;
+
+        auto operator()() { return std::make_unique<CountingHandler>(received); }
+    };
+} // namespace
+
+// The same reads through a StreamServer session over a unix socket, including the system calls.
+static void BM_UnixSessionReads(benchmark::State& state)
+{
+    const auto path =
+        (std::filesystem::temp_directory_path() / ("session_benchmark_" + std::to_string(::getpid()))).string();
+    std::size_t received = 0;
+    auto factory = CountingFactory{received};
+    boost::asio::io_context io_context{1};
+    auto server = tcp_server::UnixServer<CountingFactory>{
+        io_context, factory, path, {.min_buffer_size = read_size, .max_buffer_size = read_size}};
+    auto client = tcp_server::stream_protocol::socket{io_context};
+    client.connect(tcp_server::stream_protocol::endpoint{path});
+    const auto data = std::string(reads_per_batch * read_size, 'x');
+    while (state.KeepRunningBatch(reads_per_batch))
+    {
+        boost::asio::write(client, boost::asio::buffer(data));
+        const auto expected = received + data.size();
+        while (received < expected)
+        {
+            io_context.run_one();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    server.stop();
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_UnixSessionReads);
@@ -0,0 +1,45 @@
+#include <Commands.hpp>
+#include <Telemetry.hpp>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Command 3 samples over the given number of keys, items are samples. Compare with BM_PrinterCommand3, the cost of
+// writing the same samples out as text.
+static void BM_TelemetryBatch(benchmark::State& state)
+{
+    std::mt19937 random(42);
+    auto batch = std::vector<Command>{};
+    for (int i = 0; i < 64; i++)
+    {
+        batch.emplace_back(Command3{static_cast<uint16_t>(random() % state.range(0)), static_cast<uint8_t>(random())});
+    }
+    auto table = TelemetryTable{};
+    const auto aggregator = TelemetryAggregator{table};
+    for (auto _ : state)
+    {
+        aggregator.handle_batch(batch);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch.size()));
+}
+BENCHMARK(BM_TelemetryBatch)->Arg(16)->Arg(65536);
+
+// Merging the shards of several threads with all the keys in use.
+static void BM_TelemetrySnapshot(benchmark::State& state)
+{
+    auto table = TelemetryTable{};
+    for (int shard = 0; shard < state.range(0); shard++)
+    {
+        auto& writer = table.add_shard();
+        for (uint32_t key = 0; key < TelemetryTable::key_count; key++)
+        {
+            writer.record(static_cast<uint16_t>(key), static_cast<uint8_t>(key), key);
+        }
+    }
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(table.snapshot());
+    }
+}
+BENCHMARK(BM_TelemetrySnapshot)->Arg(1)->Arg(4);
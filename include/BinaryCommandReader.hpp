@@ -0,0 +1,30 @@
+#pragma once
+#include <istream>
+#include <span>
+#include <vector>
+
+#include "Commands.hpp"
+
+/**
+ * Reads the blocks written by BinaryCommandWriter back as command records, e.g. to print them with CommandPrinter in
+ * the text format. Corrupt blocks and compressed blocks without zlib support are reported with std::runtime_error.
+ */
+class BinaryCommandReader
+{
+    std::istream& stream_;
+    std::vector<char> stored_;
+    std::vector<char> payload_;
+    std::vector<Command> commands_;
+
+public:
+    // @param stream the binary output, must outlive the reader.
+    explicit BinaryCommandReader(std::istream& stream);
+
+    /**
+     * Reads the next block.
+     *
+     * @return the commands of the block in the original order, empty at the end of the stream. The command 1 data
+     * refers to the reader's buffers and is only valid until the next call.
+     */
+    std::span<const Command> next();
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "BinaryFormat.hpp"
+#include "Commands.hpp"
+
+/**
+ * A command handler that writes the commands as binary blocks (see BinaryFormat.hpp) instead of text lines. The
+ * values are stored as they are, so there is no formatting on this side and no parsing on the consumer side, and the
+ * output is several times smaller than the text.
+ *
+ * The commands are collected into columns and written when the block is full, on flush and on destruction. Every block
+ * is written in one piece between two stream flushes, so with an OutputSink buffer stream it is handed over as a
+ * whole and never interleaved with the output of other threads, as long as the block size does not exceed the sink's
+ * flush size. Not thread safe.
+ */
+class BinaryCommandWriter
+{
+public:
+    struct Options
+    {
+        // Largest encoded block in bytes, header included.
+        std::size_t block_size = 64 * 1024;
+        // Compress the blocks with zlib. Requires binary_format::compression_supported.
+        bool compress = false;
+    };
+
+private:
+    std::ostream& stream_;
+    Options options_;
+    std::vector<uint8_t> kinds_;
+    std::vector<uint8_t> cmd_1_lengths_;
+    std::vector<char> cmd_1_data_;
+    std::vector<uint8_t> cmd_2_data_;
+    std::vector<uint16_t> cmd_3_data_1_;
+    std::vector<uint8_t> cmd_3_data_2_;
+    // Encoded size of the collected commands.
+    std::size_t size_ = 0;
+    // The encoded block, reused between the blocks.
+    std::vector<char> block_;
+    std::vector<char> compressed_;
+
+    // Makes room for a command of the given encoded size.
+    void reserve_(std::size_t command_size);
+    void write_block_();
+
+public:
+    /**
+     * @param stream the output stream, must outlive the writer.
+     * @param options block size of at least 1 KiB and compression, see Options.
+     */
+    BinaryCommandWriter(std::ostream& stream, Options options);
+    BinaryCommandWriter(const BinaryCommandWriter&) = delete;
+    BinaryCommandWriter& operator=(const BinaryCommandWriter&) = delete;
+    // Writes the collected commands.
+    ~BinaryCommandWriter();
+
+    void handle_command_1(std::string_view data_1);
+    void handle_command_2(uint8_t data_2);
+    void handle_command_3(uint16_t data_3_1, uint8_t data_3_2);
+    void handle_batch(std::span<const Command> batch);
+
+    // Writes the collected commands as a block and flushes the stream, e.g. periodically to bound the output latency.
+    void flush();
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Compact binary output of the decoded commands, an alternative to the CommandPrinter text (see BinaryCommandWriter
+ * and BinaryCommandReader).
+ *
+ * The output is a sequence of self-contained blocks. A block starts with a fixed header: the magic bytes, the flags
+ * byte, three reserved zero bytes, the stored payload size (u32) and the payload size before compression (u32). The
+ * payload holds the commands of the block column by column, all integers little endian:
+ *
+ *   u32 count                      number of commands in the block
+ *   u8 kind[count]                 position of every command's record in the Protocol table, keeps the order
+ *   u8 cmd_1_length[n1]            command 1 data lengths
+ *   char cmd_1_data[]              command 1 data, concatenated
+ *   u8 cmd_2_data[n2]
+ *   u16 cmd_3_data_1[n3]
+ *   u8 cmd_3_data_2[n3]
+ *
+ * Values of a kind are stored next to each other, so the blocks compress well.
+ */
+namespace binary_format
+{
+    inline constexpr std::array<char, 4> magic{'S', 'S', 'B', '1'};
+    inline constexpr std::size_t header_size = 4 + 4 + 4 + 4;
+    // The payload is compressed with zlib.
+    inline constexpr uint8_t compressed = 0x01;
+    // Largest block, header included. Bounds the memory a reader allocates for the sizes of a corrupt header.
+    inline constexpr std::size_t max_block_size = 64 * 1024 * 1024;
+
+    // true if the library is built with zlib (CMake option SERVER_ZLIB), required to write or read compressed blocks.
+#ifdef SERVER_WITH_ZLIB
+    inline constexpr bool compression_supported = true;
+#else
+    inline constexpr bool compression_supported = false;
+#endif
+} // namespace binary_format
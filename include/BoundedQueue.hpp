@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+
+/**
+ * Lock-free bounded multi-producer multi-consumer queue (Dmitry Vyukov's algorithm).
+ *
+ * Every cell carries a sequence number that tells producers and consumers whether the cell is ready for them, so
+ * push and pop only need a single compare-and-swap on their own position counter in the uncontended case.
+ *
+ * @tparam T element type. Should be cheap to copy, e.g. a pointer.
+ */
+template <typename T>
+class BoundedQueue
+{
+    // Keeps frequently modified counters on separate cache lines.
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    const std::size_t mask_;
+    alignas(cache_line_size) std::atomic<std::size_t> enqueue_pos_{0};
+    alignas(cache_line_size) std::atomic<std::size_t> dequeue_pos_{0};
+
+public:
+    /**
+     * @param capacity maximal number of queued elements. Rounded up to a power of two.
+     */
+    explicit BoundedQueue(std::size_t capacity) :
+        cells_{std::make_unique<Cell[]>(std::bit_ceil(std::max<std::size_t>(capacity, 2)))},
+        mask_{std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1}
+    {
+        for (std::size_t i = 0; i <= mask_; i++)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @return false if the queue is full.
+     */
+    bool try_push(const T& value)
+    {
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells_[pos & mask_];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // the cell still holds an element from the previous lap
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @return false if the queue is empty.
+     */
+    bool try_pop(T& value)
+    {
+        auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells_[pos & mask_];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // the cell was not filled yet
+            }
+            else
+            {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
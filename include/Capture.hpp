@@ -0,0 +1,156 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+/**
+ * Recording of the raw received data for offline replay.
+ *
+ * A capture file starts with the magic bytes followed by one record per read: the receive time (steady clock
+ * nanoseconds, u64), the session id (u32) and the data length (u32), all little endian, and the data itself. The
+ * read boundaries are kept, so a replay passes the parser exactly the same fragments as the server did.
+ */
+namespace capture
+{
+    inline constexpr std::array<char, 8> magic{'S', 'S', 'C', 'A', 'P', '0', '0', '1'};
+    inline constexpr std::size_t record_header_size = 8 + 4 + 4;
+
+    // A single read of a session.
+    struct Record
+    {
+        uint64_t time_ns = 0;
+        uint32_t session = 0;
+        std::span<const char> data;
+    };
+} // namespace capture
+
+/**
+ * An append-only capture file shared by all the event loop threads.
+ *
+ * Every append is a block of complete records, written under a lock: a block that takes several writes is still never
+ * interleaved with the records of other threads. An existing capture is replaced, as session ids are only unique within
+ * a run. Failures are reported with std::system_error.
+ */
+class CaptureFile
+{
+    int fd_ = -1;
+    std::atomic<uint32_t> sessions_{0};
+    std::mutex mutex_; // held for the writes of a whole block
+
+public:
+    explicit CaptureFile(const std::string& path);
+    CaptureFile(const CaptureFile&) = delete;
+    CaptureFile& operator=(const CaptureFile&) = delete;
+    ~CaptureFile();
+
+    // Writes the complete records at the end of the file.
+    void append(std::span<const char> records);
+
+    // @return a new session id, unique within the process.
+    uint32_t open_session() { return sessions_.fetch_add(1, std::memory_order_relaxed); }
+};
+
+/**
+ * Per-thread buffer of capture records. Records are collected in memory and appended to the file in large blocks, so
+ * the recording costs a copy per read and a write per buffer. Not thread safe.
+ */
+class CaptureWriter
+{
+    CaptureFile& file_;
+    std::size_t buffer_size_;
+    std::vector<char> buffer_;
+
+public:
+    /**
+     * @param file the file to write to. Must outlive the writer.
+     * @param buffer_size records are written out once this many bytes are collected.
+     */
+    explicit CaptureWriter(CaptureFile& file, std::size_t buffer_size = 1024 * 1024);
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+    // Writes the remaining records. Failures are reported to stderr.
+    ~CaptureWriter();
+
+    uint32_t open_session() { return file_.open_session(); }
+
+    // Records a read of the session, timestamped now.
+    void record(uint32_t session, std::span<const char> data);
+
+    // Writes the collected records to the file, e.g. periodically to bound the data lost on a crash.
+    void flush();
+};
+
+/**
+ * Buffer handler decorator that records every read of a connection before passing it on. Without a writer the data is
+ * passed on as is.
+ */
+template <typename BufferHandler>
+class CapturingHandler
+{
+    CaptureWriter* writer_;
+    uint32_t session_;
+    BufferHandler handler_;
+
+public:
+    /**
+     * @param writer capture writer of the thread, or nullptr if the session is not recorded.
+     * @param args constructor arguments of the decorated handler.
+     */
+    template <typename... Args>
+    explicit CapturingHandler(CaptureWriter* writer, Args&&... args) :
+        writer_{writer}, session_{writer != nullptr ? writer->open_session() : 0},
+        handler_(std::forward<Args>(args)...)
+    {
+    }
+
+    void operator()(std::span<const char> data)
+    {
+        if (writer_ != nullptr)
+        {
+            writer_->record(session_, data);
+        }
+        handler_(data);
+    }
+
+    [[nodiscard]] BufferHandler& handler() { return handler_; }
+
+    // Response frames of the decorated handler if it sends any, see tcp_server::ResponseSource.
+    [[nodiscard]] std::vector<char>& responses()
+        requires requires(BufferHandler& handler) { handler.responses(); }
+    {
+        return handler_.responses();
+    }
+};
+
+/**
+ * Reads the records of a capture file. The file is mapped into memory and the record data refer to the mapping, so
+ * reading costs no copies. Failures to open the file and invalid files are reported with exceptions.
+ */
+class CaptureReader
+{
+    MappedFile file_;
+    std::size_t position_ = capture::magic.size();
+
+public:
+    explicit CaptureReader(const std::string& path);
+
+    /**
+     * @return the next record, or nothing at the end of the file. The data stays valid while the reader exists.
+     */
+    std::optional<capture::Record> next();
+
+    /**
+     * @return true if the file ends with an incomplete record, e.g. because the server was killed while writing.
+     * Only meaningful at the end of the file, the incomplete record is not returned.
+     */
+    [[nodiscard]] bool truncated() const { return position_ < file_.data().size(); }
+};
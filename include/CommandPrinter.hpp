@@ -1,19 +1,44 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
-#include <string>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+#include "Commands.hpp"
+#include "InternTable.hpp"
 
 /**
  * A simple command handler that prints the received command id and data to the provided stream.
  *
+ * Lines are formatted directly into the stream buffer without temporary strings. Not thread safe - parsers running on
+ * different threads should use separate printers and streams, e.g. over per-thread OutputSink buffers. Implements both
+ * the single command and the batch interfaces, the output is the same.
+ *
+ * With an intern table, command 1 data is printed once per id: the first line of a payload (or of an id reassigned to
+ * another payload) defines the id as "0x0001 #<id> <data>", the following ones only refer to it as "0x0001 #<id>".
+ *
  * See PacketParser and CommandHandlerConcept for more details.
  */
 class CommandPrinter
 {
     std::ostream &stream_;
+    InternTable *intern_table_ = nullptr;
 
 public:
+    // Longest printed line: "0x0001 #<id> " with a 10 digit id, 255 bytes of command 1 data and the line end.
+    static constexpr std::size_t max_line_size = 7 + 12 + 255 + 1;
+
     explicit CommandPrinter(std::ostream &stream);
-    void handle_command_1(const std::string &data_1) const;
+
+    /**
+     * Prints command 1 data as ids of the table, see above. The table must outlive the printer, nullptr prints the
+     * data as is.
+     */
+    void set_intern_table(InternTable *table) { intern_table_ = table; }
+
+    void handle_command_1(std::string_view data_1) const;
     void handle_command_2(uint8_t data_2) const;
     void handle_command_3(uint16_t data_3_1, uint8_t data_3_2) const;
+    void handle_batch(std::span<const Command> batch) const;
 };
@@ -0,0 +1,94 @@
+#pragma once
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "Protocol.hpp"
+
+/**
+ * A handler that receives command 1 data as a std::string_view. The view is only valid during the call, so the parser
+ * does not need to allocate a string for every packet.
+ */
+template <typename Handler>
+concept StringViewCommandHandler = requires(Handler h, std::string_view view_data) {
+    { h.handle_command_1(view_data) } -> std::same_as<void>;
+};
+
+/**
+ * A handler that takes ownership of command 1 data as a std::string.
+ */
+template <typename Handler>
+concept StringCommandHandler = requires(Handler h, std::string str_data) {
+    { h.handle_command_1(std::move(str_data)) } -> std::same_as<void>;
+};
+
+// The packet protocol. Every command is a record of its decoded fields (passed to batch handlers as is) that also
+// describes its wire format (see protocol::Fields) and how it is passed to single command handlers (deliver). Adding a
+// command takes a new record and its entry in the Protocol table, the parser is generated from them.
+
+// length_u8 char[length]. The data is only valid during the handler call.
+struct Command1
+{
+    static constexpr uint16_t id = 1;
+    using fields = protocol::Fields<protocol::LengthPrefixed<protocol::U8>>;
+
+    std::string_view data_1;
+
+    template <typename Handler>
+    void deliver(Handler& handler) const
+        requires StringViewCommandHandler<Handler> || StringCommandHandler<Handler>
+    {
+        if constexpr (StringViewCommandHandler<Handler>)
+        {
+            handler.handle_command_1(data_1); // zero allocation path
+        }
+        else
+        {
+            handler.handle_command_1(std::string(data_1));
+        }
+    }
+};
+
+// data_u8
+struct Command2
+{
+    static constexpr uint16_t id = 2;
+    using fields = protocol::Fields<protocol::U8>;
+
+    uint8_t data_2;
+
+    template <typename Handler>
+    void deliver(Handler& handler) const
+        requires requires(uint8_t data) {
+            { handler.handle_command_2(data) } -> std::same_as<void>;
+        }
+    {
+        handler.handle_command_2(data_2);
+    }
+};
+
+// data_u16 data_u8
+struct Command3
+{
+    static constexpr uint16_t id = 3;
+    using fields = protocol::Fields<protocol::U16, protocol::U8>;
+
+    uint16_t data_3_1;
+    uint8_t data_3_2;
+
+    template <typename Handler>
+    void deliver(Handler& handler) const
+        requires requires(uint16_t data_1, uint8_t data_2) {
+            { handler.handle_command_3(data_1, data_2) } -> std::same_as<void>;
+        }
+    {
+        handler.handle_command_3(data_3_1, data_3_2);
+    }
+};
+
+using Protocol = protocol::Table<Command1, Command2, Command3>;
+
+// A decoded command of any type, the alternatives are in the Protocol table order.
+using Command = Protocol::variant;
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+/**
+ * CRC-16/ARC checksum engine (polynomial 0x8005 reflected, zero initial value, no final xor) used by the packet
+ * protocol. Produces the same values as boost::crc_16_type and crc16_arc from scripts/test_client.py.
+ *
+ * The checksum can be computed incrementally over several fragments of the data. The processing kernel is selected
+ * once at runtime: carry-less multiplication folding on CPUs with PCLMULQDQ, slicing-by-8 lookup tables otherwise.
+ */
+class Crc16Arc
+{
+    uint16_t crc_ = 0;
+
+public:
+    /**
+     * Adds the next fragment of the data to the checksum.
+     */
+    void process_bytes(std::span<const char> data) { crc_ = update(crc_, data); }
+
+    /**
+     * @return checksum of all the bytes processed so far.
+     */
+    [[nodiscard]] uint16_t checksum() const { return crc_; }
+
+    /**
+     * Continues the crc computation over the data using the best kernel available on this CPU.
+     *
+     * @param crc checksum of the preceding data, zero for the first fragment.
+     * @param data next fragment of the data.
+     * @return checksum of the preceding data and the fragment.
+     */
+    static uint16_t update(uint16_t crc, std::span<const char> data);
+
+    // Slicing-by-8 table kernel. Portable, always available.
+    static uint16_t update_table(uint16_t crc, std::span<const char> data);
+
+    // PCLMULQDQ folding kernel. Falls back to the table kernel when the CPU lacks the instructions or the data is too
+    // short for folding to pay off.
+    static uint16_t update_clmul(uint16_t crc, std::span<const char> data);
+
+    // true if update_clmul can use carry-less multiplication on this CPU.
+    static bool clmul_supported();
+};
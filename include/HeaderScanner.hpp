@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+/**
+ * Searches a received byte stream for the next packet header candidate.
+ *
+ * Candidates are located by comparing the first and the last header bytes at every position of a 16 or 32 byte
+ * block at once, and only the positions where both match are compared in full. The kernel is selected once at
+ * runtime: AVX2 when supported, SSE2 on other x86-64 CPUs and memchr-based search elsewhere.
+ */
+class HeaderScanner
+{
+public:
+    /**
+     * Finds the first complete occurrence of the header in the data using the best kernel available on this CPU.
+     *
+     * @param data bytes to search.
+     * @param header non-empty header value.
+     * @return position of the first occurrence. If there is none, the position of the shortest tail that can still
+     * become a header when more data arrives (data.size() - header.size() + 1, or 0 for shorter data). Everything
+     * before the returned position can be safely discarded.
+     */
+    static std::size_t find(std::span<const char> data, std::string_view header);
+
+    // Portable memchr-based kernel.
+    static std::size_t find_fallback(std::span<const char> data, std::string_view header);
+
+    // SSE2 kernel. Same as find_fallback on non-x86 CPUs.
+    static std::size_t find_sse2(std::span<const char> data, std::string_view header);
+
+    // AVX2 kernel. Falls back to find_sse2 when the CPU lacks the instructions.
+    static std::size_t find_avx2(std::span<const char> data, std::string_view header);
+
+    // true if find_avx2 can use AVX2 instructions on this CPU.
+    static bool avx2_supported();
+};
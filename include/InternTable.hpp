@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/**
+ * Interning of the command 1 payloads: producers tend to send a small vocabulary of strings over and over, so sinks can
+ * refer to a string by a small id once it has been seen (see CommandPrinter::set_intern_table).
+ *
+ * An open addressing hash table (linear probing, at most half full) over a fixed number of entries. The memory is
+ * allocated once: every entry has room for the longest payload (max_length bytes), so a table of N entries takes about
+ * N * 280 bytes. When all the entries are in use, a new payload replaces an entry chosen by the CLOCK policy (an entry
+ * that was looked up since the clock hand passed it last time gets a second chance), which keeps the frequently sent
+ * strings of a high cardinality client. The id of the replaced entry is given to the new payload, so a sink has to
+ * treat every added entry as a new definition of its id. Not thread safe.
+ */
+class InternTable
+{
+public:
+    // Longest payload, the command 1 length is a u8.
+    static constexpr std::size_t max_length = 255;
+
+    struct Options
+    {
+        // Number of entries, the table never holds more payloads.
+        std::size_t max_entries = 4096;
+        // Id of the first entry, the ids are first_id .. first_id + max_entries - 1. Tables of different threads can
+        // use disjoint ranges, so their ids do not collide in a shared output.
+        uint32_t first_id = 0;
+    };
+
+    // An interned payload.
+    struct Entry
+    {
+        uint32_t id;
+        // The stored copy of the payload, valid until the entry is replaced.
+        std::string_view data;
+        // true if the payload was not in the table, i.e. the id was assigned (or reassigned) to it by this call.
+        bool added;
+    };
+
+    /**
+     * Allocates the table. Throws std::invalid_argument if there are no entries or the ids do not fit a u32.
+     */
+    explicit InternTable(Options options);
+
+    /**
+     * Finds the payload or adds it, replacing an entry if the table is full. Throws std::invalid_argument for payloads
+     * longer than max_length.
+     */
+    Entry intern(std::string_view data);
+
+    /**
+     * @return the payload of the id, or nothing if the id is not in use.
+     */
+    [[nodiscard]] std::optional<std::string_view> find(uint32_t id) const;
+
+    [[nodiscard]] std::size_t size() const { return size_; }
+
+    // Lookups that found the payload.
+    [[nodiscard]] uint64_t hits() const { return hits_; }
+
+    // Entries replaced to make room for new payloads.
+    [[nodiscard]] uint64_t evictions() const { return evictions_; }
+
+private:
+    // An index slot refers to an entry, the hash is kept to skip most payload comparisons.
+    struct Slot
+    {
+        uint32_t hash = 0;
+        uint32_t entry = empty;
+    };
+
+    struct EntryState
+    {
+        uint32_t hash = 0;
+        uint8_t length = 0;
+        bool referenced = false;
+    };
+
+    static constexpr uint32_t empty = UINT32_MAX;
+
+    const Options options_;
+    std::vector<Slot> index_;
+    std::size_t mask_;
+    std::vector<EntryState> entries_;
+    std::unique_ptr<char[]> text_;
+    std::size_t size_ = 0;
+    std::size_t clock_hand_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t evictions_ = 0;
+
+    static uint32_t hash_(std::string_view data);
+    [[nodiscard]] std::string_view text_of_(std::size_t entry) const;
+    // Picks the entry for a new payload, evicting one if the table is full.
+    std::size_t allocate_();
+    void remove_from_index_(std::size_t entry);
+};
@@ -0,0 +1,167 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <memory>
+#include <span>
+
+/**
+ * A minimal io_uring instance: submission and completion queues mapped into the process, nothing else.
+ *
+ * Talks to the kernel through the raw system calls, so no liburing is required. Only the operations needed by the
+ * servers are provided. Not thread safe. Failures of the setup are reported with std::system_error.
+ */
+class IoUring
+{
+    int fd_ = -1;
+    void* rings_ = nullptr; // submission and completion rings share one mapping (IORING_FEAT_SINGLE_MMAP)
+    std::size_t rings_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0; // includes the entries prepared but not yet published to the kernel
+    unsigned* sq_flags_ = nullptr;
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    // Releases whatever was set up so far.
+    void close_();
+    // Calls io_uring_enter, retrying interrupted calls.
+    void enter_(unsigned to_submit, unsigned min_complete, unsigned flags);
+    // Moves the completions the kernel kept aside while the completion queue was full into the queue. They do not
+    // signal the eventfd again, and until they are moved the kernel refuses new submissions.
+    void flush_overflow_();
+
+public:
+    /**
+     * @param entries submission queue size. Rounded up to a power of two by the kernel.
+     * @param completion_entries completion queue size, at least twice the submission queue size. Completions that do
+     * not fit are kept by the kernel, but slow down the ring.
+     */
+    explicit IoUring(unsigned entries, unsigned completion_entries = 0);
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    // Closes the ring. The kernel cancels the pending requests.
+    ~IoUring();
+
+    /**
+     * @return a zeroed submission queue entry. Submits the queued entries first if the queue is full. nullptr if the
+     * kernel did not take any of them (EAGAIN or EBUSY): process the completions and try again later.
+     */
+    io_uring_sqe* get_sqe();
+
+    /**
+     * Passes the prepared entries to the kernel. Does nothing if there are none.
+     */
+    void submit();
+
+    /**
+     * Submits the prepared entries and blocks until at least one completion is available.
+     */
+    void submit_and_wait();
+
+    /**
+     * Makes the kernel signal the eventfd whenever a completion is posted, so the ring can be watched by another
+     * event loop.
+     */
+    void register_eventfd(int event_fd);
+
+    /**
+     * Registers a provided buffer ring (see ProvidedBuffers) as the buffer group for IOSQE_BUFFER_SELECT requests.
+     */
+    void register_buffer_ring(const io_uring_buf_ring* ring, unsigned entries, uint16_t group);
+
+    /**
+     * Passes every available completion to the callable and marks them consumed. Call until it returns 0 to get the
+     * completions that did not fit the queue too.
+     *
+     * @return number of completions processed.
+     */
+    template <typename Callable>
+    unsigned process_completions(Callable&& callable)
+    {
+        flush_overflow_();
+        auto head = std::atomic_ref(*cq_head_).load(std::memory_order_relaxed);
+        const auto tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+        const unsigned count = tail - head;
+        for (; head != tail; head++)
+        {
+            callable(static_cast<const io_uring_cqe&>(cqes_[head & cq_mask_]));
+        }
+        std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * Prepares a multishot receive into the buffers of a provided buffer group. The request stays active and posts a
+     * completion with IORING_CQE_F_MORE for every received chunk until the connection ends, an error occurs or the
+     * group runs out of buffers.
+     */
+    static void prepare_multishot_recv(io_uring_sqe* sqe, int fd, uint16_t group, uint64_t user_data);
+
+    /**
+     * Checks whether the kernel supports everything needed by UringTcpServer (multishot receive with provided buffer
+     * rings, Linux 6.0). Creates a temporary ring and a socket pair to find out.
+     */
+    static bool multishot_recv_supported();
+};
+
+/**
+ * A ring of equally sized receive buffers that the kernel picks from when data arrives (provided buffer ring).
+ *
+ * Buffers taken by the kernel are identified by the buffer id in the completion flags and must be recycled once the
+ * data was processed. Recycled buffers become available to the kernel on publish. Must outlive the ring it is
+ * registered with, as the kernel may write to the buffers until the ring is closed.
+ */
+class ProvidedBuffers
+{
+    io_uring_buf_ring* ring_ = nullptr; // page aligned memory shared with the kernel
+    std::size_t ring_size_ = 0;
+    std::unique_ptr<char[]> data_;
+    const unsigned count_;
+    const std::size_t buffer_size_;
+    uint16_t tail_ = 0;
+
+    void add_(uint16_t id);
+
+public:
+    /**
+     * All the buffers are available to the kernel initially.
+     *
+     * @param count number of buffers. Must be a power of two not larger than 32768.
+     * @param buffer_size size of every buffer. Must be positive and fit 32 bits.
+     */
+    ProvidedBuffers(unsigned count, std::size_t buffer_size);
+    ProvidedBuffers(const ProvidedBuffers&) = delete;
+    ProvidedBuffers& operator=(const ProvidedBuffers&) = delete;
+    ~ProvidedBuffers();
+
+    /**
+     * @return the received data of a buffer picked by the kernel.
+     */
+    [[nodiscard]] std::span<char> get(uint16_t id, std::size_t length) const
+    {
+        return {data_.get() + id * buffer_size_, length};
+    }
+
+    /**
+     * Returns the buffer to the ring. The kernel can only see it after publish.
+     */
+    void recycle(uint16_t id) { add_(id); }
+
+    /**
+     * Makes the recycled buffers available to the kernel.
+     */
+    void publish();
+
+    [[nodiscard]] const io_uring_buf_ring* ring() const { return ring_; }
+    [[nodiscard]] unsigned count() const { return count_; }
+};
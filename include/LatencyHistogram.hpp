@@ -0,0 +1,114 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/**
+ * Log-linear histogram of non-negative integer values, e.g. latencies in nanoseconds.
+ *
+ * Values below 64 are counted exactly. Larger values are split into power of two ranges with 32 equal buckets each,
+ * so the relative error of a reported value stays within about 3% over the whole 64-bit range. Recording is a few
+ * arithmetic instructions and never allocates. Not thread safe - record per thread and merge.
+ */
+class LatencyHistogram
+{
+    static constexpr unsigned int sub_bucket_bits = 5;
+    static constexpr uint64_t sub_bucket_count = uint64_t{1} << sub_bucket_bits;
+
+public:
+    // Exact values below 2 * sub_bucket_count, then one range per remaining bit width up to 64.
+    static constexpr std::size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+    // Index of the bucket counting the value.
+    static std::size_t bucket_of(uint64_t value)
+    {
+        if (value < 2 * sub_bucket_count)
+        {
+            return static_cast<std::size_t>(value);
+        }
+        const auto shift = static_cast<unsigned int>(std::bit_width(value)) - sub_bucket_bits - 1;
+        return shift * sub_bucket_count + static_cast<std::size_t>(value >> shift);
+    }
+
+    // Smallest value counted by the bucket.
+    static uint64_t bucket_lower_bound(std::size_t index)
+    {
+        if (index < 2 * sub_bucket_count)
+        {
+            return index;
+        }
+        const auto shift = index / sub_bucket_count - 1;
+        return (index % sub_bucket_count + sub_bucket_count) << shift;
+    }
+
+private:
+    std::array<uint64_t, bucket_count> counts_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ = 0;
+
+public:
+    void record(uint64_t value) { record(value, 1); }
+
+    // Records the same value several times.
+    void record(uint64_t value, uint64_t times)
+    {
+        if (times == 0)
+        {
+            return;
+        }
+        counts_[bucket_of(value)] += times;
+        count_ += times;
+        sum_ += value * times;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (std::size_t i = 0; i < bucket_count; i++)
+        {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void reset() { *this = LatencyHistogram{}; }
+
+    [[nodiscard]] uint64_t count() const { return count_; }
+    [[nodiscard]] uint64_t min() const { return count_ > 0 ? min_ : 0; }
+    [[nodiscard]] uint64_t max() const { return max_; }
+    [[nodiscard]] double mean() const { return count_ > 0 ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    /**
+     * @param percentile 0..100
+     * @return a value that at least the given percentage of the recorded values does not exceed (the upper bound of
+     * the bucket, limited by the maximal recorded value). 0 if nothing was recorded.
+     */
+    [[nodiscard]] uint64_t percentile(double percentile) const
+    {
+        if (count_ == 0)
+        {
+            return 0;
+        }
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * count_)));
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucket_count; i++)
+        {
+            seen += counts_[i];
+            if (seen >= rank)
+            {
+                return i + 1 < bucket_count ? std::min(bucket_lower_bound(i + 1) - 1, max_) : max_;
+            }
+        }
+        return max_;
+    }
+};
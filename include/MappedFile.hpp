@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string>
+
+/**
+ * A whole file mapped read-only into memory, for decoding large files without copying them. The kernel is advised of
+ * sequential access, so the pages are read ahead. Failures are reported with exceptions.
+ */
+class MappedFile
+{
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    // The file contents. Empty for an empty file.
+    [[nodiscard]] std::span<const char> data() const { return {data_, size_}; }
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Free list of equally sized memory blocks.
+ *
+ * The block size is taken from the first allocation, requests of other sizes are passed to the global operator new.
+ * Released blocks are kept for reuse and only returned to the system when the pool is destroyed, so once the pool has
+ * grown to the peak number of live objects, allocations are just a couple of pointer operations.
+ *
+ * Not thread safe - use one pool per event loop thread.
+ */
+class MemoryPool
+{
+    // A released block stores the link to the next one in its first bytes.
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    std::size_t object_size_ = 0; // size of the pooled allocations, zero until the first one
+    FreeBlock* free_ = nullptr;
+    std::size_t block_count_ = 0;
+    std::size_t free_count_ = 0;
+
+public:
+    MemoryPool() = default;
+    MemoryPool(const MemoryPool&) = delete;
+    MemoryPool& operator=(const MemoryPool&) = delete;
+    // All the blocks must be released before the pool is destroyed.
+    ~MemoryPool();
+
+    /**
+     * @return memory suitably aligned for any object of the given size (same guarantee as operator new).
+     */
+    void* allocate(std::size_t size);
+
+    /**
+     * @param size must be the same as passed to allocate.
+     */
+    void deallocate(void* block, std::size_t size) noexcept;
+
+    /**
+     * @return number of blocks allocated from the system, including the ones in use.
+     */
+    [[nodiscard]] std::size_t block_count() const { return block_count_; }
+
+    /**
+     * @return number of released blocks waiting for reuse.
+     */
+    [[nodiscard]] std::size_t free_count() const { return free_count_; }
+};
+
+/**
+ * Standard allocator over a shared MemoryPool, e.g. for std::allocate_shared. Single object allocations use the pool.
+ *
+ * Every copy keeps the pool alive, so objects may outlive the code that created them (e.g. asio sessions destroyed
+ * together with the io_context).
+ */
+template <typename T>
+class PoolAllocator
+{
+    template <typename U>
+    friend class PoolAllocator;
+
+    std::shared_ptr<MemoryPool> pool_;
+
+public:
+    using value_type = T;
+
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over-aligned types are not supported");
+
+    explicit PoolAllocator(std::shared_ptr<MemoryPool> pool) : pool_{std::move(pool)} {}
+
+    template <typename U>
+    explicit(false) PoolAllocator(const PoolAllocator<U>& other) : pool_{other.pool_}
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if (n == 1)
+        {
+            return static_cast<T*>(pool_->allocate(sizeof(T)));
+        }
+        return std::allocator<T>{}.allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (n == 1)
+        {
+            pool_->deallocate(p, sizeof(T));
+        }
+        else
+        {
+            std::allocator<T>{}.deallocate(p, n);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const
+    {
+        return pool_ == other.pool_;
+    }
+};
+
+/**
+ * Creates objects in pooled memory and hands them out as unique_ptrs that return the memory to the pool.
+ *
+ * The objects are constructed and destroyed as usual, only the memory is recycled. Not thread safe.
+ */
+template <typename T>
+class ObjectPool
+{
+    std::shared_ptr<MemoryPool> pool_ = std::make_shared<MemoryPool>();
+
+public:
+    // Destroys the object and releases its memory. Keeps the pool alive while there are objects using it.
+    struct Deleter
+    {
+        std::shared_ptr<MemoryPool> pool;
+
+        void operator()(T* object) const
+        {
+            object->~T();
+            pool->deallocate(object, sizeof(T));
+        }
+    };
+
+    using Ptr = std::unique_ptr<T, Deleter>;
+
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over-aligned types are not supported");
+
+    template <typename... Args>
+    Ptr make(Args&&... args)
+    {
+        void* memory = pool_->allocate(sizeof(T));
+        try
+        {
+            return Ptr(new (memory) T(std::forward<Args>(args)...), Deleter{pool_});
+        }
+        catch (...)
+        {
+            pool_->deallocate(memory, sizeof(T));
+            throw;
+        }
+    }
+
+    /**
+     * @return the underlying memory pool, e.g. for statistics.
+     */
+    [[nodiscard]] const MemoryPool& memory() const { return *pool_; }
+};
@@ -0,0 +1,242 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "LatencyHistogram.hpp"
+
+/**
+ * Runtime counters and histograms of the server.
+ *
+ * Every thread updates its own shard, found through a thread local pointer. A shard has a single writer, so an update
+ * is a plain load and store without atomic read-modify-write instructions or shared cache lines. Snapshots sum the
+ * shards of all the threads and may be taken from any thread at any time.
+ *
+ * Recording compiles to nothing unless the library is built with SERVER_WITH_METRICS (CMake option SERVER_METRICS), so
+ * the overhead of the metrics themselves can be measured by comparing the two builds.
+ */
+namespace metrics
+{
+#ifdef SERVER_WITH_METRICS
+    inline constexpr bool enabled = true;
+#else
+    inline constexpr bool enabled = false;
+#endif
+
+    enum class Counter
+    {
+        connections_opened,
+        connections_closed,
+        reads,
+        bytes_read,
+        command_1,
+        command_2,
+        command_3,
+        crc_failures,
+        unknown_command_ids,
+        skipped_bytes, // line noise discarded while looking for packet headers
+        response_bytes, // ACK/NAK frames written back to the clients
+        read_pauses, // reads postponed because the client does not read its responses
+    };
+    inline constexpr std::size_t counter_count = 12;
+
+    // Counter of the valid packets of the command at the given position of the protocol table.
+    template <std::size_t Index>
+    constexpr Counter command_counter()
+    {
+        static_assert(Index < 3, "Add a packet counter for the new command");
+        return static_cast<Counter>(static_cast<std::size_t>(Counter::command_1) + Index);
+    }
+
+    enum class Histogram
+    {
+        read_size, // bytes passed to the buffer handler at once
+        packets_per_read, // valid packets decoded from a single read
+        handler_time_ns, // time spent in the buffer handler per read
+        receive_latency_ns, // kernel receive time to the handler call, if measured (see tcp_server::SocketOptions)
+    };
+    inline constexpr std::size_t histogram_count = 4;
+
+    // Counters and histograms of a single thread. Written by the owning thread only, readable from any thread.
+    class alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, counter_count> counters_{};
+        std::array<std::array<std::atomic<uint64_t>, LatencyHistogram::bucket_count>, histogram_count> histograms_{};
+
+        static void increment_(std::atomic<uint64_t>& value, uint64_t delta)
+        {
+            value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+        }
+
+    public:
+        void add(Counter counter, uint64_t delta) { increment_(counters_[static_cast<std::size_t>(counter)], delta); }
+
+        void record(Histogram histogram, uint64_t value)
+        {
+            increment_(histograms_[static_cast<std::size_t>(histogram)][LatencyHistogram::bucket_of(value)], 1);
+        }
+
+        [[nodiscard]] uint64_t counter(Counter counter) const
+        {
+            return counters_[static_cast<std::size_t>(counter)].load(std::memory_order_relaxed);
+        }
+
+        // Valid packets of all the command ids decoded so far.
+        [[nodiscard]] uint64_t packets() const
+        {
+            return counter(Counter::command_1) + counter(Counter::command_2) + counter(Counter::command_3);
+        }
+
+        /**
+         * Adds the histogram of this shard to the result. The values are reported at the bucket resolution (see
+         * LatencyHistogram), every value as the lower bound of its bucket.
+         */
+        void collect(Histogram histogram, LatencyHistogram& result) const;
+    };
+
+    namespace detail
+    {
+        inline thread_local Shard* local_shard = nullptr;
+
+        // Creates a shard for the calling thread. Shards are never freed, so the totals keep the work of the threads
+        // that have exited.
+        Shard& register_shard();
+    } // namespace detail
+
+    // Shard of the calling thread.
+    inline Shard& local()
+    {
+        auto* shard = detail::local_shard;
+        if (shard == nullptr) [[unlikely]]
+        {
+            shard = detail::local_shard = &detail::register_shard();
+        }
+        return *shard;
+    }
+
+    inline void add(Counter counter, uint64_t delta = 1)
+    {
+        if constexpr (enabled)
+        {
+            local().add(counter, delta);
+        }
+    }
+
+    inline void record(Histogram histogram, uint64_t value)
+    {
+        if constexpr (enabled)
+        {
+            local().record(histogram, value);
+        }
+    }
+
+    /**
+     * Counters kept in plain variables and added to the shard of the calling thread at once, for the per-packet paths
+     * where even the thread local lookup is noticeable.
+     */
+    class LocalCounters
+    {
+        std::array<uint64_t, enabled ? counter_count : 0> values_{};
+        bool pending_ = false;
+
+    public:
+        void add(Counter counter, uint64_t delta = 1)
+        {
+            if constexpr (enabled)
+            {
+                values_[static_cast<std::size_t>(counter)] += delta;
+                pending_ = true;
+            }
+        }
+
+        // Moves the counted values to the shard of the calling thread.
+        void flush()
+        {
+            if constexpr (enabled)
+            {
+                if (!pending_)
+                {
+                    return; // most calls with small fragments do not complete a packet
+                }
+                auto& shard = local();
+                for (std::size_t i = 0; i < counter_count; i++)
+                {
+                    if (values_[i] != 0)
+                    {
+                        shard.add(static_cast<Counter>(i), values_[i]);
+                        values_[i] = 0;
+                    }
+                }
+                pending_ = false;
+            }
+        }
+    };
+
+    // Totals of all the threads at some point in time.
+    struct Snapshot
+    {
+        std::array<uint64_t, counter_count> counters{};
+        std::array<LatencyHistogram, histogram_count> histograms{};
+
+        [[nodiscard]] uint64_t counter(Counter counter) const { return counters[static_cast<std::size_t>(counter)]; }
+
+        [[nodiscard]] const LatencyHistogram& histogram(Histogram histogram) const
+        {
+            return histograms[static_cast<std::size_t>(histogram)];
+        }
+    };
+
+    /**
+     * Sums the shards of all the threads. The shards are read while being updated, so counters of different threads
+     * may be a few updates apart, but every value is consistent on its own.
+     */
+    Snapshot collect();
+
+    /**
+     * Writes the snapshot as a single line JSON object: the counters, the number of active connections and count, mean,
+     * p50, p90, p99, p99.9 and max of every histogram.
+     */
+    void write_json(std::ostream& stream, const Snapshot& snapshot);
+
+    /**
+     * Measures the processing of a single read by the buffer handler: counts the read and its size when created and
+     * records the handler time and the number of packets decoded by it when destroyed.
+     */
+    class ReadScope
+    {
+        Shard* shard_ = nullptr;
+        uint64_t packets_before_ = 0;
+        std::chrono::steady_clock::time_point start_{};
+
+    public:
+        explicit ReadScope(std::size_t length)
+        {
+            if constexpr (enabled)
+            {
+                shard_ = &local();
+                shard_->add(Counter::reads, 1);
+                shard_->add(Counter::bytes_read, length);
+                shard_->record(Histogram::read_size, length);
+                packets_before_ = shard_->packets();
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~ReadScope()
+        {
+            if constexpr (enabled)
+            {
+                const auto time = std::chrono::steady_clock::now() - start_;
+                shard_->record(Histogram::handler_time_ns,
+                               std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+                shard_->record(Histogram::packets_per_read, shard_->packets() - packets_before_);
+            }
+        }
+
+        ReadScope(const ReadScope&) = delete;
+        ReadScope& operator=(const ReadScope&) = delete;
+    };
+} // namespace metrics
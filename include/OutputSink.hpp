@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.hpp"
+
+/**
+ * Asynchronous output for the decoded commands.
+ *
+ * Text is written into per-thread Buffers. Filled buffers are handed to a dedicated writer thread through a lock-free
+ * queue and written to the file descriptor in large writev batches, so a slow consumer of the output does not stall
+ * the event loops. Buffer memory is preallocated and recycled, the steady state performs no allocations.
+ *
+ * The sink must outlive all of its Buffers.
+ */
+class OutputSink
+{
+    // Preallocated output memory. At any time it is owned by a single Buffer, queue or the writer thread.
+    struct Block;
+
+public:
+    // What to do when all the preallocated blocks are queued for writing.
+    enum class OverflowPolicy
+    {
+        block, // wait for the writer thread (backpressure)
+        drop // discard the output and count the dropped bytes
+    };
+
+    struct Options
+    {
+        // Size of a single buffer block. A thread hands its block to the writer once it is full.
+        std::size_t flush_size = 64 * 1024;
+        // Number of preallocated blocks shared by all threads.
+        std::size_t block_count = 64;
+        OverflowPolicy overflow_policy = OverflowPolicy::block;
+    };
+
+    /**
+     * Per-thread output buffer. Use it as a std::ostream buffer, e.g. for CommandPrinter.
+     *
+     * Blocks are handed over at line boundaries, so complete lines of different threads are never interleaved.
+     * Not thread safe. The data is handed to the writer when a block is full or when the stream is flushed, so the
+     * owner should flush it periodically to bound the output latency.
+     */
+    class Buffer : public std::streambuf
+    {
+        OutputSink& sink_;
+        Block* block_ = nullptr;
+        // Scratch space used instead of a block when the output is being dropped.
+        std::unique_ptr<char[]> spill_;
+        // Incomplete line moved from a full block to the next one.
+        std::vector<char> carry_;
+
+        // Hands the data up to the end over to the writer and leaves the buffer without a block.
+        void release_(const char* end);
+
+    protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+    public:
+        explicit Buffer(OutputSink& sink);
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        // Hands the remaining data to the writer.
+        ~Buffer() override;
+    };
+
+    /**
+     * Starts the writer thread.
+     *
+     * @param fd file descriptor to write to, e.g. STDOUT_FILENO. Not closed by the sink.
+     */
+    OutputSink(int fd, Options options);
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+    // Writes all the submitted data and stops the writer thread.
+    ~OutputSink();
+
+    /**
+     * @return number of bytes discarded due to the overflow policy or write errors.
+     */
+    [[nodiscard]] uint64_t dropped_bytes() const { return dropped_bytes_.load(std::memory_order_relaxed); }
+
+private:
+    const int fd_;
+    const Options options_;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    BoundedQueue<Block*> free_;
+    BoundedQueue<Block*> filled_;
+    // Incremented on every submitted and every recycled block, used to sleep until something changes.
+    std::atomic<uint32_t> submitted_{0};
+    std::atomic<uint32_t> recycled_{0};
+    std::atomic<bool> stopping_{false};
+    std::atomic<uint64_t> dropped_bytes_{0};
+    bool write_failed_ = false; // writer thread only
+    std::jthread writer_;
+
+    Block* acquire_();
+    void submit_(Block* block);
+    void write_loop_();
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include <boost/crc.hpp>
+#include <string>
+
+/**
+ * Builds a packet of the protocol around the given command id and data: adds the "CMD" prefix and the CRC-16/ARC of
+ * the id and the data, big endian. Mostly useful for testing purposes, the checksum is computed by boost rather than
+ * by Crc16Arc.
+ */
+inline std::string make_packet(const std::string &data)
+{
+    boost::crc_16_type crc;
+    crc.process_bytes(data.data(), data.length());
+    const auto cs = crc.checksum();
+    return "CMD" + data + static_cast<char>(cs >> 8) + static_cast<char>(cs & 0xff);
+}
@@ -1,24 +1,47 @@
 #pragma once
 
-#include <boost/crc.hpp>
+#include <algorithm>
+#include <array>
 #include <concepts>
 #include <cstdint>
-#include <deque>
 #include <span>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "Commands.hpp"
+#include "Crc16Arc.hpp"
+#include "HeaderScanner.hpp"
+#include "Metrics.hpp"
+#include "Responses.hpp"
 
 /**
- * A concept describing an object that can receive and process data packets parsed by the PacketParser.
+ * A handler that receives commands one by one.
  *
- * Required to have one member function named handle_command_N per every known packet type.
+ * Required to have one member function named handle_command_N per every command of the Protocol, see the deliver
+ * functions of the command records. Command 1 data is passed as a std::string_view if the handler accepts it (see
+ * StringViewCommandHandler) and as an owned std::string otherwise.
  */
 template <typename Handler>
-concept CommandHandlerConcept = requires(Handler h, std::string str_data, uint8_t u8_data, uint16_t u16_data) {
-    { h.handle_command_1(std::move(str_data)) } -> std::same_as<void>;
-    { h.handle_command_2(u8_data) } -> std::same_as<void>;
-    { h.handle_command_3(u16_data, u8_data) } -> std::same_as<void>;
+concept SingleCommandHandler = Protocol::deliverable<Handler>;
+
+/**
+ * A handler that receives all the commands decoded from a single block of received data at once. The records and the
+ * data they refer to are only valid during the call.
+ */
+template <typename Handler>
+concept BatchCommandHandler = requires(Handler h, std::span<const Command> batch) {
+    { h.handle_batch(batch) } -> std::same_as<void>;
 };
 
+/**
+ * A concept describing an object that can receive and process data packets parsed by the PacketParser.
+ *
+ * The parser prefers the batch interface if the handler implements both.
+ */
+template <typename Handler>
+concept CommandHandlerConcept = BatchCommandHandler<Handler> || SingleCommandHandler<Handler>;
+
 /**
  * A functor object that can handle blocks of binary data received from the network client.
  *
@@ -40,9 +63,7 @@ class PacketParser
         fail // Packet is invalid - continue looking for a header
     };
 
-    // Just a few constants for a simple parsing mechanism. This approach is error-prone as the constants are scattered
-    // over the parser implementation. Some of these constants and associated methods can be represented as separate
-    // data access objects if the code grows.
+    // Packet framing. The command layouts are generated from the Protocol table (see Commands.hpp).
     static constexpr char header[] = "CMD";
     static constexpr unsigned int header_length = std::char_traits<char>::length(header);
     static constexpr unsigned int cmd_id_pos = header_length;
@@ -50,121 +71,189 @@ class PacketParser
     static constexpr unsigned int data_pos = cmd_id_pos + cmd_id_length;
     static constexpr unsigned int crc_length = 2;
     static constexpr unsigned int min_packet_length = header_length + cmd_id_length + crc_length;
-    // current protocol technically allows zero-length data, but currently every command uses at least one byte
-    static constexpr unsigned int min_data_length = 1;
+    static constexpr unsigned int min_data_length = Protocol::min_data_length;
+    static constexpr unsigned int max_data_length = Protocol::max_data_length;
+    static constexpr unsigned int max_packet_length = min_packet_length + max_data_length;
+
+    // Passes a decoded command record to the parser.
+    struct Deliver
+    {
+        PacketParser& parser;
+
+        template <typename Record>
+        void operator()(const Record& record) const
+        {
+            parser.deliver_(record);
+        }
+    };
 
     CommandHandler& handler_;
-    std::deque<char> buffer_{};
+    // The unparsed bytes of the current input: either the received span itself or the tail_ buffer.
+    std::span<const char> view_{};
+    // Incomplete packet bytes left over from the previous call, followed by the head of the next received span.
+    // A tail is always shorter than max_packet_length and at most max_packet_length bytes are appended to it, so the
+    // buffer never needs to grow.
+    std::array<char, 2 * max_packet_length> tail_{};
+    std::size_t tail_length_ = 0;
+    // Commands decoded during the current call, only used with batch handlers. Keeps its capacity between the calls.
+    std::vector<Command> batch_{};
+    // ACK/NAK frames of the packets, collected until the owner of the parser takes them (see responses()).
+    std::vector<char> responses_{};
     ParserState state_ = ParserState::header;
-    int cmd_id_ = 0;
-    int data_length_ = min_data_length;
+    // Why the current packet is dropped, for its NAK frame.
+    responses::Status fail_status_ = responses::Status::crc_failure;
+    bool responses_enabled_ = false;
+    uint64_t skipped_bytes_ = 0;
+    // Per-packet metrics, passed to the thread's shard once per call.
+    metrics::LocalCounters counters_{};
+    uint16_t cmd_id_ = 0;
+    unsigned int data_length_ = min_data_length;
+    bool bulk_decoding_ = true;
 
-    // Utility function to read big endian uint16 from the buffer.
-    [[nodiscard]] uint16_t read_uint16_(const int buffer_position) const
+    // Utility functions to read big endian uint16 from memory and from the view.
+    static uint16_t load_uint16_(const char* data)
     {
-        const auto high = static_cast<unsigned char>(buffer_[buffer_position]);
-        const auto low = static_cast<unsigned char>(buffer_[buffer_position + 1]);
-        return high << 8 | low;
+        const auto high = static_cast<unsigned char>(data[0]);
+        const auto low = static_cast<unsigned char>(data[1]);
+        return static_cast<uint16_t>(high << 8 | low);
     }
 
-    // Check if the buffer head contains the proper header value.
+    [[nodiscard]] uint16_t read_uint16_(const int view_position) const { return load_uint16_(&view_[view_position]); }
+
+    // Drop the processed bytes from the view head.
+    void consume_(const std::size_t length) { view_ = view_.subspan(length); }
+
+    // Skip the view up to the next header candidate.
     ParserState find_header_()
     {
-        // Buffer is guaranteed to be longer than header length by the parse() while loop condition
-        for (unsigned int i = 0; i < header_length; i++)
+        // A noisy stream is skipped in one go instead of one byte per state machine step.
+        const auto position = HeaderScanner::find(view_, std::string_view(header, header_length));
+        skipped_bytes_ += position;
+        counters_.add(metrics::Counter::skipped_bytes, position);
+        consume_(position);
+        // If no header was found, only the bytes that may start the next header are left in the view.
+        if (view_.size() < header_length)
         {
-            if (buffer_[i] != header[i])
+            return ParserState::header;
+        }
+        // Consecutive complete packets are decoded without the state machine. Whatever stopped the fast path (an
+        // incomplete or broken packet, or noise) is handled by the state machine starting from a header search.
+        return bulk_decoding_ && bulk_decode_() ? ParserState::header : ParserState::data;
+    }
+
+    /**
+     * Fast path for back-to-back valid packets: validates and dispatches the packets at the view head in a tight loop
+     * over the contiguous data, without the per-state bookkeeping. Stops at the first position that does not hold a
+     * complete valid packet, which is left to the state machine, so errors are handled and counted in one place.
+     *
+     * @return true if any packet was decoded.
+     */
+    bool bulk_decode_()
+    {
+        const char* position = view_.data();
+        const char* const end = position + view_.size();
+        while (static_cast<std::size_t>(end - position) >= min_packet_length + min_data_length &&
+               std::equal(header, header + header_length, position))
+        {
+            const auto packet = check_packet(std::span(position, end));
+            if (packet.status != PacketStatus::valid)
             {
-                // Buffer head does not match the required header format.
-                // Drop the first byte and try again if possible.
-                buffer_.pop_front();
-                return ParserState::header;
+                break;
             }
+            decode_packet(position, Deliver{*this});
+            position += packet.length;
         }
-        // Header matched - proceed to cmd id check and data size estimation.
-        return ParserState::data;
+        const auto decoded = static_cast<std::size_t>(position - view_.data());
+        consume_(decoded);
+        return decoded > 0;
     }
 
     // Check the cmd id and estimate remaining data length.
     ParserState parse_cmd_id_()
     {
         cmd_id_ = read_uint16_(cmd_id_pos);
-        switch (cmd_id_)
-        {
-        case 1:
-            data_length_ = 1 + static_cast<unsigned char>(buffer_[data_pos]);
-            break;
-        case 2:
-            data_length_ = 1;
-            break;
-        case 3:
-            data_length_ = 3;
-            break;
-        default:
+        const auto* length = Protocol::find(cmd_id_);
+        if (length == nullptr)
+        {
             // Unknown cmd id - proceed to failed packet handling.
+            counters_.add(metrics::Counter::unknown_command_ids);
+            fail_status_ = responses::Status::unknown_command;
             return ParserState::fail;
         }
+        if (length->fixed > 0)
+        {
+            data_length_ = length->fixed;
+        }
+        else if (view_.size() < min_packet_length + length->min)
+        {
+            // The bytes that determine the length of this command are not received yet.
+            data_length_ = length->min;
+            return ParserState::data;
+        }
+        else
+        {
+            data_length_ = static_cast<unsigned int>(length->compute(view_.data() + data_pos));
+        }
         // Data length estimated - check the CRC if available.
         return ParserState::crc;
     }
 
-    // Parse the received data and call an appropriate handler_ method.
+    // Decode the received data and pass the command to the handler_ through the id indexed decoder table.
     ParserState handle_command_()
     {
-        switch (cmd_id_)
-        {
-        case 1: // length_u8 char[length]
-            {
-                const auto data_start = buffer_.cbegin() + data_pos;
-                auto data_1 = std::string(data_start + 1, data_start + data_length_);
-                handler_.handle_command_1(std::move(data_1));
-                break;
-            }
-        case 2: // data_u8
-            {
-                auto data_2 = static_cast<uint8_t>(buffer_[data_pos]);
-                handler_.handle_command_2(data_2);
-                break;
-            }
-        case 3: // data_u16 data_u8
-            {
-                auto data_3_1 = read_uint16_(data_pos);
-                auto data_3_2 = static_cast<uint8_t>(buffer_[data_pos + 2]);
-                handler_.handle_command_3(data_3_1, data_3_2);
-                break;
-            }
-        default:
-            return ParserState::fail; // Defensive coding. Unreachable due to the check in parse_cmd_id_.
-        }
-        // Command was successfully parsed and handled. Fully remove it from the buffer.
-        buffer_.erase(buffer_.begin(), buffer_.begin() + min_packet_length + data_length_);
+        Protocol::decoders<Deliver>[cmd_id_](view_.data() + data_pos, Deliver{*this});
+        // Command was successfully parsed and handled. Fully remove it from the view.
+        consume_(min_packet_length + data_length_);
         // And reset the estimated data length to the minimal value in case we receive the smallest packet next time.
         data_length_ = min_data_length;
         // And start looking for the next header.
         return ParserState::header;
     }
 
+    // Collect the command for a batch handler or pass it to a single command handler right away.
+    template <typename Record>
+    void deliver_(const Record& record)
+    {
+        if constexpr (BatchCommandHandler<CommandHandler>)
+        {
+            batch_.push_back(record);
+        }
+        else
+        {
+            record.deliver(handler_);
+        }
+        counters_.add(metrics::command_counter<Protocol::index_of<Record>>());
+        if (responses_enabled_)
+        {
+            responses::append(responses_, responses::Status::accepted, Record::id);
+        }
+    }
+
     // Compute the crc over command id and the data, compare it against the packet's crc bytes.
     ParserState check_crc_()
     {
-        // todo checksum computation algorithm should be extracted to a parameter for better testability
-        boost::crc_16_type crc;
         const unsigned int crc_pos = data_pos + data_length_;
-        // Unfortunately, the dequeue is not continuous, so we have to compute the crc one byte at a time.
-        for (unsigned int i = cmd_id_pos; i < crc_pos; i++)
+        const int expected = read_uint16_(crc_pos);
+        const auto actual = Crc16Arc::update(0, view_.subspan(cmd_id_pos, crc_pos - cmd_id_pos));
+        if (actual != expected)
         {
-            crc.process_byte(buffer_[i]);
+            counters_.add(metrics::Counter::crc_failures);
+            fail_status_ = responses::Status::crc_failure;
+            return ParserState::fail;
         }
-        const int expected = read_uint16_(crc_pos);
-        return crc.checksum() == expected ? ParserState::handle : ParserState::fail;
+        return ParserState::handle;
     }
 
     // Handle an invalid command id or a broken crc.
     ParserState fail_packet_()
     {
+        if (responses_enabled_)
+        {
+            responses::append(responses_, fail_status_, cmd_id_);
+        }
         // This can only happen if we have successfully found the header string.
         // So now we can fully skip the header bytes, but not the command id as it might be the start of another header.
-        buffer_.erase(buffer_.begin(), buffer_.begin() + header_length);
+        consume_(header_length);
         data_length_ = min_data_length; // prepare to read the smallest possible packet.
         return ParserState::header;
     }
@@ -189,7 +278,139 @@ class PacketParser
         }
     }
 
+    // Run the state machine over the contiguous data until it needs more bytes. Returns the number of consumed bytes.
+    std::size_t parse_(const std::span<const char> data)
+    {
+        view_ = data;
+        // ReSharper disable once CppDFALoopConditionNotUpdated
+        // View size and data length are indirectly modified inside the loop.
+        // Make sure that the view always contains at least header+cmd_id+(data for that cmd)+crc bytes.
+        while (view_.size() >= min_packet_length + data_length_)
+        {
+            state_ = state_machine_step_();
+        }
+        return data.size() - view_.size();
+    }
+
+    // Pass the commands collected by the batch handler path. Must be called before the tail buffer is overwritten, as
+    // the records may refer to it.
+    void dispatch_batch_()
+    {
+        if constexpr (BatchCommandHandler<CommandHandler>)
+        {
+            if (!batch_.empty())
+            {
+                handler_.handle_batch(std::span<const Command>(batch_));
+                batch_.clear();
+            }
+        }
+    }
+
 public:
+    // The packet start marker.
+    static constexpr std::string_view packet_header{header, header_length};
+
+    // What the data at a packet header holds, see check_packet.
+    enum class PacketStatus
+    {
+        valid,
+        invalid, // unknown command id or broken crc - the header is dropped and the search continues after it
+        incomplete // the packet does not end within the data
+    };
+
+    struct PacketCheck
+    {
+        PacketStatus status;
+        // Length of a valid packet, header and crc included.
+        std::size_t length;
+    };
+
+    /**
+     * Checks the packet at the start of the data the way the state machine does, but without any state, e.g. for
+     * decoders that see the whole stream at once.
+     *
+     * @param data bytes starting with a packet header.
+     */
+    static PacketCheck check_packet(std::span<const char> data)
+    {
+        if (data.size() < min_packet_length + min_data_length)
+        {
+            return {PacketStatus::incomplete, 0};
+        }
+        const auto* length = Protocol::find(load_uint16_(data.data() + cmd_id_pos));
+        if (length == nullptr)
+        {
+            return {PacketStatus::invalid, 0};
+        }
+        if (data.size() < min_packet_length + length->min)
+        {
+            return {PacketStatus::incomplete, 0};
+        }
+        const std::size_t data_length = length->fixed > 0 ? length->fixed : length->compute(data.data() + data_pos);
+        const auto crc_pos = data_pos + data_length;
+        if (data.size() < crc_pos + crc_length)
+        {
+            return {PacketStatus::incomplete, 0};
+        }
+        if (Crc16Arc::update(0, data.subspan(cmd_id_pos, crc_pos - cmd_id_pos)) != load_uint16_(data.data() + crc_pos))
+        {
+            return {PacketStatus::invalid, 0};
+        }
+        return {PacketStatus::valid, crc_pos + crc_length};
+    }
+
+    /**
+     * Decodes a valid packet (see check_packet) and passes the command record to the visitor.
+     */
+    template <typename Visitor>
+    static void decode_packet(const char* packet, Visitor visitor)
+    {
+        Protocol::decoders<Visitor>[load_uint16_(packet + cmd_id_pos)](packet + data_pos, visitor);
+    }
+
+    // Packets found by decode_complete.
+    struct DecodeCounts
+    {
+        std::size_t packets = 0;
+        // Headers dropped because of an unknown command id or a broken crc.
+        std::size_t invalid = 0;
+    };
+
+    /**
+     * Stateless fast path for data that can only hold complete packets, e.g. a datagram. Decodes the data as a new
+     * parser would decode it followed by the end of the stream and passes the command records to the visitor: noise and
+     * invalid packets are skipped and an incomplete packet at the end is dropped.
+     */
+    template <typename Visitor>
+    static DecodeCounts decode_complete(std::span<const char> data, Visitor visitor)
+    {
+        DecodeCounts counts;
+        std::size_t position = 0;
+        while (true)
+        {
+            position += HeaderScanner::find(data.subspan(position), packet_header);
+            if (data.size() - position < header_length)
+            {
+                return counts;
+            }
+            const auto packet = check_packet(data.subspan(position));
+            switch (packet.status)
+            {
+            case PacketStatus::valid:
+                decode_packet(data.data() + position, visitor);
+                counts.packets++;
+                position += packet.length;
+                break;
+            case PacketStatus::invalid:
+                counts.invalid++;
+                position += header_length;
+                break;
+            case PacketStatus::incomplete:
+                return counts;
+            }
+        }
+    }
+
     /**
      * Creates a new parser instance.
      *
@@ -198,22 +419,65 @@ public:
      */
     explicit PacketParser(CommandHandler& handler) : handler_(handler) {}
 
+    /**
+     * Enables or disables the bulk decoding fast path for runs of consecutive complete packets (enabled by default).
+     * The results are the same either way, disabling it is only useful for comparisons.
+     */
+    void set_bulk_decoding(bool enabled) { bulk_decoding_ = enabled; }
+
+    /**
+     * Enables or disables the ACK/NAK frames of the packets (disabled by default), see Responses.hpp.
+     */
+    void enable_responses(bool enabled) { responses_enabled_ = enabled; }
+
+    /**
+     * Response frames of the packets decoded so far. The owner of the parser sends them and clears the vector (or swaps
+     * it with an empty one), the parser keeps appending to whatever it is left with.
+     */
+    [[nodiscard]] std::vector<char>& responses() { return responses_; }
+
+    /**
+     * @return the number of bytes discarded while searching for packet headers, i.e. the amount of line noise
+     * received from the client.
+     */
+    [[nodiscard]] uint64_t skipped_bytes() const { return skipped_bytes_; }
+
     /**
      * This function is responsible for reconstructing the packets from (potentially fragmented) sequences of bytes,
-     * parsing the commands and passing the resulting data to the handler object.
+     * parsing the commands and passing the resulting data to the handler object. Batch handlers receive all the
+     * commands completed by this call at once.
      *
      * @param packet a sequence of bytes received from the network client.
      */
     void operator()(std::span<const char> packet)
     {
-        // Copy the received data to the internal buffer to handle short reads and invalid messages.
-        buffer_.insert(buffer_.end(), packet.begin(), packet.end());
-        // ReSharper disable once CppDFALoopConditionNotUpdated
-        // Buffer size and data length are indirectly modified inside the loop.
-        // Make sure that the buffer always contains at least header+cmd_id+(data for that cmd)+crc bytes.
-        while (buffer_.size() >= min_packet_length + data_length_)
+        if (tail_length_ > 0)
         {
-            state_ = state_machine_step_();
+            // Complete the stored tail with the head of the received data. Any packet that starts in the tail ends
+            // within max_packet_length bytes of the received data, so there is no need to copy more than that.
+            const auto head_length = std::min<std::size_t>(packet.size(), max_packet_length);
+            std::copy_n(packet.begin(), head_length, tail_.begin() + tail_length_);
+            const auto stitched_length = tail_length_ + head_length;
+            const auto consumed = parse_(std::span(tail_.data(), stitched_length));
+            if (head_length == packet.size())
+            {
+                dispatch_batch_();
+                counters_.flush();
+                // Everything was copied - the leftover bytes become the new tail.
+                tail_length_ = stitched_length - consumed;
+                std::copy(tail_.begin() + consumed, tail_.begin() + stitched_length, tail_.begin());
+                return;
+            }
+            // The leftover is shorter than max_packet_length, so parsing has moved past the old tail into the copied
+            // head. Continue directly from the received data.
+            packet = packet.subspan(consumed - tail_length_);
+            tail_length_ = 0;
         }
+        // Common case - parse the received data in place and only keep the incomplete packet at its end.
+        const auto consumed = parse_(packet);
+        dispatch_batch_();
+        counters_.flush();
+        tail_length_ = packet.size() - consumed;
+        std::copy(packet.begin() + consumed, packet.end(), tail_.begin());
     }
 };
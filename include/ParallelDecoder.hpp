@@ -0,0 +1,241 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "HeaderScanner.hpp"
+#include "PacketParser.hpp"
+
+/**
+ * Decodes a complete stream, e.g. a memory mapped capture of a client's traffic, on several threads. The commands are
+ * passed to the handler in the stream order, exactly as a single PacketParser would pass them.
+ *
+ * The stream is split into chunks decoded in parallel. A worker cannot know where the sequential parse enters its
+ * chunk, so it starts at the chunk start: invalid packets are skipped as the parser skips them, so the worker
+ * resynchronises on the first header followed by a complete packet with a valid crc, and it remembers the offset of
+ * every packet from there on. The chunks are then stitched in order. Starting from where the previous chunk's packets
+ * end, the sequential parse is followed until it reaches a packet the worker has decoded too. From that packet on both
+ * parses are the same, so the rest of the chunk is taken from the worker. Usually that is the worker's first packet;
+ * the stitching decodes a few packets itself only if the chunk starts inside a packet that contains another valid
+ * packet.
+ *
+ * Chunks are decoded in rounds of one chunk per thread, which bounds the memory of the decoded records. The data must
+ * stay valid during the call, command 1 records refer to it.
+ *
+ * @tparam CommandHandler the handler of the decoded commands, see CommandHandlerConcept. Batch handlers receive the
+ * commands in batches of up to a chunk. Called from the calling thread only.
+ */
+template <CommandHandlerConcept CommandHandler>
+class ParallelDecoder
+{
+    using Parser = PacketParser<CommandHandler>;
+    using PacketStatus = typename Parser::PacketStatus;
+
+public:
+    struct Options
+    {
+        // Number of decoding threads, the calling thread included.
+        std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        // Bytes of the stream per chunk.
+        std::size_t chunk_size = 8 * 1024 * 1024;
+    };
+
+private:
+    // Packets decoded by a worker.
+    struct Chunk
+    {
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        // Stream offsets of the decoded packets, ascending.
+        std::vector<std::size_t> offsets;
+        std::vector<Command> records;
+        // Where the worker's parse continues after the chunk, the stream size if it has ended.
+        std::size_t next = 0;
+    };
+
+    // The next decision of the parse: the header position and the packet there. Incomplete packets end the parse.
+    struct Step
+    {
+        std::size_t position;
+        typename Parser::PacketCheck packet;
+    };
+
+    // Collects the decoded records of a chunk.
+    struct Collect
+    {
+        std::vector<Command>* records;
+
+        template <typename Record>
+        void operator()(const Record& record) const
+        {
+            records->emplace_back(record);
+        }
+    };
+
+    CommandHandler& handler_;
+    Options options_;
+    std::span<const char> data_{};
+    std::vector<Chunk> chunks_{};
+    uint64_t packets_ = 0;
+
+    // Finds the next packet header from a position between packets.
+    [[nodiscard]] Step step_(std::size_t position) const
+    {
+        const auto rest = data_.subspan(position);
+        const auto header = position + HeaderScanner::find(rest, Parser::packet_header);
+        if (data_.size() - header < Parser::packet_header.size())
+        {
+            return {data_.size(), {PacketStatus::incomplete, 0}};
+        }
+        return {header, Parser::check_packet(data_.subspan(header))};
+    }
+
+    // Decodes the packets whose headers are within the chunk, following the parse from the chunk start.
+    void decode_(Chunk& chunk) const
+    {
+        auto position = chunk.begin;
+        while (true)
+        {
+            const auto step = step_(position);
+            if (step.packet.status == PacketStatus::incomplete)
+            {
+                chunk.next = data_.size();
+                return;
+            }
+            if (step.position >= chunk.end)
+            {
+                chunk.next = step.position;
+                return;
+            }
+            if (step.packet.status == PacketStatus::valid)
+            {
+                chunk.offsets.push_back(step.position);
+                Parser::decode_packet(data_.data() + step.position, Collect{&chunk.records});
+                position = step.position + step.packet.length;
+            }
+            else
+            {
+                position = step.position + Parser::packet_header.size();
+            }
+        }
+    }
+
+    // Passes the records to the handler.
+    void emit_(std::span<const Command> records)
+    {
+        packets_ += records.size();
+        if constexpr (BatchCommandHandler<CommandHandler>)
+        {
+            if (!records.empty())
+            {
+                handler_.handle_batch(records);
+            }
+        }
+        else
+        {
+            for (const auto& record : records)
+            {
+                std::visit([this](const auto& command) { command.deliver(handler_); }, record);
+            }
+        }
+    }
+
+    /**
+     * Follows the sequential parse through the chunk from the given position until it meets the worker's parse.
+     *
+     * @return where the sequential parse continues after the chunk, the stream size if it has ended.
+     */
+    std::size_t stitch_(const Chunk& chunk, std::size_t position)
+    {
+        std::vector<Command> record;
+        while (true)
+        {
+            const auto step = step_(position);
+            if (step.packet.status == PacketStatus::incomplete)
+            {
+                return data_.size();
+            }
+            if (step.position >= chunk.end)
+            {
+                return step.position;
+            }
+            if (step.packet.status == PacketStatus::valid)
+            {
+                const auto it = std::lower_bound(chunk.offsets.begin(), chunk.offsets.end(), step.position);
+                if (it != chunk.offsets.end() && *it == step.position)
+                {
+                    // Same packet, same parse from here on.
+                    emit_(std::span(chunk.records).subspan(static_cast<std::size_t>(it - chunk.offsets.begin())));
+                    return chunk.next;
+                }
+                record.clear();
+                Parser::decode_packet(data_.data() + step.position, Collect{&record});
+                emit_(record);
+                position = step.position + step.packet.length;
+            }
+            else
+            {
+                position = step.position + Parser::packet_header.size();
+            }
+        }
+    }
+
+public:
+    /**
+     * @param handler the handler of the decoded commands.
+     * @param options the number of threads and the chunk size, both positive.
+     */
+    explicit ParallelDecoder(CommandHandler& handler, Options options = {}) : handler_{handler}, options_{options}
+    {
+        if (options_.threads == 0 || options_.chunk_size == 0)
+        {
+            throw std::invalid_argument("Invalid parallel decoder options");
+        }
+    }
+
+    /**
+     * Decodes the complete stream. Packets that do not end within the data are dropped, as a parser would keep waiting
+     * for the rest of them.
+     */
+    void operator()(std::span<const char> data)
+    {
+        data_ = data;
+        std::size_t position = 0; // of the sequential parse, always between packets
+        for (std::size_t round_begin = 0; round_begin < data_.size() && position < data_.size();)
+        {
+            chunks_.resize(std::min(options_.threads, (data_.size() - round_begin - 1) / options_.chunk_size + 1));
+            for (auto& chunk : chunks_)
+            {
+                chunk.begin = round_begin;
+                chunk.end = round_begin + std::min(options_.chunk_size, data_.size() - round_begin);
+                chunk.offsets.clear();
+                chunk.records.clear();
+                round_begin = chunk.end;
+            }
+            {
+                std::vector<std::jthread> workers;
+                for (std::size_t i = 1; i < chunks_.size(); i++)
+                {
+                    workers.emplace_back([this, &chunk = chunks_[i]] { decode_(chunk); });
+                }
+                decode_(chunks_.front());
+            }
+            for (const auto& chunk : chunks_)
+            {
+                if (position < chunk.end)
+                {
+                    position = stitch_(chunk, position);
+                }
+            }
+        }
+        data_ = {};
+    }
+
+    // @return the number of commands passed to the handler so far.
+    [[nodiscard]] uint64_t packets() const { return packets_; }
+};
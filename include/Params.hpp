@@ -1,4 +1,5 @@
 #pragma once
+#include <string>
 
 /**
  * A simple object for parsing the command line options.
@@ -15,6 +16,71 @@ struct Params
     Params(int argc, char* argv[]);
     // Requested server port. 0 by default.
     int port{};
+    // Number of event loop threads, each with its own io_context and listening socket. 1 by default.
+    int threads{1};
+    // true if every event loop thread should be pinned to a separate CPU core.
+    bool pin_threads{};
+    // true if the event loops should poll for ready handlers without ever sleeping, each on its own pinned core.
+    bool busy_spin{};
+    // Size of an output block in bytes. Output of a thread is handed to the writer thread in blocks of this size.
+    int flush_size{64 * 1024};
+    // Maximal time in milliseconds the output may stay in a partially filled block.
+    int flush_interval{100};
+    // Number of output blocks shared by all threads.
+    int output_blocks{64};
+    // true if the output should be dropped instead of stalling the event loops when all the blocks are in use.
+    bool drop_output{};
+    // Format of the decoded commands: "text" lines or "binary" blocks (see BinaryFormat.hpp).
+    std::string output_format{"text"};
+    // true if the binary output blocks should be compressed.
+    bool compress_output{};
+    // Initial and smallest receive buffer size of a connection in bytes.
+    int receive_buffer_min{256};
+    // Largest receive buffer size of a connection in bytes, also the size of the shared receive buffers.
+    int receive_buffer_max{64 * 1024};
+    // true if connections should read into a buffer shared by the event loop instead of owning buffers.
+    bool shared_receive_buffer{};
+    // true if connections should be served through io_uring (falls back to epoll if not available).
+    bool io_uring{};
+    // true if TCP_NODELAY should be set on the connections.
+    bool tcp_nodelay{};
+    // true if the connections should acknowledge every read right away (TCP_QUICKACK).
+    bool tcp_quickack{};
+    // Kernel receive buffer size of a connection in bytes (SO_RCVBUF). 0 (default) keeps the automatic sizing.
+    int socket_receive_buffer{};
+    // Microseconds a read of an empty socket busy polls the device queue for (SO_BUSY_POLL). 0 (default) disables it.
+    int busy_poll{};
+    // true if the time from the kernel receiving the data to the parser call should be measured and reported on exit.
+    bool measure_latency{};
+    // true if every packet of a connection should be answered with an ACK or NAK frame (see Responses.hpp).
+    bool responses{};
+    // Limit of the responses queued for a connection in bytes. Reading pauses while it is reached.
+    int response_queue{64 * 1024};
+    // UDP port to receive packets as datagrams on, 0 for automatic selection. -1 (default) disables UDP.
+    int udp_port{-1};
+    // Number of datagrams received per system call.
+    int udp_batch{64};
+    // true if the kernel should coalesce the datagrams of a source (UDP_GRO).
+    bool udp_gro{};
+    // Unix socket file to accept local connections on. Empty if disabled.
+    std::string unix_socket;
+    // Unix socket file local producers hand their shared memory rings over on. Empty if disabled.
+    std::string shm_socket;
+    // Entries of the command 1 intern table of every thread (see InternTable.hpp), 0 (default) disables interning.
+    int intern{};
+    // true if command 3 telemetry should be aggregated in memory instead of written to the output (see Telemetry.hpp).
+    bool telemetry{};
+    // Interval in milliseconds the telemetry aggregates are written to stderr at. 0 (default) writes them only on
+    // SIGUSR1 and on exit.
+    int telemetry_interval{};
+    // File to write the raw received data of every connection to, see Capture.hpp. Empty if not recording.
+    std::string capture;
+    // Capture file to decode instead of running the server. Empty if not replaying.
+    std::string replay;
+    // true if the replay should keep the original timing of the reads instead of running as fast as possible.
+    bool replay_timing{};
+    // File of raw client data to decode on all the threads instead of running the server. Empty if not decoding.
+    std::string decode;
     // true if the program should terminate after parsing the command line options.
     bool no_run{};
     // true if parameter validation error was encountered.
@@ -0,0 +1,237 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+/**
+ * Building blocks of the compile-time packet protocol description (see Commands.hpp for the protocol itself).
+ *
+ * A command is described by its record type: a struct with the decoded fields as its members (in the wire order),
+ * a static `id` and a `fields` list of the wire formats of the members. PacketParser generates the data length
+ * estimation, decoding and dispatch of all the commands from a Table of the records.
+ */
+namespace protocol
+{
+    /**
+     * An unsigned integer field of the given byte order.
+     */
+    template <std::unsigned_integral T, std::endian Order = std::endian::big>
+    struct Integer
+    {
+        using value_type = T;
+        static constexpr bool fixed = true;
+        static constexpr std::size_t min_size = sizeof(T);
+        static constexpr std::size_t max_size = sizeof(T);
+
+        static std::size_t size(const char*) { return sizeof(T); }
+
+        static T decode(const char* data)
+        {
+            T value = 0;
+            for (std::size_t i = 0; i < sizeof(T); i++)
+            {
+                const auto byte = static_cast<T>(static_cast<unsigned char>(data[i]));
+                value |= static_cast<T>(byte << (Order == std::endian::big ? 8 * (sizeof(T) - 1 - i) : 8 * i));
+            }
+            return value;
+        }
+    };
+
+    using U8 = Integer<uint8_t>;
+    using U16 = Integer<uint16_t>;
+    using U16Le = Integer<uint16_t, std::endian::little>;
+    using U32 = Integer<uint32_t>;
+    using U32Le = Integer<uint32_t, std::endian::little>;
+
+    /**
+     * Appends an unsigned integer to the buffer little endian, as decoded by the Le fields.
+     */
+    template <std::unsigned_integral T>
+    void append_le(std::vector<char>& buffer, T value)
+    {
+        for (std::size_t i = 0; i < sizeof(T); i++)
+        {
+            buffer.push_back(static_cast<char>(value >> 8 * i));
+        }
+    }
+
+    /**
+     * Chars preceded by their count. Decoded as a view of the received data, so the value is only valid during the
+     * handler call.
+     */
+    template <typename Length = U8>
+    struct LengthPrefixed
+    {
+        using value_type = std::string_view;
+        static constexpr bool fixed = false;
+        static constexpr std::size_t min_size = Length::min_size;
+        static constexpr std::size_t max_size =
+            Length::max_size + std::numeric_limits<typename Length::value_type>::max();
+
+        static std::size_t size(const char* data) { return Length::min_size + Length::decode(data); }
+
+        static std::string_view decode(const char* data) { return {data + Length::min_size, Length::decode(data)}; }
+    };
+
+    /**
+     * Wire format of a command's data. Only the last field may have a variable size, so the offsets of all the fields
+     * are known at compile time and the data length can be computed from the first min_size bytes.
+     */
+    template <typename... Field>
+    struct Fields
+    {
+        static constexpr std::size_t count = sizeof...(Field);
+        static constexpr bool fixed = (Field::fixed && ...);
+        static constexpr std::size_t min_size = (Field::min_size + ... + 0);
+        static constexpr std::size_t max_size = (Field::max_size + ... + 0);
+        static constexpr std::array<std::size_t, count> offsets = []
+        {
+            std::array<std::size_t, count> result{};
+            std::size_t offset = 0;
+            std::size_t i = 0;
+            ((result[i++] = offset, offset += Field::min_size), ...);
+            return result;
+        }();
+
+        static_assert(count == 0 || []
+        {
+            constexpr std::array<bool, count> fixed_fields{Field::fixed...};
+            return std::all_of(fixed_fields.begin(), fixed_fields.end() - 1, [](bool f) { return f; });
+        }(), "Only the last field of a command may have a variable size");
+
+        /**
+         * @param data the command data, at least min_size bytes.
+         * @return the full data length.
+         */
+        static std::size_t size(const char* data)
+        {
+            if constexpr (fixed)
+            {
+                return min_size;
+            }
+            else
+            {
+                return offsets.back() + last_field_size_<Field...>(data + offsets.back());
+            }
+        }
+
+        /**
+         * Decodes the complete command data into the record, field by field in the member order.
+         */
+        template <typename Record>
+        static Record decode(const char* data)
+        {
+            return decode_<Record>(data, std::make_index_sequence<count>{});
+        }
+
+    private:
+        template <typename First, typename... Rest>
+        static std::size_t last_field_size_(const char* data)
+        {
+            if constexpr (sizeof...(Rest) == 0)
+            {
+                return First::size(data);
+            }
+            else
+            {
+                return last_field_size_<Rest...>(data);
+            }
+        }
+
+        template <typename Record, std::size_t... I>
+        static Record decode_([[maybe_unused]] const char* data, std::index_sequence<I...>)
+        {
+            return Record{Field::decode(data + offsets[I])...};
+        }
+    };
+
+    // A command record that can be passed to a handler one by one.
+    template <typename Record, typename Handler>
+    concept DeliverableTo = requires(const Record& record, Handler& handler) { record.deliver(handler); };
+
+    /**
+     * The set of commands of a protocol.
+     *
+     * Command ids index dense lookup tables, so the length estimation and the dispatch of a packet take a single
+     * table access instead of a chain of comparisons. Fixed-size commands need no length computation at all.
+     */
+    template <typename... Record>
+    struct Table
+    {
+        static constexpr std::size_t size = sizeof...(Record);
+        static constexpr uint16_t max_id = std::max({Record::id...});
+        static constexpr std::size_t min_data_length = std::min({Record::fields::min_size...});
+        static constexpr std::size_t max_data_length = std::max({Record::fields::max_size...});
+
+        static_assert(max_id < 1024, "Command ids index dense tables and must be small");
+        static_assert([]
+        {
+            std::array<uint16_t, size> ids{Record::id...};
+            std::sort(ids.begin(), ids.end());
+            return std::adjacent_find(ids.begin(), ids.end()) == ids.end();
+        }(), "Command ids must be unique");
+
+        // A decoded command of any type.
+        using variant = std::variant<Record...>;
+
+        // Whether every command can be delivered to the handler one by one.
+        template <typename Handler>
+        static constexpr bool deliverable = (DeliverableTo<Record, Handler> && ...);
+
+        // Position of the record type in the table.
+        template <typename R>
+        static constexpr std::size_t index_of = []
+        {
+            constexpr std::array<bool, size> matches{std::is_same_v<R, Record>...};
+            return static_cast<std::size_t>(std::find(matches.begin(), matches.end(), true) - matches.begin());
+        }();
+
+        // How to find the data length of a command.
+        struct Length
+        {
+            bool known = false;
+            // Bytes required to compute the length.
+            uint16_t min = 0;
+            // The length of a fixed-size command, zero for the variable-size ones.
+            uint16_t fixed = 0;
+            std::size_t (*compute)(const char* data) = nullptr;
+        };
+
+        // Length rules indexed by command id.
+        static constexpr std::array<Length, max_id + 1> lengths = []
+        {
+            std::array<Length, max_id + 1> result{};
+            ((result[Record::id] = Length{true, static_cast<uint16_t>(Record::fields::min_size),
+                                          static_cast<uint16_t>(Record::fields::fixed ? Record::fields::min_size : 0),
+                                          &Record::fields::size}),
+             ...);
+            return result;
+        }();
+
+        /**
+         * Decoders indexed by command id. Every entry decodes the command data and passes the record to the visitor,
+         * so the visitor call is resolved at compile time. Unknown ids have null entries.
+         */
+        template <typename Visitor>
+        static constexpr std::array<void (*)(const char*, Visitor), max_id + 1> decoders = []
+        {
+            std::array<void (*)(const char*, Visitor), max_id + 1> result{};
+            ((result[Record::id] = [](const char* data, Visitor visitor)
+              { visitor(Record::fields::template decode<Record>(data)); }),
+             ...);
+            return result;
+        }();
+
+        /**
+         * @return the length rule of the command, or nullptr if the id is unknown.
+         */
+        static const Length* find(uint16_t id) { return id <= max_id && lengths[id].known ? &lengths[id] : nullptr; }
+    };
+} // namespace protocol
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * Buffer handlers that record the received data, for the servers of TcpServer.hpp and the like. Mostly useful for
+ * testing purposes.
+ */
+
+// The data of all the connections, the data of every connection separately and the sizes of the individual reads.
+struct Received
+{
+    std::string data;
+    std::vector<std::string> connections;
+    std::vector<std::size_t> read_sizes;
+};
+
+struct RecordingHandler
+{
+    Received &received;
+    std::size_t connection;
+
+    void operator()(std::span<char> data)
+    {
+        received.data.append(data.data(), data.size());
+        received.connections[connection].append(data.data(), data.size());
+        received.read_sizes.push_back(data.size());
+    }
+};
+
+struct RecordingFactory
+{
+    Received &received;
+
+    auto operator()()
+    {
+        received.connections.emplace_back();
+        return std::make_unique<RecordingHandler>(received, received.connections.size() - 1);
+    }
+};
+
+// Test data of the given size that does not repeat at power of two periods.
+inline std::string make_data(std::size_t size)
+{
+    std::string data(size, '\0');
+    for (std::size_t i = 0; i < size; i++)
+    {
+        data[i] = static_cast<char>(i * 7 + i / 251);
+    }
+    return data;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "Crc16Arc.hpp"
+
+/**
+ * Response frames the server sends back to the clients if responses are enabled (see PacketParser::enable_responses).
+ *
+ * Every packet that passed the checks is acknowledged with an ACK frame, every packet header dropped because of a
+ * broken crc or an unknown command id with a NAK frame, in the order of the packets. A frame is framed like a packet:
+ * the "ACK" or "NAK" marker, the command id (u16 BE), the status byte and the CRC-16/ARC of the id and the status
+ * (u16 BE).
+ */
+namespace responses
+{
+    enum class Status : uint8_t
+    {
+        accepted = 0,
+        crc_failure = 1,
+        unknown_command = 2,
+    };
+
+    inline constexpr std::string_view ack_marker = "ACK";
+    inline constexpr std::string_view nak_marker = "NAK";
+    inline constexpr std::size_t frame_length = 8;
+
+    // A decoded response frame.
+    struct Frame
+    {
+        Status status;
+        uint16_t cmd_id;
+
+        bool operator==(const Frame&) const = default;
+    };
+
+    /**
+     * Appends the frame of a packet to the outgoing data.
+     */
+    inline void append(std::vector<char>& out, Status status, uint16_t cmd_id)
+    {
+        std::array<char, frame_length> frame{};
+        const auto marker = status == Status::accepted ? ack_marker : nak_marker;
+        std::copy(marker.begin(), marker.end(), frame.begin());
+        frame[3] = static_cast<char>(cmd_id >> 8);
+        frame[4] = static_cast<char>(cmd_id & 0xff);
+        frame[5] = static_cast<char>(status);
+        const auto crc = Crc16Arc::update(0, std::span(frame).subspan(3, 3));
+        frame[6] = static_cast<char>(crc >> 8);
+        frame[7] = static_cast<char>(crc & 0xff);
+        out.insert(out.end(), frame.begin(), frame.end());
+    }
+
+    /**
+     * Decodes a frame, e.g. on the client side.
+     *
+     * @return the frame, or nothing if the bytes are not a valid frame.
+     */
+    inline std::optional<Frame> parse(std::span<const char, frame_length> data)
+    {
+        const auto marker = std::string_view(data.data(), 3);
+        const auto crc = static_cast<uint16_t>(static_cast<unsigned char>(data[6]) << 8 |
+                                               static_cast<unsigned char>(data[7]));
+        if ((marker != ack_marker && marker != nak_marker) || Crc16Arc::update(0, data.subspan(3, 3)) != crc)
+        {
+            return std::nullopt;
+        }
+        const auto status = static_cast<Status>(data[5]);
+        if (status > Status::unknown_command || (status == Status::accepted) != (marker == ack_marker))
+        {
+            return std::nullopt;
+        }
+        const auto cmd_id =
+            static_cast<uint16_t>(static_cast<unsigned char>(data[3]) << 8 | static_cast<unsigned char>(data[4]));
+        return Frame{status, cmd_id};
+    }
+} // namespace responses
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string>
+
+#include "ShmRing.hpp"
+
+/**
+ * Producer end of the shared memory ring transport (see ShmRingServer), a tiny client library for local producers and
+ * tests.
+ *
+ * Creates a ring and hands its descriptors to the server over the server's unix socket. The connection stays open for
+ * the lifetime of the producer: closing it tells the server to decode the rest of the ring and end the session, and the
+ * producer notices a stopped server the same way. Written frames go straight into the ring, without system calls
+ * unless the server is asleep or the ring is full. Not thread safe.
+ */
+class ShmProducer
+{
+    ShmRing ring_;
+    int socket_ = -1;
+
+public:
+    /**
+     * Connects to the server. Failures are reported with std::system_error.
+     *
+     * @param path the unix socket of the server.
+     * @param capacity ring size, a power of two and a multiple of the page size.
+     */
+    explicit ShmProducer(const std::string& path, std::size_t capacity = 1024 * 1024);
+    ShmProducer(const ShmProducer&) = delete;
+    ShmProducer& operator=(const ShmProducer&) = delete;
+    ~ShmProducer();
+
+    /**
+     * Writes all the bytes, waiting for the server to free space if the ring is full. Throws std::runtime_error if the
+     * server closes the ring meanwhile.
+     */
+    void write(std::span<const char> data);
+
+    /**
+     * Writes as many bytes as fit without waiting.
+     *
+     * @return the number of bytes written.
+     */
+    std::size_t try_write(std::span<const char> data) { return ring_.write(data); }
+};
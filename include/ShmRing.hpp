@@ -0,0 +1,117 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * Layout of a shared memory ring: a single producer single consumer byte stream between two processes on the same
+ * host.
+ *
+ * The ring is a sealed memfd: a control page followed by the data area of a power of two capacity. The producer writes
+ * the bytes it sends at head and the consumer reads them at tail; both positions only grow and are taken modulo the
+ * capacity. Two eventfds wake the sides up: "data" tells the consumer that the head has moved and "space" tells the
+ * producer that the tail has moved. Either side only signals when the other one has announced that it is about to
+ * sleep, so a busy ring needs no system calls at all.
+ */
+namespace shm_ring
+{
+    inline constexpr uint64_t magic = 0x31474e49524d4853; // "SHMRING1" little endian
+    inline constexpr std::size_t control_size = 4096;
+
+    struct Control
+    {
+        uint64_t magic;
+        // Written by the producer.
+        alignas(64) std::atomic<uint64_t> head;
+        std::atomic<uint32_t> producer_waiting;
+        // Written by the consumer.
+        alignas(64) std::atomic<uint64_t> tail;
+        std::atomic<uint32_t> consumer_waiting;
+    };
+    static_assert(sizeof(Control) <= control_size);
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free);
+} // namespace shm_ring
+
+/**
+ * One side of a shared memory ring (see the shm_ring namespace): the mapping and the three file descriptors. The
+ * producer creates the ring and passes the descriptors to the consumer, which attaches to it. Failures are reported
+ * with std::system_error, invalid rings with std::runtime_error.
+ *
+ * The positions written by the other side are validated, but the data is not copied: the consumer reads it in place,
+ * so the producer must be trusted not to modify the bytes it has published.
+ */
+class ShmRing
+{
+    int memory_fd_ = -1;
+    int data_event_ = -1;
+    int space_event_ = -1;
+    void* mapping_ = nullptr;
+    std::size_t capacity_ = 0;
+    shm_ring::Control* control_ = nullptr;
+    char* data_ = nullptr;
+
+    void map_();
+    void release_();
+    static void signal_(int event);
+
+public:
+    /**
+     * Creates a new ring.
+     *
+     * @param capacity data area size, a power of two and a multiple of the page size.
+     */
+    explicit ShmRing(std::size_t capacity);
+
+    /**
+     * Attaches to a ring created by another process. Takes the ownership of the descriptors, they are closed on
+     * failure too.
+     */
+    ShmRing(int memory_fd, int data_event, int space_event);
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+    ~ShmRing();
+
+    // The descriptors to pass to the other side: memory, data event and space event.
+    [[nodiscard]] std::array<int, 3> descriptors() const { return {memory_fd_, data_event_, space_event_}; }
+
+    [[nodiscard]] int data_event() const { return data_event_; }
+
+    [[nodiscard]] int space_event() const { return space_event_; }
+
+    [[nodiscard]] std::size_t capacity() const { return capacity_; }
+
+    /**
+     * Producer side: copies as much of the data as fits and wakes the consumer up if it is waiting.
+     *
+     * @return the number of bytes written, 0 if the ring is full.
+     */
+    std::size_t write(std::span<const char> data);
+
+    /**
+     * Producer side: announces that the producer is going to wait for space.
+     *
+     * @return false if there is space already, so the producer must not wait.
+     */
+    bool prepare_space_wait();
+
+    /**
+     * Consumer side: the published bytes starting at the tail, in one or, when they wrap around, two parts. Throws if
+     * the producer has published an impossible head.
+     */
+    [[nodiscard]] std::array<std::span<char>, 2> readable() const;
+
+    /**
+     * Consumer side: frees the bytes at the tail and wakes the producer up if it is waiting for space.
+     */
+    void consume(std::size_t length);
+
+    /**
+     * Consumer side: announces that the consumer is going to wait for data.
+     *
+     * @return false if there is data already, so the consumer must not wait.
+     */
+    bool prepare_data_wait();
+};
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <boost/asio.hpp>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+
+#include "Metrics.hpp"
+#include "ShmRing.hpp"
+#include "TcpServer.hpp"
+#include "UnixServer.hpp"
+
+namespace tcp_server
+{
+    /**
+     * Receives the data of local producers through shared memory rings (see ShmRing and ShmProducer) instead of
+     * sockets.
+     *
+     * A producer connects to the server's unix socket and sends the descriptors of its ring. The connection then only
+     * tells that the producer is alive: once it is closed, the rest of the ring is decoded and the session ends. The
+     * ring's data eventfd is watched by the io_context; once woken, the session passes the published bytes to its
+     * buffer handler in place, straight from the shared memory, and goes back to sleep only when the ring is empty. A
+     * producer that keeps the ring busy is served without any system calls on either side.
+     *
+     * Same threading rules and buffer handler requirements as TcpServer. Every ring has its own buffer handler, made by
+     * the factory, exactly like a connection. A producer that corrupts the ring positions loses its session. Rings are
+     * one way: the responses of ResponseSource handlers are dropped.
+     */
+    template <BufferHandlerFactory Factory>
+    class ShmRingServer
+    {
+        using BufferHandlerPtr = decltype(std::declval<Factory&>()());
+
+        stream_protocol::acceptor acceptor_;
+        Factory& factory_;
+        // Empty if the socket file belongs to another server.
+        std::string owned_path_;
+
+        void do_accept()
+        {
+            acceptor_.async_accept(
+                [this](boost::system::error_code ec, stream_protocol::socket socket)
+                {
+                    if (acceptor_.is_open()) // do not try to wait further if the acceptor was stopped (it will hang)
+                    {
+                        if (!ec)
+                        {
+                            std::make_shared<Session>(std::move(socket), factory_)->start();
+                        }
+                        do_accept();
+                    }
+                });
+        }
+
+        // A single producer: its connection and, once the descriptors arrive, its ring.
+        struct Session : std::enable_shared_from_this<Session>
+        {
+            // Limits the bytes decoded per wakeup, so a busy ring can not starve the rest of the event loop.
+            static constexpr int max_rounds_per_wakeup = 4;
+            // Descriptors received at most with the ring ones, see attach().
+            static constexpr std::size_t max_descriptors = 16;
+
+            stream_protocol::socket control_;
+            Factory& factory_;
+            std::unique_ptr<ShmRing> ring_;
+            boost::asio::posix::stream_descriptor data_event_;
+            BufferHandlerPtr handler_{};
+
+            Session(stream_protocol::socket&& control, Factory& factory) :
+                control_{std::move(control)}, factory_{factory}, data_event_{control_.get_executor()}
+            {
+            }
+
+            ~Session()
+            {
+                if (ring_)
+                {
+                    metrics::add(metrics::Counter::connections_closed);
+                }
+            }
+
+            void start()
+            {
+                control_.async_wait(stream_protocol::socket::wait_read,
+                                    [self = this->shared_from_this()](boost::system::error_code ec)
+                                    {
+                                        if (!ec)
+                                        {
+                                            self->attach();
+                                        }
+                                    });
+            }
+
+            // The producer has sent the ring descriptors (or closed the connection).
+            void attach()
+            {
+                char byte = 0;
+                iovec data{&byte, 1};
+                // Room for more descriptors than a ring has, so that extra ones are received and closed here. Whatever
+                // does not fit is not passed at all (MSG_CTRUNC).
+                alignas(cmsghdr) char control[CMSG_SPACE(max_descriptors * sizeof(int))]{};
+                msghdr message{};
+                message.msg_iov = &data;
+                message.msg_iovlen = 1;
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+                if (::recvmsg(control_.native_handle(), &message, MSG_CMSG_CLOEXEC | MSG_DONTWAIT) != 1)
+                {
+                    return;
+                }
+                std::array<int, max_descriptors> received{};
+                std::size_t count = 0;
+                for (auto* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg))
+                {
+                    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+                    {
+                        const auto size =
+                            std::min((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int), received.size() - count);
+                        std::memcpy(received.data() + count, CMSG_DATA(cmsg), size * sizeof(int));
+                        count += size;
+                    }
+                }
+                const auto used = count == 3 && (message.msg_flags & MSG_CTRUNC) == 0 ? std::size_t{3} : 0;
+                for (std::size_t i = used; i < count; i++)
+                {
+                    ::close(received[i]);
+                }
+                if (used == 0)
+                {
+                    return;
+                }
+                try
+                {
+                    ring_ = std::make_unique<ShmRing>(received[0], received[1], received[2]);
+                    // The ring keeps its own descriptor, the stream descriptor closes a duplicate.
+                    const int event = ::dup(ring_->data_event());
+                    if (event < 0)
+                    {
+                        ring_.reset();
+                        return;
+                    }
+                    data_event_.assign(event);
+                    // The eventfd comes from the producer: it must not block the event loop on reads (the duplicate
+                    // shares the flag with the ring's descriptor).
+                    boost::system::error_code ec;
+                    data_event_.non_blocking(true, ec);
+                    if (ec)
+                    {
+                        data_event_.close(ec);
+                        ring_.reset();
+                        return;
+                    }
+                }
+                catch (const std::runtime_error&)
+                {
+                    ring_.reset();
+                    return; // not a valid ring, drop the producer
+                }
+                handler_ = factory_();
+                metrics::add(metrics::Counter::connections_opened);
+                do_data(); // the producer may have written before the session started to wait
+                wait_closed();
+            }
+
+            void wait_data()
+            {
+                data_event_.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                                       [self = this->shared_from_this()](boost::system::error_code ec)
+                                       {
+                                           if (!ec)
+                                           {
+                                               self->do_data();
+                                           }
+                                       });
+            }
+
+            // The producer has published data while the session was asleep.
+            void do_data()
+            {
+                if (!data_event_.is_open())
+                {
+                    return; // closed by the producer meanwhile
+                }
+                uint64_t count = 0;
+                [[maybe_unused]] const auto cleared = ::read(data_event_.native_handle(), &count, sizeof(count));
+                if (!drain())
+                {
+                    close();
+                    return;
+                }
+                if (ring_->prepare_data_wait())
+                {
+                    wait_data();
+                }
+                else
+                {
+                    // More data is published already - continue after the other event loop users had their turn.
+                    boost::asio::post(data_event_.get_executor(),
+                                      [self = this->shared_from_this()] { self->do_data(); });
+                }
+            }
+
+            /**
+             * Passes the published bytes to the handler in place and frees them. Exceptions of the handler are not
+             * caught, as with the socket servers.
+             *
+             * @return false if the ring is corrupt.
+             */
+            bool drain()
+            {
+                for (int round = 0; round < max_rounds_per_wakeup; round++)
+                {
+                    std::array<std::span<char>, 2> parts;
+                    try
+                    {
+                        parts = ring_->readable();
+                    }
+                    catch (const std::runtime_error&)
+                    {
+                        return false;
+                    }
+                    if (parts[0].empty())
+                    {
+                        break;
+                    }
+                    for (const auto part : parts)
+                    {
+                        if (!part.empty())
+                        {
+                            const metrics::ReadScope read_scope(part.size());
+                            (*handler_)(part);
+                        }
+                    }
+                    ring_->consume(parts[0].size() + parts[1].size());
+                    if constexpr (ResponseSource<std::remove_reference_t<decltype(*handler_)>>)
+                    {
+                        handler_->responses().clear(); // nobody to send them to
+                    }
+                }
+                return true;
+            }
+
+            // The producer never sends anything after the descriptors, so a readable connection means it is closed.
+            void wait_closed()
+            {
+                control_.async_wait(stream_protocol::socket::wait_read,
+                                    [self = this->shared_from_this()](boost::system::error_code ec)
+                                    {
+                                        if (!ec)
+                                        {
+                                            // Everything published before closing is visible now.
+                                            self->drain();
+                                            self->close();
+                                        }
+                                    });
+            }
+
+            // Cancels the pending waits, the session is destroyed with the last handler.
+            void close()
+            {
+                boost::system::error_code ignored;
+                data_event_.close(ignored);
+                control_.close(ignored);
+            }
+        };
+
+        static stream_protocol::acceptor make_acceptor_(boost::asio::io_context& io_context, const std::string& path)
+        {
+            auto acceptor = stream_protocol::acceptor{io_context};
+            listen(acceptor, path);
+            return acceptor;
+        }
+
+        static stream_protocol::acceptor make_acceptor_(boost::asio::io_context& io_context, ShmRingServer& other)
+        {
+            auto acceptor = stream_protocol::acceptor{io_context};
+            share(acceptor, other.acceptor_);
+            return acceptor;
+        }
+
+    public:
+        /**
+         * @param io_context Boost::asio context
+         * @param handlerFactory The factory object responsible for creating unique pointers to BufferHandlers, one per
+         * ring.
+         * @param path the unix socket file the producers connect to.
+         */
+        ShmRingServer(boost::asio::io_context& io_context, Factory& handlerFactory, const std::string& path) :
+            acceptor_{make_acceptor_(io_context, path)}, factory_{handlerFactory}, owned_path_{path}
+        {
+            do_accept();
+        }
+
+        /**
+         * Accepts the producers of another server's socket, e.g. in another event loop thread (see share).
+         */
+        ShmRingServer(boost::asio::io_context& io_context, Factory& handlerFactory, ShmRingServer& listening) :
+            acceptor_{make_acceptor_(io_context, listening)}, factory_{handlerFactory}
+        {
+            do_accept();
+        }
+
+        ShmRingServer(const ShmRingServer&) = delete;
+        ShmRingServer& operator=(const ShmRingServer&) = delete;
+
+        ~ShmRingServer()
+        {
+            if (!owned_path_.empty())
+            {
+                ::unlink(owned_path_.c_str());
+            }
+        }
+
+        /**
+         * A method of gracefully stopping the server. Active rings are served until their producers disconnect.
+         */
+        void stop() { acceptor_.close(); }
+
+        /**
+         * @return the socket file path.
+         */
+        [[nodiscard]] std::string path() const { return acceptor_.local_endpoint().path(); }
+    };
+} // namespace tcp_server
@@ -0,0 +1,16 @@
+#pragma once
+#include <cerrno>
+#include <system_error>
+
+namespace sys
+{
+    /**
+     * Throws the error of the last failed system call (errno) as a std::system_error.
+     *
+     * @param what the failed call, used as the exception message prefix.
+     */
+    [[noreturn]] inline void throw_errno(const char* what)
+    {
+        throw std::system_error(errno, std::system_category(), what);
+    }
+} // namespace sys
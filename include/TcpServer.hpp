@@ -1,12 +1,28 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <boost/asio.hpp>
+#include <cerrno>
 #include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <netinet/tcp.h>
+#include <new>
 #include <span>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "MemoryPool.hpp"
+#include "Metrics.hpp"
 
 /**
- * This namespace contains only one directly usable class template - TcpServer.
+ * This namespace contains the servers - TcpServer, UnixServer, UringTcpServer, UdpServer and ShmRingServer.
  * All other members are primarily for internal use.
  */
 namespace tcp_server
@@ -14,7 +30,23 @@ namespace tcp_server
     // Just a few shortcuts.
     using boost::asio::ip::tcp;
     namespace ip = boost::asio::ip;
-    namespace placeholders = boost::asio::placeholders;
+#ifdef SO_REUSEPORT
+    // Allows several acceptors to listen on the same port. The kernel distributes incoming connections between them.
+    using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+#ifdef TCP_QUICKACK
+    // Acknowledges the received data right away instead of waiting for a response to piggyback on. Not sticky, the
+    // kernel may drop back to delayed acknowledgements at any time, so it is set again after every read.
+    using quick_ack = boost::asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_QUICKACK>;
+#endif
+#ifdef SO_BUSY_POLL
+    // Microseconds a read of an empty socket polls the device queue for before giving up.
+    using busy_poll = boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL>;
+#endif
+#ifdef SO_TIMESTAMPNS
+    // The kernel reports the receive time of the data with every recvmsg.
+    using receive_timestamps = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_TIMESTAMPNS>;
+#endif
 
     // An attempt to provide better type checking for the handler factory template parameter.
     template <typename Fct>
@@ -25,36 +57,406 @@ namespace tcp_server
     };
 
     /**
-     * Boost::asio based tcp server. Accepts incoming connections on the specified port (or on automatically assigned if
-     * zero).
+     * A buffer handler that has data to send back to its client, e.g. a PacketParser with responses enabled. After
+     * every call the session takes the bytes collected in the vector (leaving it empty) and writes them to the
+     * connection.
+     */
+    template <typename Handler>
+    concept ResponseSource = requires(Handler h) {
+        { h.responses() } -> std::same_as<std::vector<char>&>;
+    };
+
+    /**
+     * Memory for the single pending completion handler of a session (see the custom allocation example in the
+     * asio documentation). asio releases the memory before the handler is invoked, so the handler can start the next
+     * read using the same memory. Larger or overlapping requests fall back to the global operator new.
+     */
+    class HandlerMemory
+    {
+        // Enough for a read or wait operation with a wrapped lambda holding a shared_ptr.
+        alignas(std::max_align_t) std::array<unsigned char, 256> storage_;
+        bool in_use_ = false;
+
+    public:
+        HandlerMemory() = default;
+        HandlerMemory(const HandlerMemory&) = delete;
+        HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+        void* allocate(std::size_t size)
+        {
+            if (!in_use_ && size <= storage_.size())
+            {
+                in_use_ = true;
+                return storage_.data();
+            }
+            return ::operator new(size);
+        }
+
+        void deallocate(void* pointer)
+        {
+            if (pointer == storage_.data())
+            {
+                in_use_ = false;
+            }
+            else
+            {
+                ::operator delete(pointer);
+            }
+        }
+    };
+
+    // Standard allocator over HandlerMemory, associated with the completion handlers by HandlerWithMemory.
+    template <typename T>
+    class HandlerAllocator
+    {
+        template <typename U>
+        friend class HandlerAllocator;
+
+        HandlerMemory& memory_;
+
+    public:
+        using value_type = T;
+
+        explicit HandlerAllocator(HandlerMemory& memory) : memory_{memory} {}
+
+        template <typename U>
+        explicit(false) HandlerAllocator(const HandlerAllocator<U>& other) noexcept : memory_{other.memory_}
+        {
+        }
+
+        T* allocate(std::size_t n) const { return static_cast<T*>(memory_.allocate(sizeof(T) * n)); }
+
+        void deallocate(T* p, std::size_t) const { memory_.deallocate(p); }
+
+        template <typename U>
+        bool operator==(const HandlerAllocator<U>& other) const noexcept
+        {
+            return &memory_ == &other.memory_;
+        }
+    };
+
+    // A completion handler wrapper that makes asio allocate the operation state from the given memory.
+    template <typename Handler>
+    class HandlerWithMemory
+    {
+        HandlerMemory& memory_;
+        Handler handler_;
+
+    public:
+        using allocator_type = HandlerAllocator<Handler>;
+
+        HandlerWithMemory(HandlerMemory& memory, Handler handler) : memory_{memory}, handler_{std::move(handler)} {}
+
+        allocator_type get_allocator() const noexcept { return allocator_type(memory_); }
+
+        template <typename... Args>
+        void operator()(Args&&... args)
+        {
+            handler_(std::forward<Args>(args)...);
+        }
+    };
+
+    /**
+     * Socket level tuning of the TCP connections for latency sensitive clients. Everything is off by default, which
+     * keeps the kernel defaults.
+     */
+    struct SocketOptions
+    {
+        // Send the responses right away instead of coalescing small writes (TCP_NODELAY).
+        bool no_delay = false;
+        // Acknowledge every read right away (TCP_QUICKACK, see quick_ack).
+        bool quick_ack = false;
+        // Kernel receive buffer of a connection in bytes (SO_RCVBUF), 0 keeps the automatic sizing.
+        int receive_buffer = 0;
+        // Microseconds a read of an empty socket busy polls the device queue for (SO_BUSY_POLL), 0 disables it.
+        // Raising it above the net.core.busy_read sysctl requires CAP_NET_ADMIN.
+        int busy_poll_us = 0;
+        // Record the time from the kernel receiving the data to the buffer handler call (the receive_latency_ns
+        // histogram, see Metrics.hpp). The sessions then wait for readiness and read with recvmsg.
+        bool receive_timestamps = false;
+    };
+
+    /**
+     * Applies the socket options to a listening socket before it starts listening. The accepted connections inherit
+     * them (Linux), the receive buffer has to be known before the handshake to pick the window scale. Unsupported
+     * options are reported with std::runtime_error, failures with boost::system::system_error.
+     */
+    inline void configure(tcp::acceptor& acceptor, const SocketOptions& options)
+    {
+        if (options.no_delay)
+        {
+            acceptor.set_option(tcp::no_delay(true));
+        }
+        if (options.receive_buffer > 0)
+        {
+            acceptor.set_option(boost::asio::socket_base::receive_buffer_size(options.receive_buffer));
+        }
+        if (options.busy_poll_us > 0)
+        {
+#ifdef SO_BUSY_POLL
+            acceptor.set_option(busy_poll(options.busy_poll_us));
+#else
+            throw std::runtime_error("Busy polling is not supported on this platform");
+#endif
+        }
+#ifndef TCP_QUICKACK
+        if (options.quick_ack)
+        {
+            throw std::runtime_error("Quick acknowledgements are not supported on this platform");
+        }
+#endif
+        if (options.receive_timestamps)
+        {
+#ifdef SO_TIMESTAMPNS
+            acceptor.set_option(tcp_server::receive_timestamps(true));
+#else
+            throw std::runtime_error("Receive timestamps are not supported on this platform");
+#endif
+        }
+    }
+
+    /**
+     * read_some of a non-blocking socket with receive_timestamps enabled: reads the available data with recvmsg and
+     * records the time since the kernel received it in the receive_latency_ns histogram. The errors are reported like
+     * read_some does, including would_block and eof.
+     */
+    inline std::size_t read_timestamped(int fd, std::span<char> buffer, boost::system::error_code& ec)
+    {
+#ifdef SO_TIMESTAMPNS
+        iovec data{buffer.data(), buffer.size()};
+        alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(timespec))> control;
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control.data();
+        message.msg_controllen = control.size();
+        ssize_t length;
+        do
+        {
+            length = ::recvmsg(fd, &message, 0);
+        } while (length < 0 && errno == EINTR);
+        if (length < 0)
+        {
+            ec = errno == EAGAIN || errno == EWOULDBLOCK
+                     ? boost::asio::error::would_block
+                     : boost::system::error_code(errno, boost::system::system_category());
+            return 0;
+        }
+        if (length == 0)
+        {
+            ec = boost::asio::error::eof;
+            return 0;
+        }
+        ec = {};
+        for (auto* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+        {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_TIMESTAMPNS)
+            {
+                timespec received;
+                std::memcpy(&received, CMSG_DATA(header), sizeof(received));
+                timespec now;
+                ::clock_gettime(CLOCK_REALTIME, &now);
+                // The stamp is taken by the kernel in the wall clock time, which may step backwards.
+                const auto latency = (now.tv_sec - received.tv_sec) * 1'000'000'000LL + now.tv_nsec - received.tv_nsec;
+                metrics::record(metrics::Histogram::receive_latency_ns, static_cast<uint64_t>(std::max(0LL, latency)));
+            }
+        }
+        return static_cast<std::size_t>(length);
+#else
+        (void)fd;
+        (void)buffer;
+        ec = boost::asio::error::operation_not_supported;
+        return 0;
+#endif
+    }
+
+    /**
+     * Opens the acceptor and starts listening on the port.
+     *
+     * @param share_port allow other acceptors to listen on the same port (SO_REUSEPORT). All of them must enable it.
+     * @param socket_options tuning of the accepted connections, see configure.
+     */
+    inline void listen(tcp::acceptor& acceptor, ip::port_type port, bool share_port,
+                       const SocketOptions& socket_options = {})
+    {
+        const auto endpoint = tcp::endpoint{tcp::v4(), port};
+        acceptor.open(endpoint.protocol());
+        acceptor.set_option(tcp::acceptor::reuse_address(true));
+        if (share_port)
+        {
+#ifdef SO_REUSEPORT
+            acceptor.set_option(reuse_port(true));
+#else
+            throw std::runtime_error("Port sharing is not supported on this platform");
+#endif
+        }
+        configure(acceptor, socket_options);
+        acceptor.bind(endpoint);
+        acceptor.listen();
+    }
+
+    // Receive settings of a server.
+    struct ReceiveOptions
+    {
+        // Initial and smallest size of a session buffer.
+        std::size_t min_buffer_size = 256;
+        // Largest size of a session buffer. Also the size of the shared buffer.
+        std::size_t max_buffer_size = 64 * 1024;
+        // Sessions do not own buffers. They wait for the socket to become readable and read into a buffer shared by
+        // all the sessions of the server, so idle connections hold no buffer memory.
+        bool shared_buffer = false;
+        // Limit of the responses queued for a connection in bytes (see ResponseSource). Once it is reached, the session
+        // stops reading until the client has read some of them, so a client that never reads can not make the server
+        // queue without bound. A single read may still add its responses on top of the limit.
+        std::size_t max_pending_responses = 64 * 1024;
+        // Socket level tuning of the connections. TCP servers only, the other stream servers ignore it.
+        SocketOptions socket{};
+    };
+
+    /**
+     * A session receive buffer that follows the observed read sizes.
+     *
+     * Doubles when a read fills the whole buffer (the socket probably has more data queued) and halves after a
+     * number of consecutive reads that used less than a quarter of it. Stays within the configured limits.
+     */
+    class AdaptiveBuffer
+    {
+        // Consecutive small reads required to shrink the buffer, so a single short read does not cause a reallocation.
+        static constexpr unsigned int shrink_after = 16;
+
+        std::size_t size_;
+        const std::size_t min_size_;
+        const std::size_t max_size_;
+        std::unique_ptr<char[]> data_;
+        unsigned int small_reads_ = 0;
+
+        void resize_(std::size_t size)
+        {
+            size_ = size;
+            data_ = std::make_unique_for_overwrite<char[]>(size_);
+            small_reads_ = 0;
+        }
+
+    public:
+        /**
+         * Zero sizes create an empty buffer without any memory.
+         */
+        AdaptiveBuffer(std::size_t min_size, std::size_t max_size) :
+            size_{min_size}, min_size_{min_size}, max_size_{max_size},
+            data_{min_size > 0 ? std::make_unique_for_overwrite<char[]>(min_size) : nullptr}
+        {
+        }
+
+        /**
+         * @return the memory to read into.
+         */
+        [[nodiscard]] std::span<char> data() const { return {data_.get(), size_}; }
+
+        /**
+         * Adjusts the size for the next read. The contents are not preserved.
+         *
+         * @param length number of bytes received by the last read.
+         */
+        void record_read(std::size_t length)
+        {
+            if (length == size_ && size_ < max_size_)
+            {
+                resize_(std::min(size_ * 2, max_size_));
+            }
+            else if (length <= size_ / 4 && size_ > min_size_)
+            {
+                if (++small_reads_ == shrink_after)
+                {
+                    resize_(std::max(size_ / 2, min_size_));
+                }
+            }
+            else
+            {
+                small_reads_ = 0;
+            }
+        }
+    };
+
+    /**
+     * Boost::asio based stream socket server, the common part of TcpServer and UnixServer. Accepts incoming connections
+     * on a listening acceptor.
      *
      * Expects io_context.run() to be called after the servers construction as any other Boost::asio asynchronous user.
+     * The server and its sessions are not synchronized, so the io_context must be run by a single thread. To use more
+     * cores, create one io_context and one server per thread with port sharing enabled.
      *
      * Data bytes received from connections are forwarded to buffer handler objects (one handler per connection).
      * Buffer handlers must be provided by a factory object specified at server creation time.
      *
-     * @tparam Factory A callable object that provides unique_ptrs to buffer handlers. A buffer handler is
-     * another callable object that accepts a sequence of bytes received from the network in the form of
-     * std::span<char>.
-     * @tparam receive_buffer_size A size of receive buffer allocated for each new TCP session.
+     * Every session either owns an AdaptiveBuffer or, in the shared buffer mode, waits for the socket readiness and
+     * reads into a buffer shared by all the sessions of the server (see ReceiveOptions).
+     *
+     * Buffer handlers that are a ResponseSource can answer their clients. The responses of a read are queued and
+     * written with a single write; whatever the handler adds while a write is in flight goes out with the next one.
+     * Reading pauses while the queue is over its limit.
+     *
+     * TCP connections apply the SocketOptions of the receive options: the listening socket is configured by TcpServer,
+     * sessions re-arm the quick acknowledgements after every read and, with receive timestamps, wait for readiness and
+     * read with read_timestamped like in the shared buffer mode.
+     *
+     * Sessions are allocated from a per-server memory pool and the completion handlers use memory owned by the
+     * session, so after the warm-up neither new connections nor reads allocate from the heap (apart from what the
+     * factory does - it can use an ObjectPool too, and adaptive buffer resizing). The reference keeping a session alive
+     * is moved from every read handler to the next one, so reads do not touch the reference count either.
+     *
+     * @tparam Protocol an asio stream protocol, e.g. tcp or local::stream_protocol.
+     * @tparam Factory A callable object that provides unique_ptrs (possibly with a custom deleter) to buffer handlers.
+     * A buffer handler is another callable object that accepts a sequence of bytes received from the network in the
+     * form of std::span<char>.
      */
-    template <BufferHandlerFactory Factory, int receive_buffer_size>
-    class TcpServer
+    template <typename Protocol, BufferHandlerFactory Factory>
+    class StreamServer
     {
-        tcp::acceptor acceptor_;
+        using Socket = typename Protocol::socket;
+        static constexpr bool is_tcp = std::is_same_v<Protocol, tcp>;
+
+        // The buffer shared by all the sessions in the shared buffer mode. Sessions keep it alive as they may outlive
+        // the server.
+        struct SharedBuffer
+        {
+            std::unique_ptr<char[]> data;
+            std::size_t size;
+        };
+
+        typename Protocol::acceptor acceptor_;
         Factory& factory_; // The factory returns unique_ptr<BufferHandlerType>
-        using BufferHandlerType = typename std::remove_reference<decltype(*factory_())>::type;
+        using BufferHandlerPtr = decltype(factory_());
+        const ReceiveOptions receive_options_;
+        std::shared_ptr<SharedBuffer> shared_buffer_;
+        // Memory of the finished sessions, reused for the new ones.
+        std::shared_ptr<MemoryPool> session_pool_ = std::make_shared<MemoryPool>();
 
     public:
         /**
-         * @param io_context Boost::asio context
+         * @param acceptor an open acceptor listening for connections.
          * @param handlerFactory The factory object responsible for creating unique pointers to BufferHandlers used by
          * client connections.
-         * @param port TCP port to listen on (0 for automatic selection)
+         * @param receive_options receive buffer settings
          */
-        TcpServer(boost::asio::io_context& io_context, Factory& handlerFactory, ip::port_type port) :
-            acceptor_{io_context, tcp::endpoint{tcp::v4(), port}}, factory_{handlerFactory}
+        StreamServer(typename Protocol::acceptor&& acceptor, Factory& handlerFactory, ReceiveOptions receive_options) :
+            acceptor_{std::move(acceptor)}, factory_{handlerFactory}, receive_options_{receive_options}
         {
+            if (receive_options_.min_buffer_size == 0 ||
+                receive_options_.min_buffer_size > receive_options_.max_buffer_size)
+            {
+                throw std::invalid_argument("Invalid receive buffer sizes");
+            }
+            if (receive_options_.max_pending_responses == 0)
+            {
+                throw std::invalid_argument("Invalid response queue size");
+            }
+            if (receive_options_.shared_buffer)
+            {
+                shared_buffer_ = std::make_shared<SharedBuffer>(
+                    std::make_unique_for_overwrite<char[]>(receive_options_.max_buffer_size),
+                    receive_options_.max_buffer_size);
+            }
+
             do_accept(); // start listening immediately after construction
         }
 
@@ -63,17 +465,17 @@ namespace tcp_server
          */
         void stop() { acceptor_.close(); }
 
-        /**
-         * @return TCP port number used by the server.
-         */
-        [[nodiscard]] ip::port_type port() const { return acceptor_.local_endpoint().port(); }
+    protected:
+        [[nodiscard]] const typename Protocol::acceptor& acceptor() const { return acceptor_; }
+
+        [[nodiscard]] typename Protocol::acceptor& acceptor() { return acceptor_; }
 
     private:
         void do_accept()
         {
             // asynchronously wait for the incoming connection
             acceptor_.async_accept(
-                [this](boost::system::error_code ec, tcp::socket socket)
+                [this](boost::system::error_code ec, Socket socket)
                 {
                     // incoming connection attempt
                     if (acceptor_.is_open()) // do not try to wait further if the acceptor was stopped (it will hang)
@@ -83,7 +485,9 @@ namespace tcp_server
                             // The session owning shared_pointer will be saved in the socket context as long as
                             // the connection remains active.
                             // unique_ptr<BufferHandler> obtained from the factory is owned by the session.
-                            std::make_shared<Session>(std::move(socket), std::move(factory_()))->start();
+                            std::allocate_shared<Session>(PoolAllocator<Session>(session_pool_), std::move(socket),
+                                                          factory_(), receive_options_, shared_buffer_)
+                                ->start();
                         }
                         // wait for another connection (not a recursion, creates a new lambda)
                         do_accept();
@@ -94,36 +498,297 @@ namespace tcp_server
         // Nested private class responsible for handling a single connection
         struct Session : std::enable_shared_from_this<Session>
         {
-            tcp::socket socket_;
-            std::unique_ptr<BufferHandlerType> handler_;
-            std::array<char, receive_buffer_size> buffer_;
+            // Limits the number of reads per readiness notification in the shared buffer mode, so a single busy
+            // connection can not starve the others.
+            static constexpr int max_reads_per_wait = 16;
+
+            using BufferHandler = std::remove_reference_t<decltype(*std::declval<BufferHandlerPtr&>())>;
 
-            Session(tcp::socket&& socket, std::unique_ptr<BufferHandlerType> handler) :
-                socket_{std::move(socket)}, handler_{std::move(handler)}, buffer_{}
+            Socket socket_;
+            BufferHandlerPtr handler_;
+            AdaptiveBuffer buffer_; // not used in the shared buffer mode
+            std::shared_ptr<SharedBuffer> shared_buffer_;
+            HandlerMemory handler_memory_;
+            // Responses queued while a write is in flight, and the ones being written. Swapped when a write starts, so
+            // both keep their capacity.
+            std::vector<char> pending_responses_;
+            std::vector<char> written_responses_;
+            const std::size_t max_pending_responses_;
+            HandlerMemory write_memory_;
+            bool writing_ = false;
+            bool read_paused_ = false;
+            const bool quick_ack_;
+            const bool timestamps_;
+
+            Session(Socket&& socket, BufferHandlerPtr handler, const ReceiveOptions& options,
+                    std::shared_ptr<SharedBuffer> shared_buffer) :
+                socket_{std::move(socket)}, handler_{std::move(handler)},
+                buffer_{shared_buffer ? 0 : options.min_buffer_size, shared_buffer ? 0 : options.max_buffer_size},
+                shared_buffer_{std::move(shared_buffer)}, max_pending_responses_{options.max_pending_responses},
+                quick_ack_{is_tcp && options.socket.quick_ack}, timestamps_{is_tcp && options.socket.receive_timestamps}
             {
+                if (shared_buffer_ || timestamps_)
+                {
+                    socket_.non_blocking(true); // reads must not block the event loop after the readiness wait
+                }
+                metrics::add(metrics::Counter::connections_opened);
             }
 
+            ~Session() { metrics::add(metrics::Counter::connections_closed); }
+
             // Start waiting for the data to be received.
             void start()
             {
-                // Read any available data into the buffer_. Might be one TCP packet at a time.
-                // A shared pointer to this will be saved in the completion token.
-                socket_.async_read_some(boost::asio::buffer(buffer_),
-                                        std::bind(&Session::do_read, this->shared_from_this(), placeholders::error,
-                                                  placeholders::bytes_transferred));
+                if (shared_buffer_ || timestamps_)
+                {
+                    wait_ready(this->shared_from_this());
+                }
+                else
+                {
+                    read(this->shared_from_this());
+                }
+            }
+
+            // Read any available data into the buffer_. Might be one TCP packet at a time.
+            // The shared pointer to this is moved into the completion token and from there to the next one.
+            void read(std::shared_ptr<Session> self)
+            {
+                const auto buffer = buffer_.data();
+                socket_.async_read_some(boost::asio::buffer(buffer.data(), buffer.size()),
+                                        HandlerWithMemory(handler_memory_,
+                                                          [self = std::move(self)](boost::system::error_code ec,
+                                                                                   std::size_t length) mutable
+                                                          {
+                                                              auto& session = *self;
+                                                              session.do_read(std::move(self), ec, length);
+                                                          }));
             }
 
             // Some data was received into the buffer_ - pass it to the handler.
-            void do_read(boost::system::error_code ec, std::size_t length)
+            void do_read(std::shared_ptr<Session> self, boost::system::error_code ec, std::size_t length)
             {
-                (*handler_)(std::span(buffer_.data(), length));
-                // if the connection is terminated, the completion token will be destroyed along with the only
-                // remaining shared pointer to this session...
+                acknowledge();
+                {
+                    const metrics::ReadScope read_scope(length);
+                    (*handler_)(buffer_.data().first(length));
+                }
+                const bool can_read = queue_responses();
+                // if the connection is terminated, self is the last shared pointer to this session and destroys it on
+                // return (or the pending write of the responses does)...
                 if (!ec)
                 {
-                    start(); // ... and if it's still active another token will be created in the start call.
+                    buffer_.record_read(length);
+                    if (can_read)
+                    {
+                        read(std::move(self)); // ... and if it's still active it's moved to the next token.
+                    }
+                    else
+                    {
+                        pause_reading();
+                    }
+                }
+            }
+
+            // Wait for the data without reading it, either to read into the shared buffer or to read with timestamps.
+            void wait_ready(std::shared_ptr<Session> self)
+            {
+                socket_.async_wait(Socket::wait_read,
+                                   HandlerWithMemory(handler_memory_,
+                                                     [self = std::move(self)](boost::system::error_code ec) mutable
+                                                     {
+                                                         auto& session = *self;
+                                                         session.do_wait(std::move(self), ec);
+                                                     }));
+            }
+
+            // The socket is readable - read until it is drained.
+            void do_wait(std::shared_ptr<Session> self, boost::system::error_code ec)
+            {
+                if (ec)
+                {
+                    return;
+                }
+                for (int i = 0; i < max_reads_per_wait; i++)
+                {
+                    const auto buffer = shared_buffer_ ? std::span(shared_buffer_->data.get(), shared_buffer_->size)
+                                                       : buffer_.data();
+                    const auto length = read_ready(buffer, ec);
+                    if (ec == boost::asio::error::would_block)
+                    {
+                        break;
+                    }
+                    acknowledge();
+                    {
+                        const metrics::ReadScope read_scope(length);
+                        (*handler_)(buffer.first(length));
+                    }
+                    const bool can_read = queue_responses();
+                    if (ec)
+                    {
+                        return; // the connection is terminated, the session is destroyed with this handler
+                    }
+                    if (!shared_buffer_)
+                    {
+                        buffer_.record_read(length);
+                    }
+                    if (!can_read)
+                    {
+                        pause_reading();
+                        return;
+                    }
+                    if (length < buffer.size())
+                    {
+                        break; // most likely nothing else is queued - do not waste a syscall
+                    }
+                }
+                wait_ready(std::move(self));
+            }
+
+            // Non-blocking read of a readable socket.
+            std::size_t read_ready(std::span<char> buffer, boost::system::error_code& ec)
+            {
+                if constexpr (is_tcp)
+                {
+                    if (timestamps_)
+                    {
+                        return read_timestamped(socket_.native_handle(), buffer, ec);
+                    }
+                }
+                return socket_.read_some(boost::asio::buffer(buffer.data(), buffer.size()), ec);
+            }
+
+            // Re-arm the quick acknowledgements after a read, the kernel turns them off on its own.
+            void acknowledge()
+            {
+#ifdef TCP_QUICKACK
+                if constexpr (is_tcp)
+                {
+                    if (quick_ack_)
+                    {
+                        boost::system::error_code ignored;
+                        socket_.set_option(quick_ack(true), ignored);
+                    }
+                }
+#endif
+            }
+
+            /**
+             * Queues the responses of the last handler call, if any, and starts writing them unless a write is in
+             * flight already.
+             *
+             * @return false if the queue is over its limit and the session must not read until it drains.
+             */
+            bool queue_responses()
+            {
+                if constexpr (ResponseSource<BufferHandler>)
+                {
+                    auto& responses = handler_->responses();
+                    if (!responses.empty())
+                    {
+                        if (pending_responses_.empty())
+                        {
+                            std::swap(pending_responses_, responses);
+                        }
+                        else
+                        {
+                            pending_responses_.insert(pending_responses_.end(), responses.begin(), responses.end());
+                            responses.clear();
+                        }
+                        write();
+                    }
+                    return !responses_full();
+                }
+                else
+                {
+                    return true;
+                }
+            }
+
+            [[nodiscard]] bool responses_full() const
+            {
+                return pending_responses_.size() + written_responses_.size() >= max_pending_responses_;
+            }
+
+            // The pending write keeps the session alive and resumes reading once the queue drains.
+            void pause_reading()
+            {
+                read_paused_ = true;
+                metrics::add(metrics::Counter::read_pauses);
+            }
+
+            // Write all the queued responses at once.
+            void write()
+            {
+                if (writing_ || pending_responses_.empty())
+                {
+                    return;
+                }
+                std::swap(pending_responses_, written_responses_);
+                writing_ = true;
+                boost::asio::async_write(socket_, boost::asio::buffer(written_responses_),
+                                         HandlerWithMemory(write_memory_,
+                                                           [self = this->shared_from_this()](
+                                                               boost::system::error_code ec, std::size_t length)
+                                                           { self->do_write(ec, length); }));
+            }
+
+            // The responses were written - write the ones queued meanwhile and resume reading if it was paused.
+            void do_write(boost::system::error_code ec, std::size_t length)
+            {
+                writing_ = false;
+                written_responses_.clear();
+                metrics::add(metrics::Counter::response_bytes, length);
+                if (ec)
+                {
+                    // The client is gone or broken. Closing cancels the read, so the session ends.
+                    boost::system::error_code ignored;
+                    socket_.close(ignored);
+                    return;
+                }
+                write();
+                if (read_paused_ && !responses_full())
+                {
+                    read_paused_ = false;
+                    start();
                 }
             }
         };
     };
+
+    /**
+     * Boost::asio based tcp server. Accepts incoming connections on the specified port (or on automatically assigned if
+     * zero). See StreamServer for the threading rules and the buffer handler requirements.
+     */
+    template <BufferHandlerFactory Factory>
+    class TcpServer : public StreamServer<tcp, Factory>
+    {
+        static tcp::acceptor make_acceptor_(boost::asio::io_context& io_context, ip::port_type port, bool share_port,
+                                            const SocketOptions& socket_options)
+        {
+            auto acceptor = tcp::acceptor{io_context};
+            listen(acceptor, port, share_port, socket_options);
+            return acceptor;
+        }
+
+    public:
+        /**
+         * @param io_context Boost::asio context
+         * @param handlerFactory The factory object responsible for creating unique pointers to BufferHandlers used by
+         * client connections.
+         * @param port TCP port to listen on (0 for automatic selection)
+         * @param share_port allow other servers to listen on the same port (SO_REUSEPORT). All of them must enable it.
+         * @param receive_options receive buffer settings
+         */
+        TcpServer(boost::asio::io_context& io_context, Factory& handlerFactory, ip::port_type port,
+                  bool share_port = false, ReceiveOptions receive_options = {}) :
+            StreamServer<tcp, Factory>{make_acceptor_(io_context, port, share_port, receive_options.socket),
+                                       handlerFactory, receive_options}
+        {
+        }
+
+        /**
+         * @return TCP port number used by the server.
+         */
+        [[nodiscard]] ip::port_type port() const { return this->acceptor().local_endpoint().port(); }
+    };
 } // namespace tcp_server
@@ -0,0 +1,154 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include "Commands.hpp"
+
+/**
+ * In-memory aggregation of the command 3 telemetry: every command 3 is a sample of a value (data_3_2) for a key
+ * (data_3_1). Keeps the count, sum, minimum, maximum and the last value of every key, so the samples do not have to go
+ * through the text output to an external aggregator.
+ *
+ * The keys are u16, so every shard is a dense table of all 65536 keys. Every thread records into its own shard, a
+ * shard has a single writer and its updates are plain loads and stores, like the metrics (see Metrics.hpp). Snapshots
+ * merge the shards on demand from any thread without stopping the writers.
+ */
+class TelemetryTable
+{
+public:
+    static constexpr std::size_t key_count = 65536;
+
+    // Aggregate of a key.
+    struct KeyStats
+    {
+        uint16_t key = 0;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint8_t min = 0;
+        uint8_t max = 0;
+        uint8_t last = 0;
+
+        bool operator==(const KeyStats&) const = default;
+    };
+
+    /**
+     * Aggregates of a single thread. Written by the owning thread only, readable from any thread. 2 MiB, so it is
+     * always allocated on the heap by the table.
+     */
+    class alignas(64) Shard
+    {
+        // Two slots per cache line, a key never straddles two lines.
+        struct alignas(32) Slot
+        {
+            std::atomic<uint64_t> count;
+            std::atomic<uint64_t> sum;
+            // Time of the last sample, to tell the last value of the key among the shards.
+            std::atomic<uint64_t> time_ns;
+            // min | max << 8 | last << 16, so the three are always consistent with each other.
+            std::atomic<uint32_t> values;
+        };
+
+        std::array<Slot, key_count> slots_{};
+
+    public:
+        /**
+         * Adds a sample.
+         *
+         * @param time_ns time of the sample in steady clock nanoseconds. Reading the clock per sample is not necessary:
+         * the batch time (see TelemetryAggregator) is enough to order the samples of different threads.
+         */
+        void record(uint16_t key, uint8_t value, uint64_t time_ns)
+        {
+            auto& slot = slots_[key];
+            const auto count = slot.count.load(std::memory_order_relaxed);
+            const auto values = slot.values.load(std::memory_order_relaxed);
+            const auto min = count == 0 ? value : std::min<uint32_t>(values & 0xff, value);
+            const auto max = count == 0 ? value : std::max<uint32_t>(values >> 8 & 0xff, value);
+            slot.values.store(min | max << 8 | static_cast<uint32_t>(value) << 16, std::memory_order_relaxed);
+            slot.sum.store(slot.sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            slot.time_ns.store(time_ns, std::memory_order_relaxed);
+            slot.count.store(count + 1, std::memory_order_release);
+        }
+
+        /**
+         * Merges the aggregates of this shard into the totals, indexed by the key. The times of the last samples are
+         * kept in a parallel array.
+         */
+        void collect(std::span<KeyStats, key_count> totals, std::span<uint64_t, key_count> last_times) const;
+    };
+
+    TelemetryTable() = default;
+    TelemetryTable(const TelemetryTable&) = delete;
+    TelemetryTable& operator=(const TelemetryTable&) = delete;
+
+    /**
+     * Creates a shard for a thread. The shard lives as long as the table, so the totals keep the samples of the
+     * threads that have exited.
+     */
+    Shard& add_shard();
+
+    /**
+     * Merges the shards of all the threads. The shards are read while being updated, so the values of a key may be a
+     * few samples apart, but every value is consistent on its own.
+     *
+     * @return the aggregates of all the keys that have any samples, in the key order.
+     */
+    [[nodiscard]] std::vector<KeyStats> snapshot() const;
+
+private:
+    // Only taken to add a shard or to walk the list, never by the writers.
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+/**
+ * Writes the aggregates as a single line JSON object: {"telemetry":[{"key":...,"count":...,"sum":...,"min":...,
+ * "max":...,"last":...},...]}.
+ */
+void write_json(std::ostream& stream, std::span<const TelemetryTable::KeyStats> stats);
+
+/**
+ * A batch command handler that records the command 3 samples into its own shard of the table and ignores the other
+ * commands. One aggregator per thread, see PacketParser and CommandHandlerConcept. Not thread safe.
+ */
+class TelemetryAggregator
+{
+    TelemetryTable::Shard& shard_;
+
+public:
+    explicit TelemetryAggregator(TelemetryTable& table) : shard_{table.add_shard()} {}
+
+    // Records a single sample, timestamped now.
+    void handle_command_3(uint16_t data_3_1, uint8_t data_3_2) const
+    {
+        shard_.record(data_3_1, data_3_2, now_ns());
+    }
+
+    // Records the samples of the batch with the same timestamp.
+    void handle_batch(std::span<const Command> batch) const
+    {
+        const auto time_ns = now_ns();
+        for (const auto& command : batch)
+        {
+            if (const auto* sample = std::get_if<Command3>(&command))
+            {
+                shard_.record(sample->data_3_1, sample->data_3_2, time_ns);
+            }
+        }
+    }
+
+    static uint64_t now_ns()
+    {
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+    }
+};
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <boost/asio.hpp>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unordered_map>
+#include <vector>
+
+#include "Metrics.hpp"
+#include "PacketParser.hpp"
+#include "SystemError.hpp"
+#include "TcpServer.hpp"
+
+namespace tcp_server
+{
+    using boost::asio::ip::udp;
+
+    // Receive settings of a UdpServer.
+    struct UdpOptions
+    {
+        // Datagrams received per system call, at most UIO_MAXIOV (the kernel would silently receive fewer).
+        std::size_t batch_size = 64;
+        // Receive buffer size per datagram. The tail of a longer datagram is lost, see UdpSourceStats::truncated.
+        std::size_t datagram_size = 64 * 1024;
+        // Let the kernel coalesce the datagrams of a flow (UDP_GRO), so a buffer may hold several datagrams of the same
+        // size. Fails on kernels without the option.
+        bool gro = false;
+        // Number of sources tracked separately. Datagrams of any further sources are counted together, so spoofed
+        // source addresses can not grow the statistics without bound.
+        std::size_t max_sources = 4096;
+    };
+
+    // Traffic of a single datagram source.
+    struct UdpSourceStats
+    {
+        // The unspecified endpoint (0.0.0.0:0) for the sources beyond UdpOptions::max_sources.
+        udp::endpoint source;
+        uint64_t datagrams = 0;
+        uint64_t bytes = 0;
+        // Valid packets decoded from the datagrams.
+        uint64_t packets = 0;
+        // Headers dropped because of an unknown command id or a broken crc.
+        uint64_t invalid_packets = 0;
+        // Datagrams longer than the receive buffer.
+        uint64_t truncated = 0;
+    };
+
+    /**
+     * Writes the statistics as a single line JSON object with one entry per source.
+     */
+    inline void write_json(std::ostream& stream, std::span<const UdpSourceStats> sources)
+    {
+        stream << "{\"udp_sources\":[";
+        const char* separator = "";
+        for (const auto& source : sources)
+        {
+            stream << separator << "{\"source\":\"" << source.source << "\",\"datagrams\":" << source.datagrams
+                   << ",\"bytes\":" << source.bytes << ",\"packets\":" << source.packets
+                   << ",\"invalid_packets\":" << source.invalid_packets << ",\"truncated\":" << source.truncated
+                   << '}';
+            separator = ",";
+        }
+        stream << "]}\n";
+    }
+
+    /**
+     * Receives packets as UDP datagrams on the specified port (or on automatically assigned if zero) and passes the
+     * decoded commands to a command handler, the same handler types a PacketParser uses.
+     *
+     * A datagram is self-contained: it holds any number of complete packets and a packet never continues in the next
+     * datagram, so there is no per-source parser state. Every datagram is decoded with the stateless
+     * PacketParser::decode_complete, as a parser would decode it followed by the end of the stream.
+     *
+     * The socket is watched by the io_context. Once it is readable, it is drained with recvmmsg, up to batch_size
+     * datagrams per system call, and batch handlers receive the commands of all the datagrams of a call at once.
+     *
+     * Same threading rules as TcpServer. To use more cores, create one server per thread with port sharing enabled, the
+     * kernel keeps the datagrams of a source on the same socket.
+     *
+     * @tparam CommandHandler the handler of the decoded commands, see CommandHandlerConcept.
+     */
+    template <CommandHandlerConcept CommandHandler>
+    class UdpServer
+    {
+        using Parser = PacketParser<CommandHandler>;
+        // Limits the system calls per readiness notification, so a flood does not starve the other event loop users.
+        static constexpr int max_batches_per_wait = 16;
+        static constexpr uint64_t other_sources = std::numeric_limits<uint64_t>::max();
+
+        // Passes a decoded command record to the server.
+        struct Deliver
+        {
+            UdpServer& server;
+
+            template <typename Record>
+            void operator()(const Record& record) const
+            {
+                server.deliver_(record);
+            }
+        };
+
+        udp::socket socket_;
+        CommandHandler& handler_;
+        const UdpOptions options_;
+        // recvmmsg arguments, one entry per datagram of a batch.
+        std::vector<char> buffers_;
+        std::vector<char> controls_;
+        std::vector<sockaddr_in> addresses_;
+        std::vector<iovec> iovecs_;
+        std::vector<mmsghdr> messages_;
+        // Commands decoded from a batch, only used with batch handlers. The records refer to the receive buffers.
+        std::vector<Command> batch_{};
+        metrics::LocalCounters counters_{};
+        // Keyed by the IPv4 address and port of the source.
+        std::unordered_map<uint64_t, UdpSourceStats> sources_{};
+
+        static std::size_t control_size_() { return CMSG_SPACE(sizeof(int)); }
+
+        template <typename Record>
+        void deliver_(const Record& record)
+        {
+            if constexpr (BatchCommandHandler<CommandHandler>)
+            {
+                batch_.push_back(record);
+            }
+            else
+            {
+                record.deliver(handler_);
+            }
+            counters_.add(metrics::command_counter<Protocol::index_of<Record>>());
+        }
+
+        UdpSourceStats& source_(const sockaddr_in& address)
+        {
+            const auto key = static_cast<uint64_t>(address.sin_addr.s_addr) << 16 | address.sin_port;
+            if (const auto it = sources_.find(key); it != sources_.end())
+            {
+                return it->second;
+            }
+            if (sources_.size() >= options_.max_sources)
+            {
+                return sources_[other_sources];
+            }
+            auto& stats = sources_[key];
+            stats.source = udp::endpoint(ip::address_v4(ntohl(address.sin_addr.s_addr)), ntohs(address.sin_port));
+            return stats;
+        }
+
+        // Size of the coalesced datagrams in a buffer received with GRO, 0 if the buffer holds a single datagram.
+        static std::size_t segment_size_(msghdr& message)
+        {
+#ifdef UDP_GRO
+            for (auto* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg))
+            {
+                if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                {
+                    int size = 0;
+                    std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+                    return static_cast<std::size_t>(size);
+                }
+            }
+#endif
+            return 0;
+        }
+
+        // Decodes the datagrams of a buffer and adds them to the statistics of the source.
+        void decode_(std::size_t index)
+        {
+            auto& header = messages_[index].msg_hdr;
+            auto data = std::span<const char>(buffers_.data() + index * options_.datagram_size,
+                                              messages_[index].msg_len);
+            auto& stats = source_(addresses_[index]);
+            const auto segment_size = segment_size_(header);
+            if ((header.msg_flags & MSG_TRUNC) != 0)
+            {
+                stats.truncated++;
+            }
+            stats.bytes += data.size();
+            do
+            {
+                const auto datagram = data.first(segment_size > 0 ? std::min(segment_size, data.size()) : data.size());
+                const auto counts = Parser::decode_complete(datagram, Deliver{*this});
+                stats.datagrams++;
+                stats.packets += counts.packets;
+                stats.invalid_packets += counts.invalid;
+                data = data.subspan(datagram.size());
+            } while (!data.empty());
+        }
+
+        /**
+         * Receives and decodes a batch of datagrams without blocking.
+         *
+         * @return the number of received buffers, 0 if nothing was queued.
+         */
+        std::size_t receive_batch_()
+        {
+            for (std::size_t i = 0; i < messages_.size(); i++)
+            {
+                // The kernel overwrites the lengths and flags.
+                auto& header = messages_[i].msg_hdr;
+                header.msg_namelen = sizeof(sockaddr_in);
+                header.msg_controllen = options_.gro ? control_size_() : 0;
+                header.msg_flags = 0;
+            }
+            const int count = ::recvmmsg(socket_.native_handle(), messages_.data(),
+                                         static_cast<unsigned int>(messages_.size()), MSG_DONTWAIT, nullptr);
+            if (count < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                {
+                    return 0;
+                }
+                sys::throw_errno("recvmmsg");
+            }
+            std::size_t bytes = 0;
+            for (int i = 0; i < count; i++)
+            {
+                bytes += messages_[i].msg_len;
+            }
+            {
+                const metrics::ReadScope read_scope(bytes);
+                for (std::size_t i = 0; i < static_cast<std::size_t>(count); i++)
+                {
+                    decode_(i);
+                }
+                if constexpr (BatchCommandHandler<CommandHandler>)
+                {
+                    if (!batch_.empty())
+                    {
+                        handler_.handle_batch(std::span<const Command>(batch_));
+                        batch_.clear();
+                    }
+                }
+                counters_.flush();
+            }
+            return static_cast<std::size_t>(count);
+        }
+
+        void wait_()
+        {
+            socket_.async_wait(udp::socket::wait_read,
+                               [this](boost::system::error_code ec)
+                               {
+                                   if (!ec)
+                                   {
+                                       do_wait_();
+                                   }
+                               });
+        }
+
+        // The socket is readable - drain it in batches.
+        void do_wait_()
+        {
+            for (int i = 0; i < max_batches_per_wait; i++)
+            {
+                if (receive_batch_() < messages_.size())
+                {
+                    break; // most likely nothing else is queued - do not waste a syscall
+                }
+            }
+            wait_();
+        }
+
+    public:
+        /**
+         * @param io_context Boost::asio context
+         * @param handler the handler of the decoded commands. Must outlive the server.
+         * @param port UDP port to listen on (0 for automatic selection)
+         * @param share_port allow other servers to listen on the same port (SO_REUSEPORT). All of them must enable it.
+         * @param options receive settings
+         */
+        UdpServer(boost::asio::io_context& io_context, CommandHandler& handler, ip::port_type port,
+                  bool share_port = false, UdpOptions options = {}) :
+            socket_{io_context}, handler_{handler}, options_{options}
+        {
+            if (options_.batch_size == 0 || options_.batch_size > UIO_MAXIOV || options_.datagram_size == 0 ||
+                options_.max_sources == 0)
+            {
+                throw std::invalid_argument("Invalid UDP receive options");
+            }
+            const auto endpoint = udp::endpoint{udp::v4(), port};
+            socket_.open(endpoint.protocol());
+            if (share_port)
+            {
+#ifdef SO_REUSEPORT
+                socket_.set_option(reuse_port(true));
+#else
+                throw std::runtime_error("Port sharing is not supported on this platform");
+#endif
+            }
+            if (options_.gro)
+            {
+#ifdef UDP_GRO
+                const int enable = 1;
+                if (::setsockopt(socket_.native_handle(), SOL_UDP, UDP_GRO, &enable, sizeof(enable)) != 0)
+                {
+                    sys::throw_errno("UDP_GRO");
+                }
+#else
+                throw std::runtime_error("UDP GRO is not supported on this platform");
+#endif
+            }
+            socket_.bind(endpoint);
+            socket_.non_blocking(true);
+
+            buffers_.resize(options_.batch_size * options_.datagram_size);
+            controls_.resize(options_.gro ? options_.batch_size * control_size_() : 0);
+            addresses_.resize(options_.batch_size);
+            iovecs_.resize(options_.batch_size);
+            messages_.resize(options_.batch_size);
+            for (std::size_t i = 0; i < options_.batch_size; i++)
+            {
+                iovecs_[i] = {buffers_.data() + i * options_.datagram_size, options_.datagram_size};
+                auto& header = messages_[i].msg_hdr;
+                header.msg_name = &addresses_[i];
+                header.msg_iov = &iovecs_[i];
+                header.msg_iovlen = 1;
+                header.msg_control = options_.gro ? controls_.data() + i * control_size_() : nullptr;
+            }
+            wait_(); // start receiving immediately after construction
+        }
+
+        UdpServer(const UdpServer&) = delete;
+        UdpServer& operator=(const UdpServer&) = delete;
+
+        /**
+         * A method of gracefully stopping the server.
+         */
+        void stop() { socket_.close(); }
+
+        /**
+         * @return UDP port number used by the server.
+         */
+        [[nodiscard]] ip::port_type port() const { return socket_.local_endpoint().port(); }
+
+        /**
+         * @return the statistics of all the sources seen so far, in no particular order.
+         */
+        [[nodiscard]] std::vector<UdpSourceStats> sources() const
+        {
+            std::vector<UdpSourceStats> result;
+            result.reserve(sources_.size());
+            for (const auto& [key, stats] : sources_)
+            {
+                result.push_back(stats);
+            }
+            return result;
+        }
+    };
+} // namespace tcp_server
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cerrno>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SystemError.hpp"
+#include "TcpServer.hpp"
+
+namespace tcp_server
+{
+    using boost::asio::local::stream_protocol;
+
+    /**
+     * Opens the acceptor and starts listening on the socket file. A socket file left behind by a previous run is
+     * replaced, any other file at the path is not.
+     */
+    inline void listen(stream_protocol::acceptor& acceptor, const std::string& path)
+    {
+        struct stat status{};
+        if (::stat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+        {
+            ::unlink(path.c_str());
+        }
+        const auto endpoint = stream_protocol::endpoint{path};
+        acceptor.open(endpoint.protocol());
+        acceptor.bind(endpoint);
+        acceptor.listen();
+    }
+
+    /**
+     * Makes the acceptor accept the connections of another acceptor's listening socket, e.g. in another event loop
+     * thread. Unix sockets can not share a path the way SO_REUSEPORT shares a port, so all the acceptors wait on the
+     * same socket and every connection is taken by one of them.
+     */
+    inline void share(stream_protocol::acceptor& acceptor, stream_protocol::acceptor& listening)
+    {
+        const int fd = ::dup(listening.native_handle());
+        if (fd < 0)
+        {
+            sys::throw_errno("dup");
+        }
+        acceptor.assign(stream_protocol{}, fd);
+    }
+
+    /**
+     * Unix domain socket server for producers on the same host: connections skip the TCP/IP stack altogether. Sessions
+     * and buffer handlers are the same as TcpServer's, see StreamServer.
+     *
+     * The server that creates the socket file removes it on destruction.
+     */
+    template <BufferHandlerFactory Factory>
+    class UnixServer : public StreamServer<stream_protocol, Factory>
+    {
+        // Empty if the socket file belongs to another server.
+        std::string owned_path_;
+
+        static stream_protocol::acceptor make_acceptor_(boost::asio::io_context& io_context, const std::string& path)
+        {
+            auto acceptor = stream_protocol::acceptor{io_context};
+            listen(acceptor, path);
+            return acceptor;
+        }
+
+        static stream_protocol::acceptor make_acceptor_(boost::asio::io_context& io_context, UnixServer& other)
+        {
+            auto acceptor = stream_protocol::acceptor{io_context};
+            share(acceptor, other.acceptor());
+            return acceptor;
+        }
+
+    public:
+        /**
+         * @param io_context Boost::asio context
+         * @param handlerFactory The factory object responsible for creating unique pointers to BufferHandlers used by
+         * client connections.
+         * @param path the socket file to listen on.
+         * @param receive_options receive buffer settings
+         */
+        UnixServer(boost::asio::io_context& io_context, Factory& handlerFactory, const std::string& path,
+                   ReceiveOptions receive_options = {}) :
+            StreamServer<stream_protocol, Factory>{make_acceptor_(io_context, path), handlerFactory, receive_options},
+            owned_path_{path}
+        {
+        }
+
+        /**
+         * Accepts the connections of another server's socket (see share). The other server must be running, i.e. not
+         * stopped, during the construction.
+         */
+        UnixServer(boost::asio::io_context& io_context, Factory& handlerFactory, UnixServer& listening,
+                   ReceiveOptions receive_options = {}) :
+            StreamServer<stream_protocol, Factory>{make_acceptor_(io_context, listening), handlerFactory,
+                                                   receive_options}
+        {
+        }
+
+        UnixServer(const UnixServer&) = delete;
+        UnixServer& operator=(const UnixServer&) = delete;
+
+        ~UnixServer()
+        {
+            if (!owned_path_.empty())
+            {
+                ::unlink(owned_path_.c_str());
+            }
+        }
+
+        /**
+         * @return the socket file path.
+         */
+        [[nodiscard]] std::string path() const { return this->acceptor().local_endpoint().path(); }
+    };
+} // namespace tcp_server
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "IoUring.hpp"
+#include "Metrics.hpp"
+#include "SystemError.hpp"
+#include "TcpServer.hpp"
+
+namespace tcp_server
+{
+    // io_uring settings of a UringTcpServer.
+    struct UringOptions
+    {
+        // Submission queue size. Requests beyond it are passed to the kernel in several calls.
+        unsigned queue_depth = 256;
+        // Number of receive buffers shared by all the connections of a server. A power of two up to 32768.
+        unsigned buffer_count = 1024;
+        // Size of a single receive buffer, up to 4 GiB - 1.
+        std::size_t buffer_size = 16 * 1024;
+        // Options of the listening socket, inherited by the connections. Receive timestamps are not supported.
+        SocketOptions socket{};
+    };
+
+    /**
+     * A TcpServer alternative that receives the data through io_uring instead of one asio read per chunk.
+     *
+     * Connections are accepted by asio as usual. Every connection then has a single multishot receive request, armed
+     * once, that keeps delivering the data into buffers picked by the kernel from a provided buffer ring shared by
+     * all the connections of the server. The ring signals an eventfd watched by the io_context, so the server works
+     * alongside timers and other asio users of the same event loop, and a single wakeup processes the data of many
+     * connections without any further system calls.
+     *
+     * Same threading rules and buffer handler requirements as TcpServer. Requires Linux 6.0 or newer, check
+     * IoUring::multishot_recv_supported() before creating the server and use TcpServer otherwise.
+     */
+    template <BufferHandlerFactory Factory>
+    class UringTcpServer
+    {
+        using BufferHandlerPtr = decltype(std::declval<Factory&>()());
+        static constexpr uint16_t buffer_group = 0;
+
+        // Connections are identified by their slot index in the request user data.
+        struct Connection
+        {
+            int fd = -1;
+            BufferHandlerPtr handler{};
+        };
+
+        tcp::acceptor acceptor_;
+        Factory& factory_;
+        ProvidedBuffers buffers_; // must outlive the ring
+        IoUring ring_;
+        boost::asio::posix::stream_descriptor completion_event_;
+        std::vector<Connection> connections_;
+        std::vector<std::size_t> free_slots_;
+        // Connections whose receive request was refused by a full submission queue, armed again after the next
+        // completions are processed.
+        std::vector<std::size_t> unarmed_;
+        std::size_t connection_count_ = 0;
+        bool stopping_ = false;
+        const bool quick_ack_;
+
+    public:
+        /**
+         * @param io_context Boost::asio context
+         * @param handlerFactory The factory object responsible for creating unique pointers to BufferHandlers used by
+         * client connections.
+         * @param port TCP port to listen on (0 for automatic selection)
+         * @param share_port allow other servers to listen on the same port (SO_REUSEPORT). All of them must enable it.
+         * @param options io_uring settings
+         */
+        UringTcpServer(boost::asio::io_context& io_context, Factory& handlerFactory, ip::port_type port,
+                       bool share_port = false, UringOptions options = {}) :
+            acceptor_{io_context}, factory_{handlerFactory}, buffers_{options.buffer_count, options.buffer_size},
+            ring_{options.queue_depth, options.buffer_count * 2}, completion_event_{io_context},
+            quick_ack_{options.socket.quick_ack}
+        {
+            if (options.socket.receive_timestamps)
+            {
+                throw std::invalid_argument("The io_uring server does not support receive timestamps");
+            }
+            ring_.register_buffer_ring(buffers_.ring(), buffers_.count(), buffer_group);
+            const int event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (event_fd < 0)
+            {
+                sys::throw_errno("eventfd");
+            }
+            completion_event_.assign(event_fd);
+            ring_.register_eventfd(event_fd);
+            listen(acceptor_, port, share_port, options.socket);
+            do_accept();
+            wait_completions();
+        }
+
+        UringTcpServer(const UringTcpServer&) = delete;
+        UringTcpServer& operator=(const UringTcpServer&) = delete;
+
+        // The pending receive requests are cancelled when the ring is closed.
+        ~UringTcpServer()
+        {
+            for (const auto& connection : connections_)
+            {
+                if (connection.fd >= 0)
+                {
+                    ::close(connection.fd);
+                }
+            }
+        }
+
+        /**
+         * A method of gracefully stopping the server. Active connections are served until they are closed by the
+         * clients, then the server leaves the io_context.
+         */
+        void stop()
+        {
+            acceptor_.close();
+            stopping_ = true;
+            if (connection_count_ == 0)
+            {
+                completion_event_.cancel();
+            }
+        }
+
+        /**
+         * @return TCP port number used by the server.
+         */
+        [[nodiscard]] ip::port_type port() const { return acceptor_.local_endpoint().port(); }
+
+    private:
+        void do_accept()
+        {
+            acceptor_.async_accept(
+                [this](boost::system::error_code ec, tcp::socket socket)
+                {
+                    if (acceptor_.is_open()) // do not try to wait further if the acceptor was stopped (it will hang)
+                    {
+                        if (!ec)
+                        {
+                            // From now on the socket is served by the ring only.
+                            add_connection(socket.release());
+                            ring_.submit();
+                        }
+                        do_accept();
+                    }
+                });
+        }
+
+        void add_connection(int fd)
+        {
+            std::size_t slot = connections_.size();
+            if (free_slots_.empty())
+            {
+                connections_.emplace_back();
+            }
+            else
+            {
+                slot = free_slots_.back();
+                free_slots_.pop_back();
+            }
+            connections_[slot] = Connection{fd, factory_()};
+            connection_count_++;
+            metrics::add(metrics::Counter::connections_opened);
+            receive(slot);
+        }
+
+        void close_connection(std::size_t slot)
+        {
+            ::close(connections_[slot].fd);
+            connections_[slot] = Connection{};
+            free_slots_.push_back(slot);
+            connection_count_--;
+            metrics::add(metrics::Counter::connections_closed);
+        }
+
+        // Re-arm the quick acknowledgements after a read, the kernel turns them off on its own (see quick_ack).
+        void acknowledge([[maybe_unused]] int fd) const
+        {
+#ifdef TCP_QUICKACK
+            if (quick_ack_)
+            {
+                const int enable = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &enable, sizeof(enable));
+            }
+#endif
+        }
+
+        // Arms the multishot receive request of a connection.
+        void receive(std::size_t slot)
+        {
+            auto* sqe = ring_.get_sqe();
+            if (sqe == nullptr)
+            {
+                unarmed_.push_back(slot);
+                return;
+            }
+            IoUring::prepare_multishot_recv(sqe, connections_[slot].fd, buffer_group, slot);
+        }
+
+        // Wait until the kernel posts completions.
+        void wait_completions()
+        {
+            completion_event_.async_wait(
+                boost::asio::posix::stream_descriptor::wait_read,
+                [this](const boost::system::error_code& ec)
+                {
+                    if (ec)
+                    {
+                        return; // cancelled by stop or destroyed with the io_context
+                    }
+                    // Reset the counter before processing, so no completion is missed.
+                    uint64_t counter = 0;
+                    [[maybe_unused]] const auto result =
+                        ::read(completion_event_.native_handle(), &counter, sizeof(counter));
+                    process_completions();
+                    if (!stopping_ || connection_count_ > 0)
+                    {
+                        wait_completions();
+                    }
+                });
+        }
+
+        void process_completions()
+        {
+            while (ring_.process_completions([this](const io_uring_cqe& cqe) { handle_completion(cqe); }) > 0)
+            {
+                // Return the processed buffers to the kernel before re-arming the requests that ran out of them.
+                buffers_.publish();
+                ring_.submit();
+            }
+            if (!unarmed_.empty())
+            {
+                for (const auto slot : std::exchange(unarmed_, {}))
+                {
+                    receive(slot);
+                }
+                ring_.submit();
+                if (!unarmed_.empty())
+                {
+                    // Still refused: wake the event loop up again instead of waiting for completions that may never
+                    // come.
+                    const uint64_t one = 1;
+                    [[maybe_unused]] const auto result = ::write(completion_event_.native_handle(), &one, sizeof(one));
+                }
+            }
+        }
+
+        void handle_completion(const io_uring_cqe& cqe)
+        {
+            const auto slot = static_cast<std::size_t>(cqe.user_data);
+            if (cqe.res > 0)
+            {
+                const auto id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                {
+                    const metrics::ReadScope read_scope(static_cast<std::size_t>(cqe.res));
+                    (*connections_[slot].handler)(buffers_.get(id, static_cast<std::size_t>(cqe.res)));
+                }
+                buffers_.recycle(id);
+                acknowledge(connections_[slot].fd);
+                if ((cqe.flags & IORING_CQE_F_MORE) == 0)
+                {
+                    receive(slot); // the kernel may end a multishot request at any time
+                }
+            }
+            else if (cqe.res == -ENOBUFS)
+            {
+                receive(slot); // all the buffers were in use, some are returned by now
+            }
+            else
+            {
+                close_connection(slot); // end of stream or an error
+            }
+        }
+    };
+} // namespace tcp_server
@@ -0,0 +1,150 @@
+#include "../include/BinaryCommandReader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "../include/BinaryFormat.hpp"
+
+#ifdef SERVER_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace
+{
+    [[noreturn]] void corrupt(const std::string& what) { throw std::runtime_error("Corrupt binary block: " + what); }
+
+    // Reads the columns of a block payload in order, checking the bounds.
+    class Columns
+    {
+        std::span<const char> data_;
+
+    public:
+        explicit Columns(std::span<const char> data) : data_{data} {}
+
+        std::span<const char> take(std::size_t size)
+        {
+            if (data_.size() < size)
+            {
+                corrupt("the columns do not fit into the block");
+            }
+            const auto result = data_.first(size);
+            data_ = data_.subspan(size);
+            return result;
+        }
+
+        [[nodiscard]] bool empty() const { return data_.empty(); }
+    };
+} // namespace
+
+BinaryCommandReader::BinaryCommandReader(std::istream& stream) : stream_{stream} {}
+
+std::span<const Command> BinaryCommandReader::next()
+{
+    commands_.clear();
+    while (commands_.empty())
+    {
+        char header[binary_format::header_size];
+        stream_.read(header, binary_format::header_size);
+        if (stream_.gcount() == 0)
+        {
+            return {};
+        }
+        if (static_cast<std::size_t>(stream_.gcount()) < binary_format::header_size ||
+            !std::equal(binary_format::magic.begin(), binary_format::magic.end(), header))
+        {
+            corrupt("invalid header");
+        }
+        const auto flags = static_cast<uint8_t>(header[4]);
+        const auto stored_size = protocol::U32Le::decode(header + 8);
+        [[maybe_unused]] const auto raw_size = protocol::U32Le::decode(header + 12);
+        // Compressed payloads are only stored if they are smaller, so neither size may exceed a block.
+        if (stored_size > binary_format::max_block_size - binary_format::header_size ||
+            raw_size > binary_format::max_block_size - binary_format::header_size)
+        {
+            corrupt("block too large");
+        }
+        stored_.resize(stored_size);
+        stream_.read(stored_.data(), stored_size);
+        if (static_cast<std::size_t>(stream_.gcount()) < stored_size)
+        {
+            corrupt("the stream ends inside the block");
+        }
+
+        if ((flags & binary_format::compressed) == 0)
+        {
+            payload_.swap(stored_);
+        }
+        else
+        {
+#ifdef SERVER_WITH_ZLIB
+            payload_.resize(raw_size);
+            auto size = static_cast<uLongf>(raw_size);
+            if (uncompress(reinterpret_cast<Bytef*>(payload_.data()), &size,
+                           reinterpret_cast<const Bytef*>(stored_.data()), stored_size) != Z_OK ||
+                size != raw_size)
+            {
+                corrupt("decompression failed");
+            }
+#else
+            throw std::runtime_error("Compressed binary blocks require zlib support");
+#endif
+        }
+
+        auto columns = Columns(payload_);
+        const auto count = protocol::U32Le::decode(columns.take(4).data());
+        const auto kinds = columns.take(count);
+        std::array<std::size_t, Protocol::size> counts{};
+        for (const auto kind : kinds)
+        {
+            if (static_cast<uint8_t>(kind) >= Protocol::size)
+            {
+                corrupt("unknown command kind");
+            }
+            counts[static_cast<uint8_t>(kind)]++;
+        }
+        const auto cmd_1_lengths = columns.take(counts[Protocol::index_of<Command1>]);
+        const auto cmd_1_data_size = std::accumulate(cmd_1_lengths.begin(), cmd_1_lengths.end(), std::size_t{0},
+                                                     [](std::size_t sum, char length)
+                                                     { return sum + static_cast<uint8_t>(length); });
+        const auto cmd_1_data = columns.take(cmd_1_data_size);
+        const auto cmd_2_data = columns.take(counts[Protocol::index_of<Command2>]);
+        const auto cmd_3_data_1 = columns.take(2 * counts[Protocol::index_of<Command3>]);
+        const auto cmd_3_data_2 = columns.take(counts[Protocol::index_of<Command3>]);
+        if (!columns.empty())
+        {
+            corrupt("unexpected data after the columns");
+        }
+
+        // Every column is read in order, so a cursor per column restores the commands.
+        std::array<std::size_t, Protocol::size> positions{};
+        std::size_t cmd_1_offset = 0;
+        commands_.reserve(count);
+        for (const auto kind : kinds)
+        {
+            auto& position = positions[static_cast<uint8_t>(kind)];
+            switch (static_cast<uint8_t>(kind))
+            {
+            case Protocol::index_of<Command1>:
+            {
+                const auto length = static_cast<uint8_t>(cmd_1_lengths[position]);
+                commands_.emplace_back(Command1{std::string_view(cmd_1_data.data() + cmd_1_offset, length)});
+                cmd_1_offset += length;
+                break;
+            }
+            case Protocol::index_of<Command2>:
+                commands_.emplace_back(Command2{static_cast<uint8_t>(cmd_2_data[position])});
+                break;
+            default:
+                commands_.emplace_back(Command3{protocol::U16Le::decode(cmd_3_data_1.data() + 2 * position),
+                                                static_cast<uint8_t>(cmd_3_data_2[position])});
+            }
+            position++;
+        }
+    }
+    return commands_;
+}
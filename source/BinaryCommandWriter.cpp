@@ -0,0 +1,159 @@
+#include "../include/BinaryCommandWriter.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <variant>
+
+#include "../include/Protocol.hpp"
+
+#ifdef SERVER_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace
+{
+    template <typename T>
+    void append_column(std::vector<char>& buffer, const std::vector<T>& column)
+    {
+        for (const auto value : column)
+        {
+            protocol::append_le(buffer, value);
+        }
+    }
+
+    void store_le(char* destination, uint32_t value)
+    {
+        for (std::size_t i = 0; i < sizeof(value); i++)
+        {
+            destination[i] = static_cast<char>(value >> 8 * i);
+        }
+    }
+
+    // Kinds of the commands, positions of their records in the Protocol table.
+    constexpr auto kind_1 = static_cast<uint8_t>(Protocol::index_of<Command1>);
+    constexpr auto kind_2 = static_cast<uint8_t>(Protocol::index_of<Command2>);
+    constexpr auto kind_3 = static_cast<uint8_t>(Protocol::index_of<Command3>);
+    static_assert(Protocol::size == 3, "Add the columns of the new command to the binary format");
+
+    // Encoded sizes of the commands without the command 1 data.
+    constexpr std::size_t cmd_1_size = 1 + 1;
+    constexpr std::size_t cmd_2_size = 1 + 1;
+    constexpr std::size_t cmd_3_size = 1 + 2 + 1;
+    constexpr std::size_t count_size = 4;
+} // namespace
+
+BinaryCommandWriter::BinaryCommandWriter(std::ostream& stream, Options options) :
+    stream_{stream}, options_{options}, size_{count_size}
+{
+    // The largest command 1 must fit into a block.
+    if (options_.block_size < 1024 || options_.block_size > binary_format::max_block_size)
+    {
+        throw std::invalid_argument("Binary output blocks must be at least 1024 bytes and at most 64 MiB");
+    }
+    if (options_.compress && !binary_format::compression_supported)
+    {
+        throw std::invalid_argument("Binary output compression requires zlib");
+    }
+    block_.reserve(options_.block_size);
+}
+
+BinaryCommandWriter::~BinaryCommandWriter() { write_block_(); }
+
+void BinaryCommandWriter::reserve_(std::size_t command_size)
+{
+    if (binary_format::header_size + size_ + command_size > options_.block_size)
+    {
+        write_block_();
+    }
+    size_ += command_size;
+}
+
+void BinaryCommandWriter::handle_command_1(std::string_view data_1)
+{
+    reserve_(cmd_1_size + data_1.size());
+    kinds_.push_back(kind_1);
+    cmd_1_lengths_.push_back(static_cast<uint8_t>(data_1.size()));
+    cmd_1_data_.insert(cmd_1_data_.end(), data_1.begin(), data_1.end());
+}
+
+void BinaryCommandWriter::handle_command_2(uint8_t data_2)
+{
+    reserve_(cmd_2_size);
+    kinds_.push_back(kind_2);
+    cmd_2_data_.push_back(data_2);
+}
+
+void BinaryCommandWriter::handle_command_3(uint16_t data_3_1, uint8_t data_3_2)
+{
+    reserve_(cmd_3_size);
+    kinds_.push_back(kind_3);
+    cmd_3_data_1_.push_back(data_3_1);
+    cmd_3_data_2_.push_back(data_3_2);
+}
+
+void BinaryCommandWriter::handle_batch(std::span<const Command> batch)
+{
+    for (const auto& command : batch)
+    {
+        std::visit([this](const auto& record) { record.deliver(*this); }, command);
+    }
+}
+
+void BinaryCommandWriter::write_block_()
+{
+    if (kinds_.empty())
+    {
+        return;
+    }
+    block_.assign(binary_format::header_size, 0);
+    protocol::append_le(block_, static_cast<uint32_t>(kinds_.size()));
+    append_column(block_, kinds_);
+    append_column(block_, cmd_1_lengths_);
+    block_.insert(block_.end(), cmd_1_data_.begin(), cmd_1_data_.end());
+    append_column(block_, cmd_2_data_);
+    append_column(block_, cmd_3_data_1_);
+    append_column(block_, cmd_3_data_2_);
+
+    const auto raw_size = static_cast<uint32_t>(block_.size() - binary_format::header_size);
+    uint8_t flags = 0;
+#ifdef SERVER_WITH_ZLIB
+    if (options_.compress)
+    {
+        // The fastest level: the point is to cut the output volume without becoming the bottleneck.
+        auto compressed_size = compressBound(raw_size);
+        compressed_.resize(binary_format::header_size + compressed_size);
+        const auto* source = reinterpret_cast<const Bytef*>(block_.data() + binary_format::header_size);
+        auto* destination = reinterpret_cast<Bytef*>(compressed_.data() + binary_format::header_size);
+        if (compress2(destination, &compressed_size, source, raw_size, Z_BEST_SPEED) == Z_OK &&
+            compressed_size < raw_size)
+        {
+            compressed_.resize(binary_format::header_size + compressed_size);
+            block_.swap(compressed_);
+            flags |= binary_format::compressed;
+        }
+    }
+#endif
+    std::copy(binary_format::magic.begin(), binary_format::magic.end(), block_.begin());
+    block_[4] = static_cast<char>(flags);
+    store_le(block_.data() + 8, static_cast<uint32_t>(block_.size() - binary_format::header_size));
+    store_le(block_.data() + 12, raw_size);
+
+    // A block is written between two flushes, so stream buffers that hand the data over on flush pass it as a whole.
+    stream_.flush();
+    stream_.write(block_.data(), static_cast<std::streamsize>(block_.size()));
+    stream_.flush();
+
+    kinds_.clear();
+    cmd_1_lengths_.clear();
+    cmd_1_data_.clear();
+    cmd_2_data_.clear();
+    cmd_3_data_1_.clear();
+    cmd_3_data_2_.clear();
+    size_ = count_size;
+}
+
+void BinaryCommandWriter::flush()
+{
+    write_block_();
+    stream_.flush();
+}
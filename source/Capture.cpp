@@ -0,0 +1,134 @@
+#include "../include/Capture.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "../include/Protocol.hpp"
+#include "../include/SystemError.hpp"
+
+namespace
+{
+    // Writes all the data, retrying partial and interrupted writes.
+    void write_all(int fd, std::span<const char> data)
+    {
+        while (!data.empty())
+        {
+            const auto written = ::write(fd, data.data(), data.size());
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                sys::throw_errno("capture write");
+            }
+            data = data.subspan(static_cast<std::size_t>(written));
+        }
+    }
+} // namespace
+
+CaptureFile::CaptureFile(const std::string& path)
+{
+    // Session ids start over in every run, so the records of an earlier run can not be kept: a replay would mix their
+    // sessions up with the new ones.
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+        sys::throw_errno("capture open");
+    }
+    try
+    {
+        append(capture::magic);
+    }
+    catch (...)
+    {
+        ::close(fd_);
+        throw;
+    }
+}
+
+CaptureFile::~CaptureFile() { ::close(fd_); }
+
+void CaptureFile::append(std::span<const char> records)
+{
+    const std::lock_guard lock(mutex_);
+    write_all(fd_, records);
+}
+
+CaptureWriter::CaptureWriter(CaptureFile& file, std::size_t buffer_size) : file_{file}, buffer_size_{buffer_size}
+{
+    buffer_.reserve(buffer_size);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    try
+    {
+        flush();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to write the capture: " << e.what() << '\n';
+    }
+}
+
+void CaptureWriter::record(uint32_t session, std::span<const char> data)
+{
+    const auto time = std::chrono::steady_clock::now().time_since_epoch();
+    protocol::append_le(buffer_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count()));
+    protocol::append_le(buffer_, session);
+    protocol::append_le(buffer_, static_cast<uint32_t>(data.size()));
+    buffer_.insert(buffer_.end(), data.begin(), data.end());
+    if (buffer_.size() >= buffer_size_)
+    {
+        flush();
+    }
+}
+
+void CaptureWriter::flush()
+{
+    if (!buffer_.empty())
+    {
+        // The buffer is emptied even if the write fails, so a broken file does not grow the memory without bound.
+        const auto records = std::move(buffer_);
+        buffer_.clear();
+        buffer_.reserve(buffer_size_);
+        file_.append(records);
+    }
+}
+
+CaptureReader::CaptureReader(const std::string& path) : file_{path}
+{
+    const auto data = file_.data();
+    if (data.size() < capture::magic.size() || !std::equal(capture::magic.begin(), capture::magic.end(), data.data()))
+    {
+        throw std::runtime_error("Not a capture file: " + path);
+    }
+}
+
+std::optional<capture::Record> CaptureReader::next()
+{
+    const auto data = file_.data();
+    if (data.size() - position_ < capture::record_header_size)
+    {
+        return std::nullopt;
+    }
+    const char* header = data.data() + position_;
+    const auto length = protocol::U32Le::decode(header + 12);
+    if (data.size() - position_ - capture::record_header_size < length)
+    {
+        return std::nullopt;
+    }
+    const auto record = capture::Record{
+        .time_ns = protocol::Integer<uint64_t, std::endian::little>::decode(header),
+        .session = protocol::U32Le::decode(header + 8),
+        .data = {header + capture::record_header_size, length},
+    };
+    position_ += capture::record_header_size + length;
+    return record;
+}
@@ -1,20 +1,69 @@
 #include "../include/CommandPrinter.hpp"
 
 #include <format>
+#include <iterator>
+#include <variant>
+
+namespace
+{
+    using Output = std::ostreambuf_iterator<char>;
+
+    Output print_command_1(Output out, std::string_view data_1, InternTable* intern_table)
+    {
+        if (intern_table == nullptr)
+        {
+            return std::format_to(out, "{:#06x} {}\n", 1, data_1);
+        }
+        const auto entry = intern_table->intern(data_1);
+        if (entry.added)
+        {
+            return std::format_to(out, "{:#06x} #{} {}\n", 1, entry.id, data_1);
+        }
+        return std::format_to(out, "{:#06x} #{}\n", 1, entry.id);
+    }
+
+    Output print_command_2(Output out, uint8_t data_2) { return std::format_to(out, "{:#06x} {:#x}\n", 2, data_2); }
+
+    Output print_command_3(Output out, uint16_t data_3_1, uint8_t data_3_2)
+    {
+        return std::format_to(out, "{:#06x} {:#x} {:#x}\n", 3, data_3_1, data_3_2);
+    }
+} // namespace
 
 CommandPrinter::CommandPrinter(std::ostream& stream) : stream_{stream} {}
 
-void CommandPrinter::handle_command_1(const std::string &data_1) const
+void CommandPrinter::handle_command_1(std::string_view data_1) const
 {
-    stream_ << std::format("{:#06x} {}\n", 1, data_1);
+    print_command_1(Output(stream_), data_1, intern_table_);
 }
 
 void CommandPrinter::handle_command_2(uint8_t data_2) const
 {
-    stream_ << std::format("{:#06x} {:#x}\n", 2, data_2);
+    print_command_2(Output(stream_), data_2);
 }
 
 void CommandPrinter::handle_command_3(uint16_t data_3_1, uint8_t data_3_2) const
 {
-    stream_ << std::format("{:#06x} {:#x} {:#x}\n", 3, data_3_1, data_3_2);
+    print_command_3(Output(stream_), data_3_1, data_3_2);
+}
+
+void CommandPrinter::handle_batch(std::span<const Command> batch) const
+{
+    // A single pass over the stream buffer for the whole batch.
+    auto out = Output(stream_);
+    for (const auto& command : batch)
+    {
+        if (const auto* cmd_1 = std::get_if<Command1>(&command))
+        {
+            out = print_command_1(out, cmd_1->data_1, intern_table_);
+        }
+        else if (const auto* cmd_2 = std::get_if<Command2>(&command))
+        {
+            out = print_command_2(out, cmd_2->data_2);
+        }
+        else if (const auto* cmd_3 = std::get_if<Command3>(&command))
+        {
+            out = print_command_3(out, cmd_3->data_3_1, cmd_3->data_3_2);
+        }
+    }
 }
@@ -0,0 +1,224 @@
+#include "../include/Crc16Arc.hpp"
+
+#include <array>
+#include <cstddef>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CRC16_ARC_CLMUL 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Reflected CRC-16/ARC polynomial.
+    constexpr uint16_t reflected_poly = 0xa001;
+
+    // Slicing-by-8 lookup tables. tables[0] is the classic byte-at-a-time table, tables[k] advances a byte that is
+    // followed by k more bytes.
+    constexpr auto make_tables()
+    {
+        std::array<std::array<uint16_t, 256>, 8> tables{};
+        for (unsigned int byte = 0; byte < 256; byte++)
+        {
+            uint16_t crc = byte;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = crc & 1 ? (crc >> 1) ^ reflected_poly : crc >> 1;
+            }
+            tables[0][byte] = crc;
+        }
+        for (unsigned int k = 1; k < tables.size(); k++)
+        {
+            for (unsigned int byte = 0; byte < 256; byte++)
+            {
+                const uint16_t prev = tables[k - 1][byte];
+                tables[k][byte] = (prev >> 8) ^ tables[0][prev & 0xff];
+            }
+        }
+        return tables;
+    }
+
+    constexpr auto tables = make_tables();
+
+    uint16_t update_bytewise(uint16_t crc, const unsigned char* data, std::size_t length)
+    {
+        for (std::size_t i = 0; i < length; i++)
+        {
+            crc = (crc >> 8) ^ tables[0][(crc ^ data[i]) & 0xff];
+        }
+        return crc;
+    }
+
+#ifdef CRC16_ARC_CLMUL
+    // The folding algorithm below is the one from Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+    // Instruction" paper for 32-bit reflected CRCs. A 16-bit CRC with polynomial P(x) equals the 32-bit CRC with
+    // polynomial P(x)*x^16, and for the reflected variant the register values are identical, so the same code works
+    // with constants computed for P(x)*x^16.
+    constexpr uint64_t folding_poly = 0x1'8005'0000; // (x^16 + x^15 + x^2 + 1) * x^16
+
+    constexpr uint32_t reflect32(uint32_t value)
+    {
+        uint32_t result = 0;
+        for (int bit = 0; bit < 32; bit++)
+        {
+            result = (result << 1) | ((value >> bit) & 1);
+        }
+        return result;
+    }
+
+    // x^exponent mod P(x)
+    constexpr uint32_t x_pow_mod(unsigned int exponent)
+    {
+        uint64_t remainder = 1;
+        for (unsigned int i = 0; i < exponent; i++)
+        {
+            remainder <<= 1;
+            if (remainder & (uint64_t{1} << 32))
+            {
+                remainder ^= folding_poly;
+            }
+        }
+        return static_cast<uint32_t>(remainder);
+    }
+
+    // Folding constant for the reflected domain: (x^exponent mod P(x))' << 1
+    constexpr uint64_t fold_constant(unsigned int exponent) { return uint64_t{reflect32(x_pow_mod(exponent))} << 1; }
+
+    // Barrett reduction constant: (x^64 div P(x))', 33 bits.
+    constexpr uint64_t barrett_constant()
+    {
+        uint64_t dividend_high = uint64_t{1} << 32; // bits 32..64 of the running dividend, starting with x^64
+        uint64_t quotient = 0;
+        for (int bit = 32; bit >= 0; bit--)
+        {
+            if (dividend_high & (uint64_t{1} << 32))
+            {
+                quotient |= uint64_t{1} << bit;
+                dividend_high ^= folding_poly;
+            }
+            dividend_high <<= 1;
+        }
+        uint64_t reflected = 0;
+        for (int bit = 0; bit < 33; bit++)
+        {
+            reflected = (reflected << 1) | ((quotient >> bit) & 1);
+        }
+        return reflected;
+    }
+
+    constexpr uint64_t reflected_folding_poly = (uint64_t{reflect32(static_cast<uint32_t>(folding_poly))} << 1) | 1;
+
+    alignas(16) constexpr uint64_t k1k2[] = {fold_constant(4 * 128 + 32), fold_constant(4 * 128 - 32)};
+    alignas(16) constexpr uint64_t k3k4[] = {fold_constant(128 + 32), fold_constant(128 - 32)};
+    alignas(16) constexpr uint64_t k5k0[] = {fold_constant(64), 0};
+    alignas(16) constexpr uint64_t poly_mu[] = {reflected_folding_poly, barrett_constant()};
+
+    __m128i load(const unsigned char* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+
+    // Multiplies both halves of the accumulator by the folding constants and adds the next block.
+    __attribute__((target("pclmul"))) __m128i fold(__m128i acc, __m128i next, __m128i k)
+    {
+        const __m128i low = _mm_clmulepi64_si128(acc, k, 0x00);
+        const __m128i high = _mm_clmulepi64_si128(acc, k, 0x11);
+        return _mm_xor_si128(_mm_xor_si128(high, low), next);
+    }
+
+    // Folds the data into the crc. Length must be a multiple of 16 and at least 64.
+    __attribute__((target("pclmul,sse4.1"))) uint32_t fold_clmul(uint32_t crc, const unsigned char* data,
+                                                                   std::size_t length)
+    {
+        __m128i x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+        __m128i x2 = load(data + 0x10);
+        __m128i x3 = load(data + 0x20);
+        __m128i x4 = load(data + 0x30);
+        data += 64;
+        length -= 64;
+
+        // Fold 4 x 128 bits in parallel.
+        __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+        while (length >= 64)
+        {
+            x1 = fold(x1, load(data), k);
+            x2 = fold(x2, load(data + 0x10), k);
+            x3 = fold(x3, load(data + 0x20), k);
+            x4 = fold(x4, load(data + 0x30), k);
+            data += 64;
+            length -= 64;
+        }
+
+        // Fold into 128 bits, then the remaining 16 byte blocks.
+        k = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+        x1 = fold(x1, x2, k);
+        x1 = fold(x1, x3, k);
+        x1 = fold(x1, x4, k);
+        while (length >= 16)
+        {
+            x1 = fold(x1, load(data), k);
+            data += 16;
+            length -= 16;
+        }
+
+        // Fold 128 bits to 64 bits.
+        const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+        x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+        k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        // Barrett reduction to 32 bits.
+        k = _mm_load_si128(reinterpret_cast<const __m128i*>(poly_mu));
+        x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10);
+        x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), k, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+        return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+    }
+#endif
+
+    const bool clmul_available = Crc16Arc::clmul_supported();
+    const auto update_kernel = clmul_available ? &Crc16Arc::update_clmul : &Crc16Arc::update_table;
+} // namespace
+
+uint16_t Crc16Arc::update(uint16_t crc, std::span<const char> data) { return update_kernel(crc, data); }
+
+uint16_t Crc16Arc::update_table(uint16_t crc, std::span<const char> data)
+{
+    auto p = reinterpret_cast<const unsigned char*>(data.data());
+    std::size_t length = data.size();
+    while (length >= 8)
+    {
+        const unsigned int head = crc ^ (p[0] | p[1] << 8);
+        crc = tables[7][head & 0xff] ^ tables[6][head >> 8] ^ tables[5][p[2]] ^ tables[4][p[3]] ^ tables[3][p[4]] ^
+              tables[2][p[5]] ^ tables[1][p[6]] ^ tables[0][p[7]];
+        p += 8;
+        length -= 8;
+    }
+    return update_bytewise(crc, p, length);
+}
+
+uint16_t Crc16Arc::update_clmul(uint16_t crc, std::span<const char> data)
+{
+#ifdef CRC16_ARC_CLMUL
+    // Folding has a fixed setup and reduction cost, below 64 bytes the tables are faster.
+    if (data.size() >= 64 && clmul_available)
+    {
+        const std::size_t fold_length = data.size() & ~std::size_t{15};
+        crc = static_cast<uint16_t>(
+            fold_clmul(crc, reinterpret_cast<const unsigned char*>(data.data()), fold_length));
+        data = data.subspan(fold_length);
+    }
+#endif
+    return update_table(crc, data);
+}
+
+bool Crc16Arc::clmul_supported()
+{
+#ifdef CRC16_ARC_CLMUL
+    // May be called during static initialization, before the cpu model is initialized by the runtime.
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#else
+    return false;
+#endif
+}
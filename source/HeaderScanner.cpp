@@ -0,0 +1,141 @@
+#include "../include/HeaderScanner.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HEADER_SCANNER_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Scalar search starting from the given position, also used for the tails of the SIMD kernels.
+    std::size_t find_from(std::span<const char> data, std::string_view header, std::size_t pos)
+    {
+        if (data.size() < header.size())
+        {
+            return 0;
+        }
+        const std::size_t last_start = data.size() - header.size();
+        while (pos <= last_start)
+        {
+            const auto candidate = static_cast<const char*>(
+                std::memchr(data.data() + pos, header.front(), last_start - pos + 1));
+            if (candidate == nullptr)
+            {
+                break;
+            }
+            pos = candidate - data.data();
+            if (std::memcmp(candidate + 1, header.data() + 1, header.size() - 1) == 0)
+            {
+                return pos;
+            }
+            pos++;
+        }
+        return last_start + 1;
+    }
+
+    // Compares the header bytes between the first and the last one, these two are already known to match.
+    bool middle_matches(const char* candidate, std::string_view header)
+    {
+        return header.size() <= 2 || std::memcmp(candidate + 1, header.data() + 1, header.size() - 2) == 0;
+    }
+
+#ifdef HEADER_SCANNER_SIMD
+    __attribute__((target("avx2"))) std::size_t find_avx2_kernel(std::span<const char> data, std::string_view header)
+    {
+        const __m256i first = _mm256_set1_epi8(header.front());
+        const __m256i last = _mm256_set1_epi8(header.back());
+        const char* const p = data.data();
+        std::size_t pos = 0;
+        // Both loads of a block must stay within the data.
+        while (pos + header.size() - 1 + sizeof(__m256i) <= data.size())
+        {
+            const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + pos));
+            const __m256i block_last =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + pos + header.size() - 1));
+            auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+            while (mask != 0)
+            {
+                const std::size_t candidate = pos + __builtin_ctz(mask);
+                if (middle_matches(p + candidate, header))
+                {
+                    return candidate;
+                }
+                mask &= mask - 1;
+            }
+            pos += sizeof(__m256i);
+        }
+        return find_from(data, header, pos);
+    }
+
+    const bool avx2_available = HeaderScanner::avx2_supported();
+    const auto find_kernel = avx2_available ? &HeaderScanner::find_avx2 : &HeaderScanner::find_sse2;
+#else
+    const auto find_kernel = &HeaderScanner::find_fallback;
+#endif
+} // namespace
+
+std::size_t HeaderScanner::find(std::span<const char> data, std::string_view header)
+{
+    return find_kernel(data, header);
+}
+
+std::size_t HeaderScanner::find_fallback(std::span<const char> data, std::string_view header)
+{
+    return find_from(data, header, 0);
+}
+
+std::size_t HeaderScanner::find_sse2(std::span<const char> data, std::string_view header)
+{
+#ifdef HEADER_SCANNER_SIMD
+    const __m128i first = _mm_set1_epi8(header.front());
+    const __m128i last = _mm_set1_epi8(header.back());
+    const char* const p = data.data();
+    std::size_t pos = 0;
+    // Both loads of a block must stay within the data.
+    while (pos + header.size() - 1 + sizeof(__m128i) <= data.size())
+    {
+        const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + pos));
+        const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + pos + header.size() - 1));
+        auto mask = static_cast<unsigned int>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+        while (mask != 0)
+        {
+            const std::size_t candidate = pos + __builtin_ctz(mask);
+            if (middle_matches(p + candidate, header))
+            {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+        pos += sizeof(__m128i);
+    }
+    return find_from(data, header, pos);
+#else
+    return find_fallback(data, header);
+#endif
+}
+
+std::size_t HeaderScanner::find_avx2(std::span<const char> data, std::string_view header)
+{
+#ifdef HEADER_SCANNER_SIMD
+    if (avx2_available)
+    {
+        return find_avx2_kernel(data, header);
+    }
+#endif
+    return find_sse2(data, header);
+}
+
+bool HeaderScanner::avx2_supported()
+{
+#ifdef HEADER_SCANNER_SIMD
+    // May be called during static initialization, before the cpu model is initialized by the runtime.
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
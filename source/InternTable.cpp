@@ -0,0 +1,136 @@
+#include "../include/InternTable.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+InternTable::InternTable(Options options) : options_{options}
+{
+    if (options_.max_entries == 0 || options_.max_entries > UINT32_MAX - options_.first_id)
+    {
+        throw std::invalid_argument("Invalid intern table size");
+    }
+    index_.resize(std::bit_ceil(options_.max_entries * 2));
+    mask_ = index_.size() - 1;
+    entries_.resize(options_.max_entries);
+    text_ = std::make_unique_for_overwrite<char[]>(options_.max_entries * max_length);
+}
+
+uint32_t InternTable::hash_(std::string_view data)
+{
+    // Word at a time multiply-xorshift, the payloads are short and the keys are not adversarial enough to need more.
+    uint64_t hash = 0x9e3779b97f4a7c15 ^ data.size();
+    std::size_t pos = 0;
+    for (; pos + 8 <= data.size(); pos += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data.data() + pos, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccd;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    if (pos < data.size())
+    {
+        std::memcpy(&tail, data.data() + pos, data.size() - pos);
+    }
+    hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53;
+    hash ^= hash >> 29;
+    hash *= 0xff51afd7ed558ccd;
+    return static_cast<uint32_t>(hash ^ hash >> 32);
+}
+
+std::string_view InternTable::text_of_(std::size_t entry) const
+{
+    return {text_.get() + entry * max_length, entries_[entry].length};
+}
+
+InternTable::Entry InternTable::intern(std::string_view data)
+{
+    if (data.size() > max_length)
+    {
+        throw std::invalid_argument("The payload is too long to intern");
+    }
+    const auto hash = hash_(data);
+    auto pos = hash & mask_;
+    for (; index_[pos].entry != empty; pos = (pos + 1) & mask_)
+    {
+        const auto entry = index_[pos].entry;
+        if (index_[pos].hash == hash && text_of_(entry) == data)
+        {
+            entries_[entry].referenced = true;
+            hits_++;
+            return {static_cast<uint32_t>(options_.first_id + entry), text_of_(entry), false};
+        }
+    }
+
+    const bool full = size_ == options_.max_entries;
+    const auto entry = allocate_();
+    if (full)
+    {
+        // The eviction may have shifted the probe sequence, find the free slot again.
+        for (pos = hash & mask_; index_[pos].entry != empty; pos = (pos + 1) & mask_)
+        {
+        }
+    }
+    std::copy(data.begin(), data.end(), text_.get() + entry * max_length);
+    entries_[entry] = {hash, static_cast<uint8_t>(data.size()), false};
+    index_[pos] = {hash, static_cast<uint32_t>(entry)};
+    return {static_cast<uint32_t>(options_.first_id + entry), text_of_(entry), true};
+}
+
+std::size_t InternTable::allocate_()
+{
+    if (size_ < options_.max_entries)
+    {
+        return size_++;
+    }
+    // CLOCK: entries used since the last pass of the hand are spared once.
+    while (entries_[clock_hand_].referenced)
+    {
+        entries_[clock_hand_].referenced = false;
+        clock_hand_ = (clock_hand_ + 1) % options_.max_entries;
+    }
+    const auto victim = clock_hand_;
+    clock_hand_ = (clock_hand_ + 1) % options_.max_entries;
+    remove_from_index_(victim);
+    evictions_++;
+    return victim;
+}
+
+void InternTable::remove_from_index_(std::size_t entry)
+{
+    auto pos = entries_[entry].hash & mask_;
+    while (index_[pos].entry != entry)
+    {
+        pos = (pos + 1) & mask_;
+    }
+    // Backward shift deletion: move the following slots of the cluster back unless that would put them before their
+    // home slot, so the table needs no tombstones.
+    auto next = pos;
+    while (true)
+    {
+        next = (next + 1) & mask_;
+        if (index_[next].entry == empty)
+        {
+            break;
+        }
+        const auto home = index_[next].hash & mask_;
+        const bool movable = pos <= next ? (home <= pos || home > next) : (home <= pos && home > next);
+        if (movable)
+        {
+            index_[pos] = index_[next];
+            pos = next;
+        }
+    }
+    index_[pos] = Slot{};
+}
+
+std::optional<std::string_view> InternTable::find(uint32_t id) const
+{
+    if (id < options_.first_id || id - options_.first_id >= size_)
+    {
+        return std::nullopt;
+    }
+    return text_of_(id - options_.first_id);
+}
@@ -0,0 +1,303 @@
+#include "../include/IoUring.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/SystemError.hpp"
+
+namespace
+{
+    int io_uring_setup(unsigned entries, io_uring_params* params)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    int io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+    }
+
+    template <typename T>
+    T* at_offset(void* base, uint32_t offset)
+    {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+    // Closes the file descriptor when leaving the scope.
+    struct FdGuard
+    {
+        int fd;
+
+        ~FdGuard()
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+    };
+} // namespace
+
+IoUring::IoUring(unsigned entries, unsigned completion_entries)
+{
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    params.cq_entries = std::max(completion_entries, entries * 2);
+    fd_ = io_uring_setup(entries, &params);
+    if (fd_ < 0)
+    {
+        sys::throw_errno("io_uring_setup");
+    }
+    try
+    {
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0)
+        {
+            throw std::runtime_error("io_uring: the kernel is too old (no IORING_FEAT_SINGLE_MMAP)");
+        }
+        rings_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                               params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        rings_ = ::mmap(nullptr, rings_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                        IORING_OFF_SQ_RING);
+        if (rings_ == MAP_FAILED)
+        {
+            rings_ = nullptr;
+            sys::throw_errno("io_uring mmap");
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        auto* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                            IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            sys::throw_errno("io_uring mmap");
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+    }
+    catch (...)
+    {
+        close_();
+        throw;
+    }
+
+    sq_head_ = at_offset<unsigned>(rings_, params.sq_off.head);
+    sq_tail_ = at_offset<unsigned>(rings_, params.sq_off.tail);
+    sq_mask_ = *at_offset<unsigned>(rings_, params.sq_off.ring_mask);
+    sq_flags_ = at_offset<unsigned>(rings_, params.sq_off.flags);
+    sq_entries_ = params.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+    // Submission entries are always used in order, so the indirection array is an identity mapping.
+    auto* sq_array = at_offset<unsigned>(rings_, params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; i++)
+    {
+        sq_array[i] = i;
+    }
+
+    cq_head_ = at_offset<unsigned>(rings_, params.cq_off.head);
+    cq_tail_ = at_offset<unsigned>(rings_, params.cq_off.tail);
+    cq_mask_ = *at_offset<unsigned>(rings_, params.cq_off.ring_mask);
+    cqes_ = at_offset<io_uring_cqe>(rings_, params.cq_off.cqes);
+}
+
+IoUring::~IoUring() { close_(); }
+
+void IoUring::close_()
+{
+    if (sqes_ != nullptr)
+    {
+        ::munmap(sqes_, sqes_size_);
+    }
+    if (rings_ != nullptr)
+    {
+        ::munmap(rings_, rings_size_);
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+void IoUring::enter_(unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    while (io_uring_enter(fd_, to_submit, min_complete, flags) < 0)
+    {
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EBUSY)
+        {
+            // The kernel is short on resources or the completion queue is full. The entries stay in the submission
+            // queue and are passed again on the next call, once the pending completions are processed.
+            return;
+        }
+        sys::throw_errno("io_uring_enter");
+    }
+}
+
+io_uring_sqe* IoUring::get_sqe()
+{
+    if (sq_local_tail_ - std::atomic_ref(*sq_head_).load(std::memory_order_acquire) >= sq_entries_)
+    {
+        submit();
+        // The kernel may refuse the entries, the slots are still its own then.
+        if (sq_local_tail_ - std::atomic_ref(*sq_head_).load(std::memory_order_acquire) >= sq_entries_)
+        {
+            return nullptr;
+        }
+    }
+    auto* sqe = &sqes_[sq_local_tail_ & sq_mask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_local_tail_++;
+    return sqe;
+}
+
+void IoUring::submit()
+{
+    std::atomic_ref(*sq_tail_).store(sq_local_tail_, std::memory_order_release);
+    const auto to_submit = sq_local_tail_ - std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+    if (to_submit > 0)
+    {
+        enter_(to_submit, 0, 0);
+    }
+}
+
+void IoUring::flush_overflow_()
+{
+    if ((std::atomic_ref(*sq_flags_).load(std::memory_order_acquire) & IORING_SQ_CQ_OVERFLOW) != 0)
+    {
+        enter_(0, 0, IORING_ENTER_GETEVENTS);
+    }
+}
+
+void IoUring::submit_and_wait()
+{
+    std::atomic_ref(*sq_tail_).store(sq_local_tail_, std::memory_order_release);
+    enter_(sq_local_tail_ - std::atomic_ref(*sq_head_).load(std::memory_order_acquire), 1, IORING_ENTER_GETEVENTS);
+}
+
+void IoUring::register_eventfd(int event_fd)
+{
+    if (io_uring_register(fd_, IORING_REGISTER_EVENTFD, &event_fd, 1) < 0)
+    {
+        sys::throw_errno("io_uring_register(IORING_REGISTER_EVENTFD)");
+    }
+}
+
+void IoUring::register_buffer_ring(const io_uring_buf_ring* ring, unsigned entries, uint16_t group)
+{
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = entries;
+    reg.bgid = group;
+    if (io_uring_register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        sys::throw_errno("io_uring_register(IORING_REGISTER_PBUF_RING)");
+    }
+}
+
+void IoUring::prepare_multishot_recv(io_uring_sqe* sqe, int fd, uint16_t group, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = user_data;
+}
+
+bool IoUring::multishot_recv_supported()
+{
+    try
+    {
+        // The buffers must outlive the ring.
+        ProvidedBuffers buffers(2, 64);
+        IoUring ring(4);
+        ring.register_buffer_ring(buffers.ring(), buffers.count(), 0);
+
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        {
+            return false;
+        }
+        const FdGuard reader{fds[0]};
+        const FdGuard writer{fds[1]};
+        if (::write(fds[1], "x", 1) != 1)
+        {
+            return false;
+        }
+        auto* sqe = ring.get_sqe();
+        if (sqe == nullptr)
+        {
+            return false;
+        }
+        prepare_multishot_recv(sqe, fds[0], 0, 0);
+        ring.submit_and_wait();
+        bool supported = false;
+        ring.process_completions(
+            [&supported](const io_uring_cqe& cqe)
+            {
+                // Kernels without multishot receive reject the request. The request stays armed after the data was
+                // received (IORING_CQE_F_MORE) and is cancelled when the ring is closed.
+                supported =
+                    cqe.res == 1 && (cqe.flags & IORING_CQE_F_BUFFER) != 0 && (cqe.flags & IORING_CQE_F_MORE) != 0;
+            });
+        return supported;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+ProvidedBuffers::ProvidedBuffers(unsigned count, std::size_t buffer_size) : count_{count}, buffer_size_{buffer_size}
+{
+    if (!std::has_single_bit(count) || count > 32768)
+    {
+        throw std::invalid_argument("Provided buffer count must be a power of two up to 32768");
+    }
+    if (buffer_size == 0 || buffer_size > std::numeric_limits<uint32_t>::max())
+    {
+        throw std::invalid_argument("Provided buffer size must be between 1 and 4294967295");
+    }
+    data_ = std::make_unique_for_overwrite<char[]>(count * buffer_size);
+    ring_size_ = count * sizeof(io_uring_buf);
+    auto* ring = ::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED)
+    {
+        sys::throw_errno("mmap");
+    }
+    ring_ = static_cast<io_uring_buf_ring*>(ring);
+    for (unsigned id = 0; id < count_; id++)
+    {
+        add_(static_cast<uint16_t>(id));
+    }
+    publish();
+}
+
+ProvidedBuffers::~ProvidedBuffers() { ::munmap(ring_, ring_size_); }
+
+void ProvidedBuffers::add_(uint16_t id)
+{
+    // The entries start at the beginning of the ring. ring_->bufs can not be used: in C++ the empty struct emitted by
+    // __DECLARE_FLEX_ARRAY has a non-zero size and shifts the array. The fields are set one by one as the ring tail
+    // overlays the reserved field of the first entry.
+    auto& buffer = reinterpret_cast<io_uring_buf*>(ring_)[tail_ & (count_ - 1)];
+    buffer.addr = reinterpret_cast<uint64_t>(data_.get() + id * buffer_size_);
+    buffer.len = static_cast<uint32_t>(buffer_size_);
+    buffer.bid = id;
+    tail_++;
+}
+
+void ProvidedBuffers::publish() { std::atomic_ref(ring_->tail).store(tail_, std::memory_order_release); }
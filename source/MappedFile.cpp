@@ -0,0 +1,47 @@
+#include "../include/MappedFile.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::system_category(), "open " + path);
+    }
+    struct stat status{};
+    if (::fstat(fd, &status) != 0)
+    {
+        const auto error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::system_category(), "fstat " + path);
+    }
+    size_ = static_cast<std::size_t>(status.st_size);
+    if (size_ == 0)
+    {
+        ::close(fd); // nothing to map
+        return;
+    }
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    const auto error = errno;
+    ::close(fd); // the mapping keeps the file open
+    if (mapping == MAP_FAILED)
+    {
+        throw std::system_error(error, std::system_category(), "mmap " + path);
+    }
+    ::madvise(mapping, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(mapping);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+    {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
@@ -0,0 +1,42 @@
+#include "../include/MemoryPool.hpp"
+
+#include <algorithm>
+
+MemoryPool::~MemoryPool()
+{
+    while (free_ != nullptr)
+    {
+        ::operator delete(std::exchange(free_, free_->next));
+    }
+}
+
+void* MemoryPool::allocate(std::size_t size)
+{
+    if (object_size_ == 0)
+    {
+        object_size_ = size;
+    }
+    if (size != object_size_)
+    {
+        return ::operator new(size);
+    }
+    if (free_ != nullptr)
+    {
+        free_count_--;
+        return std::exchange(free_, free_->next);
+    }
+    block_count_++;
+    // A released block must be able to hold the free list link.
+    return ::operator new(std::max(size, sizeof(FreeBlock)));
+}
+
+void MemoryPool::deallocate(void* block, std::size_t size) noexcept
+{
+    if (size != object_size_)
+    {
+        ::operator delete(block);
+        return;
+    }
+    free_ = new (block) FreeBlock{free_};
+    free_count_++;
+}
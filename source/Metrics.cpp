@@ -0,0 +1,99 @@
+#include "../include/Metrics.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    // Shards of all the threads that have recorded anything.
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<metrics::Shard>> shards;
+    };
+
+    Registry& registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    constexpr std::array<std::string_view, metrics::counter_count> counter_names{
+        "connections_opened",
+        "connections_closed",
+        "reads",
+        "bytes_read",
+        "command_1",
+        "command_2",
+        "command_3",
+        "crc_failures",
+        "unknown_command_ids",
+        "skipped_bytes",
+        "response_bytes",
+        "read_pauses",
+    };
+
+    constexpr std::array<std::string_view, metrics::histogram_count> histogram_names{
+        "read_size",
+        "packets_per_read",
+        "handler_time_ns",
+        "receive_latency_ns",
+    };
+} // namespace
+
+void metrics::Shard::collect(Histogram histogram, LatencyHistogram& result) const
+{
+    const auto& buckets = histograms_[static_cast<std::size_t>(histogram)];
+    for (std::size_t i = 0; i < buckets.size(); i++)
+    {
+        result.record(LatencyHistogram::bucket_lower_bound(i), buckets[i].load(std::memory_order_relaxed));
+    }
+}
+
+metrics::Shard& metrics::detail::register_shard()
+{
+    auto& instance = registry();
+    const std::lock_guard lock(instance.mutex);
+    return *instance.shards.emplace_back(std::make_unique<Shard>());
+}
+
+metrics::Snapshot metrics::collect()
+{
+    Snapshot snapshot;
+    auto& instance = registry();
+    const std::lock_guard lock(instance.mutex);
+    for (const auto& shard : instance.shards)
+    {
+        for (std::size_t i = 0; i < counter_count; i++)
+        {
+            snapshot.counters[i] += shard->counter(static_cast<Counter>(i));
+        }
+        for (std::size_t i = 0; i < histogram_count; i++)
+        {
+            shard->collect(static_cast<Histogram>(i), snapshot.histograms[i]);
+        }
+    }
+    return snapshot;
+}
+
+void metrics::write_json(std::ostream& stream, const Snapshot& snapshot)
+{
+    stream << '{';
+    for (std::size_t i = 0; i < counter_count; i++)
+    {
+        stream << '"' << counter_names[i] << "\":" << snapshot.counters[i] << ',';
+    }
+    stream << "\"connections_active\":"
+           << snapshot.counter(Counter::connections_opened) - snapshot.counter(Counter::connections_closed);
+    for (std::size_t i = 0; i < histogram_count; i++)
+    {
+        const auto& histogram = snapshot.histograms[i];
+        stream << ",\"" << histogram_names[i] << "\":{\"count\":" << histogram.count()
+               << ",\"mean\":" << histogram.mean() << ",\"p50\":" << histogram.percentile(50)
+               << ",\"p90\":" << histogram.percentile(90) << ",\"p99\":" << histogram.percentile(99)
+               << ",\"p99_9\":" << histogram.percentile(99.9) << ",\"max\":" << histogram.max() << '}';
+    }
+    stream << "}\n";
+}
@@ -0,0 +1,232 @@
+#include "../include/OutputSink.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+struct OutputSink::Block
+{
+    std::unique_ptr<char[]> data;
+    std::size_t size = 0;
+};
+
+namespace
+{
+    // Writes all the buffers, retrying partial and interrupted writes. Returns false on an unrecoverable error.
+    bool write_all(int fd, std::vector<iovec>& iov)
+    {
+        std::size_t index = 0;
+        while (index < iov.size())
+        {
+            const auto count = static_cast<int>(std::min<std::size_t>(iov.size() - index, IOV_MAX));
+            const auto written = ::writev(fd, iov.data() + index, count);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    // Non-blocking descriptor - wait until the consumer catches up.
+                    pollfd poll_fd{fd, POLLOUT, 0};
+                    ::poll(&poll_fd, 1, -1);
+                    continue;
+                }
+                return false;
+            }
+            // Skip the fully written buffers and adjust the partially written one.
+            auto left = static_cast<std::size_t>(written);
+            while (index < iov.size() && left >= iov[index].iov_len)
+            {
+                left -= iov[index].iov_len;
+                index++;
+            }
+            if (left > 0)
+            {
+                iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + left;
+                iov[index].iov_len -= left;
+            }
+        }
+        return true;
+    }
+} // namespace
+
+OutputSink::Buffer::Buffer(OutputSink& sink) : sink_{sink} {}
+
+OutputSink::Buffer::~Buffer() { release_(pptr()); }
+
+void OutputSink::Buffer::release_(const char* end)
+{
+    const auto size = static_cast<std::size_t>(end - pbase());
+    if (block_ != nullptr)
+    {
+        block_->size = size;
+        sink_.submit_(block_);
+        block_ = nullptr;
+    }
+    else if (size > 0)
+    {
+        // The data was written to the spill area because no block was available.
+        sink_.dropped_bytes_.fetch_add(size, std::memory_order_relaxed);
+    }
+    setp(nullptr, nullptr);
+}
+
+OutputSink::Buffer::int_type OutputSink::Buffer::overflow(int_type ch)
+{
+    // Only hand over the complete lines and move the incomplete one to the next block, so that lines written by
+    // different threads are never interleaved. A block without any line breaks is handed over as is.
+    const char* end = std::find(std::make_reverse_iterator(pptr()), std::make_reverse_iterator(pbase()), '\n').base();
+    if (end == pbase())
+    {
+        end = pptr();
+    }
+    carry_.assign(end, static_cast<const char*>(pptr()));
+    release_(end);
+
+    block_ = sink_.acquire_();
+    char* begin = nullptr;
+    if (block_ != nullptr)
+    {
+        begin = block_->data.get();
+    }
+    else
+    {
+        if (!spill_)
+        {
+            spill_ = std::make_unique<char[]>(sink_.options_.flush_size);
+        }
+        begin = spill_.get();
+    }
+    setp(begin, begin + sink_.options_.flush_size);
+    std::copy(carry_.begin(), carry_.end(), pptr());
+    pbump(static_cast<int>(carry_.size()));
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int OutputSink::Buffer::sync()
+{
+    // Only hand over the data, the next block is taken when something is written again. This way idle threads do not
+    // hold any blocks.
+    release_(pptr());
+    return 0;
+}
+
+OutputSink::OutputSink(int fd, Options options) :
+    fd_{fd}, options_{options}, free_{std::max<std::size_t>(options.block_count, 2)},
+    filled_{std::max<std::size_t>(options.block_count, 2)}
+{
+    for (std::size_t i = 0; i < std::max<std::size_t>(options_.block_count, 2); i++)
+    {
+        blocks_.push_back(std::make_unique<Block>());
+        blocks_.back()->data = std::make_unique<char[]>(options_.flush_size);
+        free_.try_push(blocks_.back().get());
+    }
+    writer_ = std::jthread([this] { write_loop_(); });
+}
+
+OutputSink::~OutputSink()
+{
+    stopping_.store(true, std::memory_order_release);
+    submitted_.fetch_add(1, std::memory_order_release);
+    submitted_.notify_one();
+    writer_.join();
+}
+
+OutputSink::Block* OutputSink::acquire_()
+{
+    for (;;)
+    {
+        const auto seen = recycled_.load(std::memory_order_acquire);
+        Block* block = nullptr;
+        if (free_.try_pop(block))
+        {
+            return block;
+        }
+        if (options_.overflow_policy == OverflowPolicy::drop)
+        {
+            return nullptr;
+        }
+        recycled_.wait(seen, std::memory_order_acquire);
+    }
+}
+
+void OutputSink::submit_(Block* block)
+{
+    if (block->size == 0)
+    {
+        free_.try_push(block); // never fails - both queues can hold all the blocks
+        recycled_.fetch_add(1, std::memory_order_release);
+        recycled_.notify_all();
+        return;
+    }
+    filled_.try_push(block);
+    submitted_.fetch_add(1, std::memory_order_release);
+    submitted_.notify_one();
+}
+
+void OutputSink::write_loop_()
+{
+    std::vector<Block*> batch;
+    std::vector<iovec> iov;
+    batch.reserve(blocks_.size());
+    iov.reserve(blocks_.size());
+    for (;;)
+    {
+        // Read the flags before draining the queue, so nothing submitted before stopping can be missed.
+        const auto seen = submitted_.load(std::memory_order_acquire);
+        const auto stopping = stopping_.load(std::memory_order_acquire);
+        Block* block = nullptr;
+        while (filled_.try_pop(block))
+        {
+            batch.push_back(block);
+        }
+        if (!batch.empty())
+        {
+            std::size_t batch_size = 0;
+            for (const Block* filled : batch)
+            {
+                iov.push_back(iovec{filled->data.get(), filled->size});
+                batch_size += filled->size;
+            }
+            if (write_failed_)
+            {
+                dropped_bytes_.fetch_add(batch_size, std::memory_order_relaxed);
+            }
+            else if (!write_all(fd_, iov))
+            {
+                // Nothing else can be done from the writer thread, the rest of the output will be dropped.
+                std::cerr << "Output write failed: " << std::strerror(errno) << '\n';
+                write_failed_ = true;
+                dropped_bytes_.fetch_add(batch_size, std::memory_order_relaxed);
+            }
+            for (Block* written : batch)
+            {
+                written->size = 0;
+                free_.try_push(written);
+            }
+            batch.clear();
+            iov.clear();
+            recycled_.fetch_add(1, std::memory_order_release);
+            recycled_.notify_all();
+            continue;
+        }
+        if (stopping)
+        {
+            return;
+        }
+        submitted_.wait(seen, std::memory_order_acquire);
+    }
+}
@@ -1,7 +1,11 @@
 #include "../include/Params.hpp"
 #include <boost/program_options.hpp>
+#include <cstdint>
 #include <iostream>
 
+#include "../include/BinaryFormat.hpp"
+#include "../include/CommandPrinter.hpp"
+
 namespace po = boost::program_options;
 
 
@@ -11,7 +15,76 @@ Params::Params(int argc, char* argv[])
     po::options_description desc("Allowed options");
     desc.add_options()
         ("help,h", "Show help message")
-        ("port,p", po::value<int>(&port), "Specify port number. Arbitrary port will be used if none given.");
+        ("port,p", po::value<int>(&port), "Specify port number. Arbitrary port will be used if none given.")
+        ("threads,t", po::value<int>(&threads), "Number of event loop threads. Connections are distributed between the "
+                                                "threads by the kernel (SO_REUSEPORT). 1 by default.")
+        ("pin-threads", po::bool_switch(&pin_threads), "Pin every event loop thread to a separate CPU core.")
+        ("busy-spin", po::bool_switch(&busy_spin), "Poll the event loops for ready handlers without ever sleeping. "
+                                                   "Takes a whole CPU core per thread, implies --pin-threads.")
+        ("flush-size", po::value<int>(&flush_size), "Output block size in bytes. 65536 by default.")
+        ("flush-interval", po::value<int>(&flush_interval), "Maximal output delay in milliseconds. 100 by default.")
+        ("output-blocks", po::value<int>(&output_blocks), "Number of output blocks. 64 by default.")
+        ("drop-output", po::bool_switch(&drop_output), "Drop the output instead of waiting when the output consumer "
+                                                       "is too slow.")
+        ("output-format", po::value<std::string>(&output_format), "Output format of the commands: text lines or "
+                                                                  "compact binary blocks (see tools/binreader). "
+                                                                  "text by default.")
+        ("compress-output", po::bool_switch(&compress_output), "Compress the binary output blocks with zlib.")
+        ("receive-buffer-min", po::value<int>(&receive_buffer_min), "Initial receive buffer size of a connection in "
+                                                                    "bytes. 256 by default. Not used by --io-uring, "
+                                                                    "its buffers are always of the maximal size.")
+        ("receive-buffer-max", po::value<int>(&receive_buffer_max), "Receive buffers grow up to this size for busy "
+                                                                    "connections. 65536 by default. Also the size "
+                                                                    "of the --io-uring buffers.")
+        ("shared-receive-buffer", po::bool_switch(&shared_receive_buffer), "Connections do not own receive buffers, "
+                                                                           "all connections of a thread read into "
+                                                                           "one buffer of the maximal size. Always the "
+                                                                           "case with --io-uring.")
+        ("io-uring", po::bool_switch(&io_uring), "Receive the data through io_uring with multishot receive and "
+                                                 "provided buffers (Linux 6.0+). Falls back to epoll if not "
+                                                 "available.")
+        ("tcp-nodelay", po::bool_switch(&tcp_nodelay), "Disable the Nagle algorithm on the connections (TCP_NODELAY).")
+        ("tcp-quickack", po::bool_switch(&tcp_quickack), "Acknowledge every read right away instead of delaying the "
+                                                         "acknowledgements (TCP_QUICKACK).")
+        ("socket-receive-buffer", po::value<int>(&socket_receive_buffer), "Kernel receive buffer size of a connection "
+                                                                          "in bytes (SO_RCVBUF). Automatic by "
+                                                                          "default.")
+        ("busy-poll", po::value<int>(&busy_poll), "Busy poll the device queue for up to this many microseconds on "
+                                                  "reads of an empty socket (SO_BUSY_POLL, may need CAP_NET_ADMIN).")
+        ("measure-latency", po::bool_switch(&measure_latency), "Measure the time from the kernel receiving the data "
+                                                               "to the parser call (receive_latency_ns in the "
+                                                               "metrics). Written to stderr on exit. Not supported "
+                                                               "by --io-uring.")
+        ("responses", po::bool_switch(&responses), "Answer every packet of a connection with an ACK frame, or a NAK "
+                                                   "frame if its checksum or command id is invalid. Not supported by "
+                                                   "--io-uring.")
+        ("response-queue", po::value<int>(&response_queue), "Reading from a connection pauses while this many bytes "
+                                                            "of its responses are not sent. 65536 by default.")
+        ("udp-port", po::value<int>(&udp_port), "Also receive the packets as UDP datagrams on this port, every "
+                                                "datagram holding complete packets. 0 selects an arbitrary port.")
+        ("udp-batch", po::value<int>(&udp_batch), "Datagrams received per system call, at most 1024. 64 by "
+                                                  "default.")
+        ("udp-gro", po::bool_switch(&udp_gro), "Let the kernel coalesce the datagrams of a source (UDP_GRO).")
+        ("unix-socket", po::value<std::string>(&unix_socket), "Also accept connections of local clients on this unix "
+                                                              "socket file.")
+        ("shm-socket", po::value<std::string>(&shm_socket), "Also accept shared memory rings of local producers (see "
+                                                            "ShmProducer) on this unix socket file.")
+        ("intern", po::value<int>(&intern), "Print every distinct command 1 payload once and refer to it by an id "
+                                            "afterwards. The value is the number of ids per thread, rarely used "
+                                            "payloads are replaced when they run out. Text output without "
+                                            "--drop-output only.")
+        ("telemetry", po::bool_switch(&telemetry), "Aggregate the command 3 samples per key (count, sum, min, max, "
+                                                   "last) instead of writing them to the output. The aggregates are "
+                                                   "written to stderr on SIGUSR1 and on exit.")
+        ("telemetry-interval", po::value<int>(&telemetry_interval), "Also write the telemetry aggregates every this "
+                                                                    "many milliseconds.")
+        ("capture", po::value<std::string>(&capture), "Write the raw received data of every connection with the read "
+                                                      "times and boundaries to the file, replacing it.")
+        ("replay", po::value<std::string>(&replay), "Decode a capture file to stdout instead of running the server.")
+        ("replay-timing", po::bool_switch(&replay_timing), "Replay the reads at their original times instead of as "
+                                                           "fast as possible.")
+        ("decode", po::value<std::string>(&decode), "Decode a file of raw client data (a byte stream as sent to the "
+                                                    "server) to stdout on all the --threads and exit.");
 
     // Parse command line
     po::variables_map vm;
@@ -33,4 +106,119 @@ Params::Params(int argc, char* argv[])
         no_run = true;
         invalid = true;
     }
+
+    // Handle UDP arguments. A system call receives at most 1024 datagrams (UIO_MAXIOV).
+    if (udp_port < -1 || udp_port > 65535 || udp_batch < 1 || udp_batch > 1024)
+    {
+        std::cerr << "Error: Invalid UDP parameters.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // Handle threads argument
+    if (threads < 1)
+    {
+        std::cerr << "Error: Invalid number of threads.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // A spinning loop must not share its core with anything else.
+    if (busy_spin)
+    {
+        pin_threads = true;
+    }
+
+    // Handle output arguments
+    if (flush_size < 1 || flush_interval < 1 || output_blocks < 2)
+    {
+        std::cerr << "Error: Invalid output buffering parameters.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // Handle output format arguments
+    // A text line must fit into a single block, otherwise it may be interleaved with the lines of other threads.
+    if ((output_format != "text" && output_format != "binary") || (compress_output && output_format != "binary") ||
+        (output_format == "binary" &&
+         (flush_size < 1024 || static_cast<std::size_t>(flush_size) > binary_format::max_block_size)) ||
+        (output_format == "text" && flush_size < static_cast<int>(CommandPrinter::max_line_size)))
+    {
+        std::cerr << "Error: Invalid output format. Compression requires the binary format, which requires a flush "
+                     "size of at least 1024 bytes and at most 64 MiB. The text format requires a flush size of at "
+                     "least "
+                  << CommandPrinter::max_line_size << " bytes.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // Handle receive buffer arguments
+    if (receive_buffer_min < 1 || receive_buffer_max < receive_buffer_min)
+    {
+        std::cerr << "Error: Invalid receive buffer sizes.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // Handle socket arguments
+    if (socket_receive_buffer < 0 || busy_poll < 0)
+    {
+        std::cerr << "Error: Invalid socket parameters.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // Handle response arguments
+    if (response_queue < 1)
+    {
+        std::cerr << "Error: Invalid response queue size.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // Handle interning arguments. Every thread has its own range of ids, all of them must fit 32 bits. A dropped block
+    // may hold the definition of an id, so interning requires the complete output.
+    if (intern < 0 || intern > 1024 * 1024 || (intern > 0 && (output_format != "text" || drop_output)) ||
+        static_cast<uint64_t>(threads) * static_cast<uint64_t>(intern) > UINT32_MAX)
+    {
+        std::cerr << "Error: Invalid intern table size, at most 1048576 entries with the text output format and "
+                     "without dropping output, and at most 4294967295 ids for all the threads.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // Handle telemetry arguments
+    if (telemetry_interval < 0 || (telemetry_interval > 0 && !telemetry))
+    {
+        std::cerr << "Error: Invalid telemetry interval, it also requires --telemetry.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // Handle local transport arguments
+    if (!unix_socket.empty() && unix_socket == shm_socket)
+    {
+        std::cerr << "Error: --unix-socket and --shm-socket need different paths.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
+
+    // Handle capture arguments
+    if (!capture.empty() + !replay.empty() + !decode.empty() > 1)
+    {
+        std::cerr << "Error: Only one of --capture, --replay and --decode may be given.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+    }
 }
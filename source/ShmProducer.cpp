@@ -0,0 +1,104 @@
+#include "../include/ShmProducer.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+
+#include "../include/SystemError.hpp"
+
+namespace
+{
+    int connect_unix(const std::string& path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            throw std::invalid_argument("Unix socket path is too long: " + path);
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            sys::throw_errno("socket");
+        }
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            const auto error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::system_category(), "connect " + path);
+        }
+        return fd;
+    }
+
+    // Sends the descriptors with a single byte of data, as a message without data can not carry them.
+    void send_descriptors(int socket, const std::array<int, 3>& descriptors)
+    {
+        char byte = 0;
+        iovec data{&byte, 1};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(descriptors))]{};
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        auto* cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(descriptors));
+        std::memcpy(CMSG_DATA(cmsg), descriptors.data(), sizeof(descriptors));
+        while (::sendmsg(socket, &message, MSG_NOSIGNAL) != 1)
+        {
+            if (errno != EINTR)
+            {
+                sys::throw_errno("sendmsg");
+            }
+        }
+    }
+} // namespace
+
+ShmProducer::ShmProducer(const std::string& path, std::size_t capacity) : ring_{capacity}
+{
+    socket_ = connect_unix(path);
+    try
+    {
+        send_descriptors(socket_, ring_.descriptors());
+    }
+    catch (...)
+    {
+        ::close(socket_);
+        throw;
+    }
+}
+
+ShmProducer::~ShmProducer() { ::close(socket_); }
+
+void ShmProducer::write(std::span<const char> data)
+{
+    data = data.subspan(ring_.write(data));
+    while (!data.empty())
+    {
+        if (ring_.prepare_space_wait())
+        {
+            // The server never sends anything, so a readable socket means it has closed the connection.
+            pollfd events[2] = {{ring_.space_event(), POLLIN, 0}, {socket_, POLLIN, 0}};
+            if (::poll(events, 2, -1) < 0 && errno != EINTR)
+            {
+                sys::throw_errno("poll");
+            }
+            if (events[1].revents != 0)
+            {
+                throw std::runtime_error("The server has closed the shared memory ring");
+            }
+            uint64_t count = 0;
+            [[maybe_unused]] const auto cleared = ::read(ring_.space_event(), &count, sizeof(count));
+        }
+        data = data.subspan(ring_.write(data));
+    }
+}
@@ -0,0 +1,208 @@
+#include "../include/ShmRing.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/SystemError.hpp"
+
+namespace
+{
+    bool valid_capacity(std::size_t capacity)
+    {
+        const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        return capacity > 0 && (capacity & (capacity - 1)) == 0 && capacity % page_size == 0;
+    }
+
+    void close_descriptors(std::initializer_list<int> descriptors)
+    {
+        for (const int fd : descriptors)
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+    }
+} // namespace
+
+ShmRing::ShmRing(std::size_t capacity) : capacity_{capacity}
+{
+    if (!valid_capacity(capacity))
+    {
+        throw std::invalid_argument("Invalid shared memory ring capacity");
+    }
+    try
+    {
+        memory_fd_ = ::memfd_create("shm_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (memory_fd_ < 0)
+        {
+            sys::throw_errno("memfd_create");
+        }
+        if (::ftruncate(memory_fd_, static_cast<off_t>(shm_ring::control_size + capacity_)) != 0)
+        {
+            sys::throw_errno("ftruncate");
+        }
+        // The consumer relies on the size, a shrunk file would fault its reads.
+        if (::fcntl(memory_fd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0)
+        {
+            sys::throw_errno("memfd seal");
+        }
+        data_event_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        space_event_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (data_event_ < 0 || space_event_ < 0)
+        {
+            sys::throw_errno("eventfd");
+        }
+        map_();
+        new (control_) shm_ring::Control{};
+        control_->magic = shm_ring::magic;
+    }
+    catch (...)
+    {
+        release_();
+        throw;
+    }
+}
+
+ShmRing::ShmRing(int memory_fd, int data_event, int space_event) :
+    memory_fd_{memory_fd}, data_event_{data_event}, space_event_{space_event}
+{
+    try
+    {
+        const int seals = ::fcntl(memory_fd_, F_GET_SEALS);
+        if (seals < 0 || (seals & F_SEAL_SHRINK) == 0)
+        {
+            throw std::runtime_error("The shared memory ring is not sealed");
+        }
+        struct stat status{};
+        if (::fstat(memory_fd_, &status) != 0)
+        {
+            sys::throw_errno("fstat");
+        }
+        const auto size = static_cast<std::size_t>(status.st_size);
+        capacity_ = size > shm_ring::control_size ? size - shm_ring::control_size : 0;
+        if (!valid_capacity(capacity_))
+        {
+            throw std::runtime_error("Invalid shared memory ring size");
+        }
+        map_();
+        if (control_->magic != shm_ring::magic)
+        {
+            throw std::runtime_error("Not a shared memory ring");
+        }
+    }
+    catch (...)
+    {
+        release_();
+        throw;
+    }
+}
+
+ShmRing::~ShmRing() { release_(); }
+
+void ShmRing::release_()
+{
+    if (mapping_ != nullptr)
+    {
+        ::munmap(mapping_, shm_ring::control_size + capacity_);
+        mapping_ = nullptr;
+    }
+    close_descriptors({memory_fd_, data_event_, space_event_});
+    memory_fd_ = data_event_ = space_event_ = -1;
+}
+
+void ShmRing::map_()
+{
+    void* mapping =
+        ::mmap(nullptr, shm_ring::control_size + capacity_, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd_, 0);
+    if (mapping == MAP_FAILED)
+    {
+        sys::throw_errno("mmap");
+    }
+    mapping_ = mapping;
+    control_ = static_cast<shm_ring::Control*>(mapping);
+    data_ = static_cast<char*>(mapping) + shm_ring::control_size;
+}
+
+void ShmRing::signal_(int event)
+{
+    const uint64_t one = 1;
+    // Only fails if the counter is about to overflow, and then the other side has a wakeup pending anyway.
+    [[maybe_unused]] const auto written = ::write(event, &one, sizeof(one));
+}
+
+std::size_t ShmRing::write(std::span<const char> data)
+{
+    const auto head = control_->head.load(std::memory_order_relaxed);
+    const auto used = head - control_->tail.load(std::memory_order_acquire);
+    const auto length = std::min<std::size_t>(data.size(), used <= capacity_ ? capacity_ - used : 0);
+    if (length == 0)
+    {
+        return 0;
+    }
+    const auto offset = head & (capacity_ - 1);
+    const auto first = std::min(length, capacity_ - offset);
+    std::memcpy(data_ + offset, data.data(), first);
+    std::memcpy(data_, data.data() + first, length - first);
+    // Sequentially consistent, so either the consumer sees the new head after announcing its wait or the producer sees
+    // the announcement.
+    control_->head.store(head + length);
+    if (control_->consumer_waiting.load() != 0 && control_->consumer_waiting.exchange(0) != 0)
+    {
+        signal_(data_event_);
+    }
+    return length;
+}
+
+bool ShmRing::prepare_space_wait()
+{
+    control_->producer_waiting.store(1);
+    if (control_->head.load(std::memory_order_relaxed) - control_->tail.load() < capacity_)
+    {
+        control_->producer_waiting.store(0);
+        return false;
+    }
+    return true;
+}
+
+std::array<std::span<char>, 2> ShmRing::readable() const
+{
+    const auto tail = control_->tail.load(std::memory_order_relaxed);
+    const auto length = control_->head.load(std::memory_order_acquire) - tail;
+    if (length > capacity_)
+    {
+        throw std::runtime_error("Corrupt shared memory ring");
+    }
+    const auto offset = tail & (capacity_ - 1);
+    const auto first = std::min<std::size_t>(length, capacity_ - offset);
+    return {std::span(data_ + offset, first), std::span(data_, length - first)};
+}
+
+void ShmRing::consume(std::size_t length)
+{
+    control_->tail.store(control_->tail.load(std::memory_order_relaxed) + length);
+    if (control_->producer_waiting.load() != 0 && control_->producer_waiting.exchange(0) != 0)
+    {
+        signal_(space_event_);
+    }
+}
+
+bool ShmRing::prepare_data_wait()
+{
+    control_->consumer_waiting.store(1);
+    if (control_->head.load() != control_->tail.load(std::memory_order_relaxed))
+    {
+        control_->consumer_waiting.store(0);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+#include "../include/Telemetry.hpp"
+
+#include <algorithm>
+
+void TelemetryTable::Shard::collect(std::span<KeyStats, key_count> totals,
+                                    std::span<uint64_t, key_count> last_times) const
+{
+    for (std::size_t key = 0; key < key_count; key++)
+    {
+        const auto& slot = slots_[key];
+        const auto count = slot.count.load(std::memory_order_acquire);
+        if (count == 0)
+        {
+            continue;
+        }
+        const auto values = slot.values.load(std::memory_order_relaxed);
+        const auto min = static_cast<uint8_t>(values & 0xff);
+        const auto max = static_cast<uint8_t>(values >> 8 & 0xff);
+        const auto time_ns = slot.time_ns.load(std::memory_order_relaxed);
+        auto& total = totals[key];
+        total.min = total.count == 0 ? min : std::min(total.min, min);
+        total.max = total.count == 0 ? max : std::max(total.max, max);
+        if (total.count == 0 || time_ns >= last_times[key])
+        {
+            total.last = static_cast<uint8_t>(values >> 16 & 0xff);
+            last_times[key] = time_ns;
+        }
+        total.count += count;
+        total.sum += slot.sum.load(std::memory_order_relaxed);
+    }
+}
+
+TelemetryTable::Shard& TelemetryTable::add_shard()
+{
+    const std::lock_guard lock(mutex_);
+    return *shards_.emplace_back(std::make_unique<Shard>());
+}
+
+std::vector<TelemetryTable::KeyStats> TelemetryTable::snapshot() const
+{
+    // Merged in dense tables first, so every shard is walked once in the memory order.
+    auto totals = std::make_unique<std::array<KeyStats, key_count>>();
+    auto last_times = std::make_unique<std::array<uint64_t, key_count>>();
+    {
+        const std::lock_guard lock(mutex_);
+        for (const auto& shard : shards_)
+        {
+            shard->collect(*totals, *last_times);
+        }
+    }
+    std::vector<KeyStats> result;
+    for (std::size_t key = 0; key < key_count; key++)
+    {
+        if ((*totals)[key].count > 0)
+        {
+            result.push_back((*totals)[key]);
+            result.back().key = static_cast<uint16_t>(key);
+        }
+    }
+    return result;
+}
+
+void write_json(std::ostream& stream, std::span<const TelemetryTable::KeyStats> stats)
+{
+    stream << "{\"telemetry\":[";
+    for (std::size_t i = 0; i < stats.size(); i++)
+    {
+        const auto& key = stats[i];
+        stream << (i > 0 ? "," : "") << "{\"key\":" << key.key << ",\"count\":" << key.count << ",\"sum\":" << key.sum
+               << ",\"min\":" << static_cast<int>(key.min) << ",\"max\":" << static_cast<int>(key.max)
+               << ",\"last\":" << static_cast<int>(key.last) << '}';
+    }
+    stream << "]}\n";
+}
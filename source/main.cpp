@@ -1,13 +1,479 @@
+#include <algorithm>
+#include <bit>
 #include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <BinaryCommandWriter.hpp>
+#include <Capture.hpp>
 #include <CommandPrinter.hpp>
+#include <InternTable.hpp>
+#include <MappedFile.hpp>
+#include <MemoryPool.hpp>
+#include <Metrics.hpp>
+#include <OutputSink.hpp>
 #include <PacketParser.hpp>
+#include <ParallelDecoder.hpp>
+#include <ShmRingServer.hpp>
 #include <TcpServer.hpp>
+#include <Telemetry.hpp>
+#include <UdpServer.hpp>
+#include <UnixServer.hpp>
+#ifdef SERVER_WITH_IO_URING
+#include <IoUring.hpp>
+#include <UringTcpServer.hpp>
+#endif
 
 #include "Params.hpp"
 
+// Bind the calling thread to the given CPU core. Best effort - failures are reported but not fatal.
+static void pin_current_thread(unsigned int index)
+{
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpu_set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0)
+    {
+        std::cerr << "Failed to pin thread " << index << " to a CPU core\n";
+    }
+#else
+    std::cerr << "Thread pinning is not supported on this platform\n";
+#endif
+}
+
+/**
+ * Runs the event loop until it is stopped or runs out of work. A spinning loop polls for ready handlers (epoll_wait with
+ * a zero timeout) instead of sleeping in the kernel, so it takes a whole core but never pays the wake-up latency.
+ */
+static void run_event_loop(boost::asio::io_context& io_context, bool busy_spin)
+{
+    if (!busy_spin)
+    {
+        io_context.run();
+        return;
+    }
+    // poll() stops the context once it runs out of work, like run() returns.
+    while (!io_context.stopped())
+    {
+        io_context.poll();
+    }
+}
+
+// Output format of the decoded commands, the same for all the threads.
+struct OutputFormat
+{
+    bool binary = false;
+    BinaryCommandWriter::Options binary_options{};
+    // Entries of the command 1 intern table of every thread, 0 if the text is printed as is.
+    std::size_t intern_entries = 0;
+
+    // Binary blocks are handed to the output sink whole, so they are limited to the sink's block size.
+    explicit OutputFormat(const Params& params) :
+        binary{params.output_format == "binary"},
+        binary_options{.block_size = static_cast<std::size_t>(params.flush_size), .compress = params.compress_output},
+        intern_entries{static_cast<std::size_t>(params.intern)}
+    {
+    }
+};
+
+// Writes the decoded commands of a thread as text lines or as binary blocks. The parsers use the batch interface, so
+// the format is selected once per read. Command 3 telemetry is aggregated instead of written if a table is given.
+class CommandOutput
+{
+    using Format = std::variant<CommandPrinter, BinaryCommandWriter>;
+    // Command 1 ids of the text output, the threads use disjoint id ranges.
+    std::optional<InternTable> intern_table_;
+    Format format_;
+    std::optional<TelemetryAggregator> telemetry_;
+    // The commands of a batch left for the output after the telemetry is taken out.
+    std::vector<Command> output_batch_;
+
+    // The writers are not movable, so they are constructed in place.
+    static Format make_format(std::ostream& stream, const OutputFormat& format)
+    {
+        if (format.binary)
+        {
+            return Format(std::in_place_type<BinaryCommandWriter>, stream, format.binary_options);
+        }
+        return Format(std::in_place_type<CommandPrinter>, stream);
+    }
+
+public:
+    /**
+     * @param thread index of the thread, selects the range of the command 1 ids.
+     */
+    CommandOutput(std::ostream& stream, const OutputFormat& format, TelemetryTable* telemetry = nullptr,
+                  unsigned int thread = 0) :
+        format_{make_format(stream, format)}
+    {
+        if (telemetry != nullptr)
+        {
+            telemetry_.emplace(*telemetry);
+        }
+        if (auto* printer = std::get_if<CommandPrinter>(&format_); printer != nullptr && format.intern_entries > 0)
+        {
+            // Consecutive ranges of ids, so the tables of different threads never share one.
+            const auto first_id = uint64_t{thread} * format.intern_entries;
+            if (first_id > UINT32_MAX)
+            {
+                throw std::invalid_argument("Too many intern table entries for the number of threads");
+            }
+            intern_table_.emplace(InternTable::Options{
+                .max_entries = format.intern_entries,
+                .first_id = static_cast<uint32_t>(first_id),
+            });
+            printer->set_intern_table(&*intern_table_);
+        }
+    }
+
+    CommandOutput(const CommandOutput&) = delete;
+    CommandOutput& operator=(const CommandOutput&) = delete;
+
+    void handle_batch(std::span<const Command> batch)
+    {
+        if (telemetry_)
+        {
+            telemetry_->handle_batch(batch);
+            output_batch_.clear();
+            std::copy_if(batch.begin(), batch.end(), std::back_inserter(output_batch_),
+                         [](const Command& command) { return !std::holds_alternative<Command3>(command); });
+            if (output_batch_.empty())
+            {
+                return;
+            }
+            batch = output_batch_;
+        }
+        std::visit([batch](auto& active) { active.handle_batch(batch); }, format_);
+    }
+
+    // Writes out the collected binary block. Text is written right away.
+    void flush()
+    {
+        if (auto* writer = std::get_if<BinaryCommandWriter>(&format_))
+        {
+            writer->flush();
+        }
+    }
+};
+
+// Creates a parser for every new connection of an event loop. Parsers of closed connections leave their memory in the
+// pool for the next ones. The received data is recorded before parsing if a capture writer is given.
+struct ParserFactory
+{
+    CommandOutput& commands;
+    CaptureWriter* capture = nullptr;
+    // true if the parsers should answer every packet with an ACK or NAK frame.
+    bool responses = false;
+    ObjectPool<CapturingHandler<PacketParser<CommandOutput>>> parsers{};
+
+    auto operator()()
+    {
+        auto parser = parsers.make(capture, commands);
+        parser->handler().enable_responses(responses);
+        return parser;
+    }
+
+    // @return the number of parsers in use, i.e. of the open connections.
+    [[nodiscard]] std::size_t live() const { return parsers.memory().block_count() - parsers.memory().free_count(); }
+};
+
+// Connections are served through epoll by default or through io_uring if requested and supported.
+#ifdef SERVER_WITH_IO_URING
+using Server = std::variant<tcp_server::TcpServer<ParserFactory>, tcp_server::UringTcpServer<ParserFactory>>;
+#else
+using Server = std::variant<tcp_server::TcpServer<ParserFactory>>;
+#endif
+
+#ifdef SERVER_WITH_IO_URING
+/**
+ * The io_uring receive buffers are always shared by the connections of a server and filled up to their size, so they
+ * are of the largest receive buffer size. There are as many as fit the memory of the default io_uring settings.
+ */
+static tcp_server::UringOptions uring_options(const tcp_server::ReceiveOptions& receive_options)
+{
+    const auto defaults = tcp_server::UringOptions{};
+    const auto count = defaults.buffer_count * defaults.buffer_size / receive_options.max_buffer_size;
+    return {
+        .buffer_count = static_cast<unsigned>(std::bit_floor(std::clamp<std::size_t>(count, 16, 32768))),
+        .buffer_size = receive_options.max_buffer_size,
+        .socket = receive_options.socket,
+    };
+}
+#endif
+
+// Tells whether io_uring can be used, explaining why not if it was requested.
+static bool use_io_uring(const Params& params)
+{
+    if (!params.io_uring)
+    {
+        return false;
+    }
+    if (params.responses)
+    {
+        std::cerr << "The io_uring backend does not send responses, using epoll\n";
+        return false;
+    }
+    if (params.measure_latency)
+    {
+        std::cerr << "The io_uring backend does not measure the receive latency, using epoll\n";
+        return false;
+    }
+#ifdef SERVER_WITH_IO_URING
+    if (IoUring::multishot_recv_supported())
+    {
+        return true;
+    }
+    std::cerr << "io_uring multishot receive is not supported by the kernel, using epoll\n";
+#else
+    std::cerr << "The server was built without io_uring support, using epoll\n";
+#endif
+    return false;
+}
+
+// Everything owned by a single event loop thread. Only the output sink is shared with other threads.
+struct EventLoop
+{
+    boost::asio::io_context io_context{1};
+    OutputSink::Buffer output_buffer;
+    std::ostream output{&output_buffer};
+    CommandOutput commands;
+    std::unique_ptr<CaptureWriter> capture;
+    ParserFactory factory;
+    // Shared memory rings are one way, so their parsers never make responses.
+    ParserFactory ring_factory{commands, capture.get()};
+    Server server;
+    std::optional<tcp_server::UdpServer<CommandOutput>> udp;
+    std::optional<tcp_server::UnixServer<ParserFactory>> unix_server;
+    std::optional<tcp_server::ShmRingServer<ParserFactory>> shm_server;
+    boost::asio::steady_timer flush_timer{io_context};
+    const std::chrono::milliseconds flush_interval;
+    bool stopping = false;
+
+    EventLoop(OutputSink& sink, const OutputFormat& format, std::chrono::milliseconds flush_interval,
+              tcp_server::ip::port_type port, bool share_port, const tcp_server::ReceiveOptions& receive_options,
+              bool io_uring, bool responses, CaptureFile* capture_file, TelemetryTable* telemetry,
+              unsigned int index) :
+        output_buffer{sink}, commands{output, format, telemetry, index},
+        capture{capture_file != nullptr ? std::make_unique<CaptureWriter>(*capture_file) : nullptr},
+        factory{commands, capture.get(), responses}, server{make_server(port, share_port, receive_options, io_uring)},
+        flush_interval{flush_interval}
+    {
+        schedule_flush();
+    }
+
+    // The servers are neither copyable nor movable, so they are constructed in place.
+    Server make_server(tcp_server::ip::port_type port, bool share_port,
+                       const tcp_server::ReceiveOptions& receive_options, [[maybe_unused]] bool io_uring)
+    {
+#ifdef SERVER_WITH_IO_URING
+        if (io_uring)
+        {
+            return Server(std::in_place_type<tcp_server::UringTcpServer<ParserFactory>>, io_context, factory, port,
+                          share_port, uring_options(receive_options));
+        }
+#endif
+        return Server(std::in_place_type<tcp_server::TcpServer<ParserFactory>>, io_context, factory, port, share_port,
+                      receive_options);
+    }
+
+    [[nodiscard]] tcp_server::ip::port_type port() const
+    {
+        return std::visit([](const auto& active) { return active.port(); }, server);
+    }
+
+    // Also receive the packets as datagrams. The commands go to the same output as the ones of the connections.
+    void listen_udp(tcp_server::ip::port_type port, bool share_port, const tcp_server::UdpOptions& options)
+    {
+        udp.emplace(io_context, commands, port, share_port, options);
+    }
+
+    // Also accept local connections on the unix socket, either creating it or sharing the socket of the first loop.
+    void listen_unix(const std::string& path, EventLoop* first, const tcp_server::ReceiveOptions& receive_options)
+    {
+        if (first == nullptr)
+        {
+            unix_server.emplace(io_context, factory, path, receive_options);
+        }
+        else
+        {
+            unix_server.emplace(io_context, factory, *first->unix_server, receive_options);
+        }
+    }
+
+    // Also accept shared memory rings, either creating the socket or sharing the socket of the first loop.
+    void listen_shm(const std::string& path, EventLoop* first)
+    {
+        if (first == nullptr)
+        {
+            shm_server.emplace(io_context, ring_factory, path);
+        }
+        else
+        {
+            shm_server.emplace(io_context, ring_factory, *first->shm_server);
+        }
+    }
+
+    // Writes the datagram source statistics of this thread as a JSON line. Must be called on the loop's thread.
+    void write_udp_stats(std::ostream& stream) const
+    {
+        if (udp)
+        {
+            // Formatted first, so the lines of different threads are not interleaved.
+            std::ostringstream line;
+            tcp_server::write_json(line, udp->sources());
+            stream << line.str() << std::flush;
+        }
+    }
+
+    // Periodically hand the partially filled output block over to the writer thread and write out the capture.
+    void schedule_flush()
+    {
+        flush_timer.expires_after(flush_interval);
+        flush_timer.async_wait(
+            [this](const boost::system::error_code& ec)
+            {
+                if (!ec)
+                {
+                    commands.flush();
+                    output.flush();
+                    if (capture)
+                    {
+                        capture->flush();
+                    }
+                    if (!stopping || live_sessions())
+                    {
+                        schedule_flush();
+                    }
+                }
+            });
+    }
+
+    [[nodiscard]] bool live_sessions() const { return factory.live() + ring_factory.live() > 0; }
+
+    // Stop accepting connections. The connections that are still active are served until they are closed, and their
+    // output is flushed periodically as before. The timer stops with the last one, otherwise the event loop never
+    // runs out of work.
+    void stop()
+    {
+        stopping = true;
+        std::visit([](auto& active) { active.stop(); }, server);
+        if (udp)
+        {
+            udp->stop();
+        }
+        if (unix_server)
+        {
+            unix_server->stop();
+        }
+        if (shm_server)
+        {
+            shm_server->stop();
+        }
+        if (!live_sessions())
+        {
+            flush_timer.cancel();
+        }
+        commands.flush();
+        output.flush();
+    }
+};
+
+/**
+ * Decodes a capture file to the output without any sockets: every recorded read is passed to the parser of its
+ * session, as the server did when receiving it. Runs as fast as possible unless the original timing is requested.
+ * Reads of different event loop threads are written out in per-thread blocks, so across threads the original order
+ * and timing are only approximated.
+ */
+static void replay(const Params& params, OutputSink& sink, TelemetryTable* telemetry)
+{
+    CaptureReader reader(params.replay);
+    OutputSink::Buffer output_buffer{sink};
+    std::ostream output{&output_buffer};
+    CommandOutput commands{output, OutputFormat(params), telemetry};
+    std::unordered_map<uint32_t, std::unique_ptr<PacketParser<CommandOutput>>> parsers;
+    uint64_t reads = 0;
+    uint64_t bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    std::optional<uint64_t> first_time;
+    while (const auto record = reader.next())
+    {
+        if (params.replay_timing)
+        {
+            first_time = first_time.value_or(record->time_ns);
+            const auto due = start + std::chrono::nanoseconds(record->time_ns - std::min(*first_time, record->time_ns));
+            if (std::chrono::steady_clock::now() < due)
+            {
+                // Do not hold the decoded output back while waiting.
+                commands.flush();
+                output.flush();
+                std::this_thread::sleep_until(due);
+            }
+        }
+        auto& parser = parsers[record->session];
+        if (!parser)
+        {
+            parser = std::make_unique<PacketParser<CommandOutput>>(commands);
+        }
+        (*parser)(record->data);
+        reads++;
+        bytes += record->data.size();
+    }
+    commands.flush();
+    output.flush();
+
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Replayed " << reads << " reads, " << bytes << " bytes of " << parsers.size() << " sessions in "
+              << seconds << " s (" << static_cast<double>(bytes) / 1e6 / std::max(seconds, 1e-9) << " MB/s)\n";
+    if (reader.truncated())
+    {
+        std::cerr << "The capture ends with an incomplete record\n";
+    }
+}
+
+/**
+ * Decodes a file of raw client data to the output. The file is mapped into memory and decoded in chunks on all the
+ * threads, the commands are written in the stream order by the calling thread.
+ */
+static void decode(const Params& params, OutputSink& sink, TelemetryTable* telemetry)
+{
+    const MappedFile file(params.decode);
+    OutputSink::Buffer output_buffer{sink};
+    std::ostream output{&output_buffer};
+    CommandOutput commands{output, OutputFormat(params), telemetry};
+    ParallelDecoder<CommandOutput> decoder(commands, {.threads = static_cast<std::size_t>(params.threads)});
+    const auto start = std::chrono::steady_clock::now();
+    decoder(file.data());
+    commands.flush();
+    output.flush();
+
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const auto bytes = static_cast<double>(file.data().size());
+    std::cerr << "Decoded " << decoder.packets() << " packets from " << file.data().size() << " bytes in " << seconds
+              << " s (" << bytes / 1e6 / std::max(seconds, 1e-9) << " MB/s)\n";
+}
+
 int main(int argc, char* argv[])
 {
     try
@@ -19,25 +485,237 @@ int main(int argc, char* argv[])
             return params.invalid ? 1 : 0;
         }
 
-        boost::asio::io_context io_context;
+        // Decoded commands of all threads are written to stdout by a single writer thread.
+        const auto sink_options = OutputSink::Options{
+            .flush_size = static_cast<std::size_t>(params.flush_size),
+            .block_count = static_cast<std::size_t>(params.output_blocks),
+            .overflow_policy =
+                params.drop_output ? OutputSink::OverflowPolicy::drop : OutputSink::OverflowPolicy::block,
+        };
+        OutputSink sink(STDOUT_FILENO, sink_options);
+        // Command 3 telemetry of all the threads, written to stderr on request, periodically and on exit.
+        std::optional<TelemetryTable> telemetry;
+        if (params.telemetry)
+        {
+            telemetry.emplace();
+        }
+        auto write_telemetry = [&telemetry]
+        {
+            if (telemetry)
+            {
+                write_json(std::cerr, telemetry->snapshot());
+            }
+        };
+        if (!params.replay.empty())
+        {
+            replay(params, sink, telemetry ? &*telemetry : nullptr);
+            write_telemetry();
+            return 0;
+        }
+        if (!params.decode.empty())
+        {
+            decode(params, sink, telemetry ? &*telemetry : nullptr);
+            write_telemetry();
+            return 0;
+        }
+
+        // One single threaded io_context and one tcp server -> packet parser factory -> command output chain per
+        // thread. The servers listen on the same port and the kernel distributes the incoming connections between them.
+        const auto thread_count = static_cast<unsigned int>(params.threads);
+        const auto flush_interval = std::chrono::milliseconds(params.flush_interval);
+        const auto receive_options = tcp_server::ReceiveOptions{
+            .min_buffer_size = static_cast<std::size_t>(params.receive_buffer_min),
+            .max_buffer_size = static_cast<std::size_t>(params.receive_buffer_max),
+            .shared_buffer = params.shared_receive_buffer,
+            .max_pending_responses = static_cast<std::size_t>(params.response_queue),
+            .socket =
+                {
+                    .no_delay = params.tcp_nodelay,
+                    .quick_ack = params.tcp_quickack,
+                    .receive_buffer = params.socket_receive_buffer,
+                    .busy_poll_us = params.busy_poll,
+                    .receive_timestamps = params.measure_latency,
+                },
+        };
+        const bool io_uring = use_io_uring(params);
+        if (params.measure_latency && !metrics::enabled)
+        {
+            std::cerr << "The server was built without metrics, the receive latency is not recorded\n";
+        }
+        const auto output_format = OutputFormat(params);
+        // All the threads append to the same capture file.
+        std::optional<CaptureFile> capture_file;
+        if (!params.capture.empty())
+        {
+            capture_file.emplace(params.capture);
+        }
+        std::vector<std::unique_ptr<EventLoop>> loops;
+        for (unsigned int i = 0; i < thread_count; i++)
+        {
+            // The first server picks the port if none was requested, the rest join it.
+            const auto port = loops.empty() ? params.port : loops.front()->port();
+            loops.push_back(std::make_unique<EventLoop>(sink, output_format, flush_interval, port, thread_count > 1,
+                                                        receive_options, io_uring, params.responses,
+                                                        capture_file ? &*capture_file : nullptr,
+                                                        telemetry ? &*telemetry : nullptr, i));
+        }
 
-        // create tcp server -> packet parser factory -> command printer chain.
-        auto printer = CommandPrinter(std::cout);
-        auto factory = [&printer] { return std::make_unique<PacketParser<CommandPrinter>>(printer); };
-        auto server = tcp_server::TcpServer<decltype(factory), 256>(io_context, factory, params.port);
+        if (params.udp_port >= 0)
+        {
+            const auto udp_options = tcp_server::UdpOptions{
+                .batch_size = static_cast<std::size_t>(params.udp_batch),
+                .gro = params.udp_gro,
+            };
+            for (const auto& loop : loops)
+            {
+                const auto port = loop == loops.front() ? params.udp_port : loops.front()->udp->port();
+                loop->listen_udp(static_cast<tcp_server::ip::port_type>(port), thread_count > 1, udp_options);
+            }
+        }
 
-        if (server.port() != params.port)
+        for (const auto& loop : loops)
+        {
+            auto* first = loop == loops.front() ? nullptr : loops.front().get();
+            if (!params.unix_socket.empty())
+            {
+                loop->listen_unix(params.unix_socket, first, receive_options);
+            }
+            if (!params.shm_socket.empty())
+            {
+                loop->listen_shm(params.shm_socket, first);
+            }
+        }
+
+        if (loops.front()->port() != params.port)
         {
             // need to tell which port we are using, but stdout is reserved for the data output, so use stderr.
-            std::cerr << "Server listening on port " << server.port() << '\n';
+            std::cerr << "Server listening on port " << loops.front()->port() << '\n';
+        }
+        if (params.udp_port == 0)
+        {
+            std::cerr << "Server listening on UDP port " << loops.front()->udp->port() << '\n';
         }
 
-        // wait for ctrl-c or sigterm to stop the server.
-        boost::asio::signal_set signals(io_context, SIGINT, SIGTERM);
-        signals.async_wait([&server](const boost::system::error_code&, int) { server.stop(); });
+        // kill -USR1 prints the metrics of all the threads as a JSON line to stderr, followed by the telemetry line if
+        // enabled and a line of datagram source statistics per thread if UDP is enabled.
+        boost::asio::signal_set stats_signal(loops.front()->io_context, SIGUSR1);
+        std::function<void(const boost::system::error_code&, int)> dump_stats =
+            [&loops, &stats_signal, &dump_stats, &write_telemetry](const boost::system::error_code& ec, int)
+        {
+            if (ec)
+            {
+                return;
+            }
+            if constexpr (metrics::enabled)
+            {
+                metrics::write_json(std::cerr, metrics::collect());
+            }
+            else
+            {
+                std::cerr << "The server was built without metrics\n";
+            }
+            write_telemetry();
+            for (const auto& loop : loops)
+            {
+                boost::asio::post(loop->io_context, [&loop = *loop] { loop.write_udp_stats(std::cerr); });
+            }
+            stats_signal.async_wait(dump_stats);
+        };
+        stats_signal.async_wait(dump_stats);
 
-        // begin asio event loop.
-        io_context.run();
+        // The telemetry is also written every --telemetry-interval milliseconds if requested.
+        boost::asio::steady_timer telemetry_timer(loops.front()->io_context);
+        std::function<void(const boost::system::error_code&)> dump_telemetry =
+            [&params, &telemetry_timer, &dump_telemetry, &write_telemetry](const boost::system::error_code& ec)
+        {
+            if (ec)
+            {
+                return;
+            }
+            write_telemetry();
+            telemetry_timer.expires_after(std::chrono::milliseconds(params.telemetry_interval));
+            telemetry_timer.async_wait(dump_telemetry);
+        };
+        if (telemetry && params.telemetry_interval > 0)
+        {
+            telemetry_timer.expires_after(std::chrono::milliseconds(params.telemetry_interval));
+            telemetry_timer.async_wait(dump_telemetry);
+        }
+
+        // wait for ctrl-c or sigterm to stop the servers, each one in its own thread.
+        boost::asio::signal_set signals(loops.front()->io_context, SIGINT, SIGTERM);
+        signals.async_wait(
+            [&loops, &stats_signal, &telemetry_timer](const boost::system::error_code&, int)
+            {
+                stats_signal.cancel();
+                telemetry_timer.cancel();
+                for (const auto& loop : loops)
+                {
+                    boost::asio::post(loop->io_context, [&loop = *loop] { loop.stop(); });
+                }
+            });
+
+        // A failure in any thread stops all the event loops and is reported by the main thread.
+        std::exception_ptr worker_exception;
+        std::once_flag worker_failed;
+        auto stop_all = [&loops]
+        {
+            for (const auto& loop : loops)
+            {
+                loop->io_context.stop();
+            }
+        };
+
+        // begin asio event loops. The first one runs on the main thread.
+        std::vector<std::jthread> workers;
+        for (unsigned int i = 1; i < thread_count; i++)
+        {
+            workers.emplace_back(
+                [&, i]
+                {
+                    if (params.pin_threads)
+                    {
+                        pin_current_thread(i);
+                    }
+                    try
+                    {
+                        run_event_loop(loops[i]->io_context, params.busy_spin);
+                    }
+                    catch (...)
+                    {
+                        std::call_once(worker_failed, [&] { worker_exception = std::current_exception(); });
+                        stop_all();
+                    }
+                });
+        }
+        if (params.pin_threads)
+        {
+            pin_current_thread(0);
+        }
+        try
+        {
+            run_event_loop(loops.front()->io_context, params.busy_spin);
+        }
+        catch (...)
+        {
+            stop_all();
+            throw;
+        }
+        workers.clear(); // join
+        if (worker_exception)
+        {
+            std::rethrow_exception(worker_exception);
+        }
+        loops.clear(); // hand the remaining output to the sink
+        write_telemetry();
+        if (params.measure_latency && metrics::enabled)
+        {
+            metrics::write_json(std::cerr, metrics::collect());
+        }
+        if (sink.dropped_bytes() > 0)
+        {
+            std::cerr << "Dropped " << sink.dropped_bytes() << " bytes of output\n";
+        }
     }
     catch (const std::exception& e)
     {
@@ -0,0 +1,62 @@
+#include <BinaryCommandReader.hpp>
+#include <BinaryCommandWriter.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <variant>
+
+using namespace std::string_literals;
+
+TEST_CASE("BinaryCommandReader")
+{
+    auto binary = std::ostringstream{};
+    {
+        auto writer = BinaryCommandWriter{binary, {}};
+        writer.handle_command_1("abc"s);
+        writer.handle_command_3(0x1234, 0x56);
+        writer.handle_command_1(""s);
+        writer.handle_command_2(0x78);
+    }
+    const auto block = binary.str();
+
+    SECTION("Records in the original order")
+    {
+        auto input = std::istringstream{block + block};
+        auto reader = BinaryCommandReader{input};
+        for (int i = 0; i < 2; i++)
+        {
+            const auto commands = reader.next();
+            REQUIRE(commands.size() == 4);
+            CHECK(std::get<Command1>(commands[0]).data_1 == "abc");
+            CHECK(std::get<Command3>(commands[1]).data_3_1 == 0x1234);
+            CHECK(std::get<Command3>(commands[1]).data_3_2 == 0x56);
+            CHECK(std::get<Command1>(commands[2]).data_1.empty());
+            CHECK(std::get<Command2>(commands[3]).data_2 == 0x78);
+        }
+        CHECK(reader.next().empty());
+    }
+
+    SECTION("Corrupt blocks")
+    {
+        auto check_corrupt = [](const std::string& data)
+        {
+            auto input = std::istringstream{data};
+            auto reader = BinaryCommandReader{input};
+            CHECK_THROWS_AS(reader.next(), std::runtime_error);
+        };
+        check_corrupt("XXXX"s + block.substr(4));
+        check_corrupt(block.substr(0, 10));
+        check_corrupt(block.substr(0, block.size() - 1));
+        auto unknown_kind = block;
+        unknown_kind[16 + 4] = 7;
+        check_corrupt(unknown_kind);
+        auto long_data = block;
+        long_data[16 + 4 + 4] = 100;
+        check_corrupt(long_data);
+        // Sizes of a corrupt header must not allocate gigabytes.
+        auto huge_block = block;
+        huge_block[11] = '\x7f';
+        check_corrupt(huge_block);
+    }
+}
@@ -0,0 +1,142 @@
+#include <BinaryCommandReader.hpp>
+#include <BinaryCommandWriter.hpp>
+#include <CommandPrinter.hpp>
+#include <OutputSink.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std::string_literals;
+
+// Converts binary output to the text format.
+static std::string to_text(const std::string& binary, std::size_t* blocks = nullptr)
+{
+    auto input = std::istringstream{binary};
+    auto reader = BinaryCommandReader{input};
+    auto output = std::ostringstream{};
+    const auto printer = CommandPrinter{output};
+    for (auto commands = reader.next(); !commands.empty(); commands = reader.next())
+    {
+        printer.handle_batch(commands);
+        if (blocks != nullptr)
+        {
+            ++*blocks;
+        }
+    }
+    return output.str();
+}
+
+// Passes the same commands to both handlers.
+template <typename Handler>
+static void write_commands(Handler& handler, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        handler.handle_command_1(std::string(static_cast<std::size_t>(i % 256), static_cast<char>(i)));
+        handler.handle_command_2(static_cast<uint8_t>(i));
+        handler.handle_command_3(static_cast<uint16_t>(i * 257), static_cast<uint8_t>(i >> 3));
+    }
+    const auto batch = std::vector<Command>{Command2{0xab}, Command1{"batch"}, Command3{0x1234, 0x56}};
+    handler.handle_batch(batch);
+}
+
+TEST_CASE("BinaryCommandWriter")
+{
+    auto expected = std::ostringstream{};
+    auto printer = CommandPrinter{expected};
+    write_commands(printer, 1000);
+
+    SECTION("Round trip to the text format")
+    {
+        auto binary = std::ostringstream{};
+        {
+            auto writer = BinaryCommandWriter{binary, {.block_size = 4096}};
+            write_commands(writer, 1000);
+        }
+        std::size_t blocks = 0;
+        CHECK(to_text(binary.str(), &blocks) == expected.str());
+        CHECK(blocks > 10);
+        // Mostly long command 1 strings here, which take the same space in both formats.
+        CHECK(binary.str().size() < expected.str().size());
+    }
+
+    SECTION("Flush writes a block")
+    {
+        auto binary = std::ostringstream{};
+        auto writer = BinaryCommandWriter{binary, {}};
+        writer.handle_command_2(1);
+        CHECK(binary.str().empty());
+        writer.flush();
+        CHECK(to_text(binary.str()) == "0x0002 0x1\n"s);
+        writer.flush();
+        CHECK(to_text(binary.str()) == "0x0002 0x1\n"s);
+    }
+
+    SECTION("Compression")
+    {
+        if constexpr (binary_format::compression_supported)
+        {
+            auto plain = std::ostringstream{};
+            auto compressed = std::ostringstream{};
+            {
+                auto plain_writer = BinaryCommandWriter{plain, {}};
+                auto compressed_writer = BinaryCommandWriter{compressed, {.compress = true}};
+                write_commands(plain_writer, 1000);
+                write_commands(compressed_writer, 1000);
+            }
+            CHECK(to_text(compressed.str()) == expected.str());
+            CHECK(compressed.str().size() < plain.str().size() / 2);
+        }
+        else
+        {
+            auto binary = std::ostringstream{};
+            CHECK_THROWS_AS((BinaryCommandWriter{binary, {.compress = true}}), std::invalid_argument);
+        }
+    }
+
+    SECTION("Blocks of several threads through an output sink")
+    {
+        // Binary data is full of line breaks, the blocks must still be handed over whole.
+        constexpr int thread_count = 4;
+        std::FILE* file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        {
+            auto sink = OutputSink{fileno(file), {.flush_size = 1024, .block_count = 4}};
+            std::vector<std::jthread> threads;
+            for (int t = 0; t < thread_count; t++)
+            {
+                threads.emplace_back(
+                    [&sink]
+                    {
+                        auto buffer = OutputSink::Buffer{sink};
+                        auto stream = std::ostream{&buffer};
+                        auto writer = BinaryCommandWriter{stream, {.block_size = 1024}};
+                        write_commands(writer, 1000);
+                    });
+            }
+        }
+        std::string binary;
+        std::rewind(file);
+        char chunk[4096];
+        std::size_t length = 0;
+        while ((length = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+        {
+            binary.append(chunk, length);
+        }
+        std::fclose(file);
+        CHECK(to_text(binary).size() == thread_count * expected.str().size());
+    }
+
+    SECTION("Invalid options")
+    {
+        auto binary = std::ostringstream{};
+        CHECK_THROWS_AS((BinaryCommandWriter{binary, {.block_size = 100}}), std::invalid_argument);
+        CHECK_THROWS_AS((BinaryCommandWriter{binary, {.block_size = binary_format::max_block_size + 1}}),
+                        std::invalid_argument);
+    }
+}
@@ -0,0 +1,68 @@
+#include <BoundedQueue.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+TEST_CASE("BoundedQueue")
+{
+    SECTION("Full and empty")
+    {
+        auto queue = BoundedQueue<int>{3}; // rounded up to 4
+        int value = 0;
+        CHECK_FALSE(queue.try_pop(value));
+        for (int i = 0; i < 4; i++)
+        {
+            CHECK(queue.try_push(i));
+        }
+        CHECK_FALSE(queue.try_push(4));
+        for (int i = 0; i < 4; i++)
+        {
+            CHECK(queue.try_pop(value));
+            CHECK(value == i);
+        }
+        CHECK_FALSE(queue.try_pop(value));
+    }
+
+    SECTION("Multiple producers and consumers")
+    {
+        constexpr int thread_count = 4;
+        constexpr uint64_t per_thread = 100000;
+        auto queue = BoundedQueue<uint64_t>{64};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> popped{0};
+        {
+            std::vector<std::jthread> threads;
+            for (int t = 0; t < thread_count; t++)
+            {
+                threads.emplace_back(
+                    [&queue]
+                    {
+                        for (uint64_t i = 1; i <= per_thread; i++)
+                        {
+                            while (!queue.try_push(i))
+                            {
+                                std::this_thread::yield();
+                            }
+                        }
+                    });
+                threads.emplace_back(
+                    [&]
+                    {
+                        uint64_t value = 0;
+                        while (popped.load() < thread_count * per_thread)
+                        {
+                            if (queue.try_pop(value))
+                            {
+                                sum += value;
+                                popped++;
+                            }
+                        }
+                    });
+            }
+        }
+        CHECK(popped == thread_count * per_thread);
+        CHECK(sum == thread_count * per_thread * (per_thread + 1) / 2);
+    }
+}
@@ -0,0 +1,142 @@
+#include <Capture.hpp>
+#include <CommandHandlerStub.hpp>
+#include <PacketParser.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std::string_literals;
+
+// A capture file path that is removed at the end of the test.
+struct TemporaryPath
+{
+    std::string path =
+        (std::filesystem::temp_directory_path() / ("capture_test_" + std::to_string(::getpid()))).string();
+
+    TemporaryPath() { std::filesystem::remove(path); }
+    ~TemporaryPath() { std::filesystem::remove(path); }
+};
+
+// Reads all the records of the file as session id and data pairs.
+static std::vector<std::pair<uint32_t, std::string>> read_records(const std::string& path)
+{
+    CaptureReader reader(path);
+    std::vector<std::pair<uint32_t, std::string>> result;
+    while (const auto record = reader.next())
+    {
+        result.emplace_back(record->session, std::string(record->data.begin(), record->data.end()));
+    }
+    return result;
+}
+
+using records = std::vector<std::pair<uint32_t, std::string>>;
+
+TEST_CASE("Capture")
+{
+    const auto temporary = TemporaryPath{};
+    const auto& path = temporary.path;
+
+    SECTION("Records keep the read boundaries, sessions and order")
+    {
+        {
+            auto file = CaptureFile{path};
+            // A tiny buffer, so some of the records are written when the buffer fills and the rest on destruction.
+            auto writer = CaptureWriter{file, 40};
+            writer.record(7, "first"s);
+            writer.record(8, ""s);
+            writer.record(7, std::string(100, 'x'));
+            writer.record(8, "\x00\xff"s);
+        }
+        CHECK(read_records(path) == records{{7, "first"}, {8, ""}, {7, std::string(100, 'x')}, {8, "\x00\xff"s}});
+
+        CaptureReader reader(path);
+        const auto first = reader.next();
+        const auto second = reader.next();
+        REQUIRE((first && second));
+        CHECK(first->time_ns <= second->time_ns);
+        while (reader.next())
+        {
+        }
+        CHECK(!reader.truncated());
+    }
+
+    SECTION("Existing captures are replaced")
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            auto file = CaptureFile{path};
+            auto writer = CaptureWriter{file};
+            writer.record(file.open_session(), std::to_string(i));
+        }
+        CHECK(read_records(path) == records{{0, "1"}});
+    }
+
+    SECTION("Incomplete records at the end are not returned")
+    {
+        {
+            auto file = CaptureFile{path};
+            auto writer = CaptureWriter{file};
+            writer.record(1, "complete"s);
+            writer.record(2, "incomplete"s);
+        }
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+
+        CaptureReader reader(path);
+        REQUIRE(reader.next());
+        CHECK(!reader.next());
+        CHECK(reader.truncated());
+    }
+
+    SECTION("Invalid files")
+    {
+        CHECK_THROWS(CaptureReader(path));
+        std::ofstream(path) << "not a capture file";
+        CHECK_THROWS_AS(CaptureReader(path), std::runtime_error);
+    }
+
+    SECTION("Capturing handler")
+    {
+        const auto packet = "CMD\x00\x02\x12\x6d\x81"s;
+        auto stub = CommandHandlerStub{};
+        {
+            auto file = CaptureFile{path};
+            auto writer = CaptureWriter{file};
+            auto first = CapturingHandler<PacketParser<CommandHandlerStub>>{&writer, stub};
+            auto second = CapturingHandler<PacketParser<CommandHandlerStub>>{&writer, stub};
+            auto unrecorded = CapturingHandler<PacketParser<CommandHandlerStub>>{nullptr, stub};
+            first(std::span(packet).first(4));
+            second(packet);
+            first(std::span(packet).subspan(4));
+            unrecorded(packet);
+        }
+        CHECK(stub.call_sequence == std::vector<int>{2, 2, 2});
+
+        // Replaying the records through the parsers of their sessions gives the same commands.
+        const auto captured = read_records(path);
+        REQUIRE(captured.size() == 3);
+        CHECK(captured[0].first == captured[2].first);
+        CHECK(captured[0].first != captured[1].first);
+        CHECK(captured[0].second + captured[2].second == packet);
+
+        auto replayed = CommandHandlerStub{};
+        auto parsers = std::map<uint32_t, std::unique_ptr<PacketParser<CommandHandlerStub>>>{};
+        for (const auto& [session, data] : captured)
+        {
+            auto& parser = parsers[session];
+            if (!parser)
+            {
+                parser = std::make_unique<PacketParser<CommandHandlerStub>>(replayed);
+            }
+            (*parser)(data);
+        }
+        CHECK(replayed.call_sequence == std::vector<int>{2, 2});
+    }
+}
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <string>
 #include <sstream>
+#include <vector>
 
 using namespace std::string_literals;
 
@@ -67,4 +68,28 @@ TEST_CASE("CommandPrinter")
         CHECK(output.str() == "0x0003 0xffff 0xff\n"s);
         output.str("");
     }
+
+    SECTION("Batch")
+    {
+        const auto batch =
+            std::vector<Command>{Command1{"hello"}, Command2{0x1e}, Command3{0x0a12, 0xab}, Command1{""}};
+        printer.handle_batch(batch);
+        CHECK(output.str() == "0x0001 hello\n0x0002 0x1e\n0x0003 0xa12 0xab\n0x0001 \n"s);
+        output.str("");
+
+        printer.handle_batch({});
+        CHECK(output.str().empty());
+    }
+
+    SECTION("Interned cmd 1")
+    {
+        auto table = InternTable{{.max_entries = 2, .first_id = 10}};
+        printer.set_intern_table(&table);
+        printer.handle_command_1("hello"s);
+        printer.handle_command_1("hello"s);
+        const auto batch = std::vector<Command>{Command1{"bye"}, Command2{0x1e}, Command1{"hello"}, Command1{""}};
+        printer.handle_batch(batch);
+        // The table is full, so the empty payload takes the id of "bye", the entry not used since it was added.
+        CHECK(output.str() == "0x0001 #10 hello\n0x0001 #10\n0x0001 #11 bye\n0x0002 0x1e\n0x0001 #10\n0x0001 #11 \n"s);
+    }
 }
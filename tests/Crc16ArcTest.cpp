@@ -0,0 +1,77 @@
+#include <Crc16Arc.hpp>
+#include <algorithm>
+#include <boost/crc.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <string>
+
+using namespace std::string_literals;
+
+// Bit by bit reference implementation, same as crc16_arc in scripts/test_client.py.
+static uint16_t reference_crc(const std::string &data)
+{
+    uint16_t crc = 0;
+    for (const unsigned char byte : data)
+    {
+        crc ^= byte;
+        for (int i = 0; i < 8; i++)
+        {
+            crc = crc & 1 ? (crc >> 1) ^ 0xa001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static std::string make_data(std::size_t length)
+{
+    auto data = std::string(length, '\0');
+    uint32_t state = 12345;
+    for (auto &c : data)
+    {
+        state = state * 1103515245 + 12345;
+        c = static_cast<char>(state >> 16);
+    }
+    return data;
+}
+
+TEST_CASE("Crc16Arc")
+{
+    SECTION("Check value")
+    {
+        auto crc = Crc16Arc{};
+        crc.process_bytes("123456789"s);
+        CHECK(crc.checksum() == 0xbb3d);
+        CHECK(Crc16Arc::update(0, std::span<const char>{}) == 0);
+    }
+
+    SECTION("All kernels match the reference")
+    {
+        for (std::size_t length = 0; length <= 600; length++)
+        {
+            const auto data = make_data(length);
+            const auto expected = reference_crc(data);
+            boost::crc_16_type boost_crc;
+            boost_crc.process_bytes(data.data(), data.size());
+            REQUIRE(boost_crc.checksum() == expected);
+
+            CHECK(Crc16Arc::update_table(0, data) == expected);
+            CHECK(Crc16Arc::update_clmul(0, data) == expected);
+            CHECK(Crc16Arc::update(0, data) == expected);
+        }
+    }
+
+    SECTION("Incremental updates")
+    {
+        const auto data = make_data(1000);
+        const auto expected = reference_crc(data);
+        for (std::size_t fragment = 1; fragment <= 300; fragment += 7)
+        {
+            auto crc = Crc16Arc{};
+            for (std::size_t pos = 0; pos < data.size(); pos += fragment)
+            {
+                crc.process_bytes(std::span(data).subspan(pos, std::min(fragment, data.size() - pos)));
+            }
+            CHECK(crc.checksum() == expected);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#include <HeaderScanner.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <string>
+
+using namespace std::string_literals;
+
+// Straightforward reference implementation of the HeaderScanner::find contract.
+static std::size_t reference_find(const std::string &data, const std::string &header)
+{
+    const auto pos = data.find(header);
+    if (pos != std::string::npos)
+    {
+        return pos;
+    }
+    return data.size() < header.size() ? 0 : data.size() - header.size() + 1;
+}
+
+TEST_CASE("HeaderScanner")
+{
+    const auto header = "CMD"s;
+
+    SECTION("Simple cases")
+    {
+        CHECK(HeaderScanner::find(""s, header) == 0);
+        CHECK(HeaderScanner::find("CM"s, header) == 0);
+        CHECK(HeaderScanner::find("CMD"s, header) == 0);
+        CHECK(HeaderScanner::find("xCMD"s, header) == 1);
+        CHECK(HeaderScanner::find("xxxxx"s, header) == 3);
+        CHECK(HeaderScanner::find("CMCMDCMD"s, header) == 2);
+        CHECK(HeaderScanner::find("CxD CMx CMD"s, header) == 8);
+    }
+
+    SECTION("All kernels match the reference")
+    {
+        // Noise made of header letters produces a lot of partial matches.
+        uint32_t state = 12345;
+        for (std::size_t length = 0; length <= 200; length++)
+        {
+            auto data = std::string(length, '\0');
+            for (auto &c : data)
+            {
+                state = state * 1103515245 + 12345;
+                c = "CMDx"[(state >> 16) % 4];
+            }
+            // Sweep a single header over every position of a noise without full matches.
+            auto noise = data;
+            for (std::size_t i = 2; i < noise.size(); i++)
+            {
+                if (noise.compare(i - 2, 3, header) == 0)
+                {
+                    noise[i] = 'x';
+                }
+            }
+            for (std::size_t pos = 0; pos <= length; pos++)
+            {
+                auto planted = noise;
+                planted.replace(pos, std::min<std::size_t>(3, length - pos), header, 0, length - pos);
+                const auto expected = reference_find(planted, header);
+                CHECK(HeaderScanner::find_fallback(planted, header) == expected);
+                CHECK(HeaderScanner::find_sse2(planted, header) == expected);
+                CHECK(HeaderScanner::find_avx2(planted, header) == expected);
+                CHECK(HeaderScanner::find(planted, header) == expected);
+            }
+            CHECK(HeaderScanner::find(data, header) == reference_find(data, header));
+        }
+    }
+}
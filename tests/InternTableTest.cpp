@@ -0,0 +1,83 @@
+#include <InternTable.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+using namespace std::string_literals;
+
+TEST_CASE("InternTable")
+{
+    SECTION("Same payload, same id")
+    {
+        auto table = InternTable{{.max_entries = 16, .first_id = 100}};
+        const auto first = table.intern("abc");
+        CHECK(first.added);
+        CHECK(first.id == 100);
+        CHECK(first.data == "abc");
+        const auto second = table.intern("abcd");
+        CHECK(second.added);
+        CHECK(second.id == 101);
+        const auto again = table.intern("abc");
+        CHECK(!again.added);
+        CHECK(again.id == 100);
+        CHECK(table.intern(""s).id == 102);
+        CHECK(table.intern(std::string(255, 'x')).added);
+        CHECK(table.size() == 4);
+        CHECK(table.hits() == 1);
+        CHECK(table.find(101) == "abcd");
+        CHECK(!table.find(99));
+        CHECK(!table.find(104));
+    }
+
+    SECTION("Frequently used payloads survive the eviction")
+    {
+        auto table = InternTable{{.max_entries = 4}};
+        const auto hot = table.intern("hot").id;
+        for (int i = 0; i < 100; i++)
+        {
+            CHECK(!table.intern("hot").added);
+            CHECK(table.intern("cold " + std::to_string(i)).added);
+        }
+        CHECK(table.intern("hot").id == hot);
+        CHECK(table.size() == 4);
+        CHECK(table.evictions() == 97);
+    }
+
+    SECTION("Consistent under high cardinality")
+    {
+        // Every id must always refer to the last payload it was assigned to, whatever the eviction does to the index.
+        auto table = InternTable{{.max_entries = 64}};
+        std::unordered_map<uint32_t, std::string> assigned;
+        std::mt19937 random(7);
+        for (int i = 0; i < 100000; i++)
+        {
+            // A skewed mix of a few frequent payloads and many rare ones.
+            const auto key = random() % 4 == 0 ? random() % 8 : random() % 1000;
+            const auto payload = std::string(key % 40, 'p') + std::to_string(key);
+            const auto entry = table.intern(payload);
+            REQUIRE(entry.data == payload);
+            if (entry.added)
+            {
+                assigned[entry.id] = payload;
+            }
+            REQUIRE(assigned[entry.id] == payload);
+        }
+        for (const auto& [id, payload] : assigned)
+        {
+            CHECK(table.find(id) == payload);
+            CHECK(!table.intern(payload).added);
+        }
+        CHECK(table.hits() > 20000);
+    }
+
+    SECTION("Invalid")
+    {
+        CHECK_THROWS_AS(InternTable{{.max_entries = 0}}, std::invalid_argument);
+        CHECK_THROWS_AS((InternTable{{.max_entries = 2, .first_id = UINT32_MAX}}), std::invalid_argument);
+        auto table = InternTable{{.max_entries = 2}};
+        CHECK_THROWS_AS(table.intern(std::string(256, 'x')), std::invalid_argument);
+    }
+}
@@ -0,0 +1,75 @@
+#include <LatencyHistogram.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <limits>
+
+TEST_CASE("LatencyHistogram")
+{
+    auto histogram = LatencyHistogram{};
+
+    SECTION("Empty")
+    {
+        CHECK(histogram.count() == 0);
+        CHECK(histogram.min() == 0);
+        CHECK(histogram.max() == 0);
+        CHECK(histogram.percentile(50) == 0);
+    }
+
+    SECTION("Small values are exact")
+    {
+        for (uint64_t value = 1; value <= 50; value++)
+        {
+            histogram.record(value);
+        }
+        CHECK(histogram.count() == 50);
+        CHECK(histogram.min() == 1);
+        CHECK(histogram.max() == 50);
+        CHECK(histogram.mean() == 25.5);
+        CHECK(histogram.percentile(50) == 25);
+        CHECK(histogram.percentile(90) == 45);
+        CHECK(histogram.percentile(100) == 50);
+        CHECK(histogram.percentile(0) == 1);
+    }
+
+    SECTION("Relative error of large values")
+    {
+        for (uint64_t value = 1000; value <= 1000000; value += 1000)
+        {
+            histogram.record(value);
+        }
+        const auto check = [&histogram](double percentile, uint64_t exact)
+        {
+            const auto reported = histogram.percentile(percentile);
+            CHECK(reported >= exact);
+            CHECK(reported <= exact + exact / 32);
+        };
+        check(50, 500000);
+        check(99, 990000);
+        check(99.9, 999000);
+        CHECK(histogram.percentile(100) == 1000000);
+    }
+
+    SECTION("Full range")
+    {
+        histogram.record(0);
+        histogram.record(std::numeric_limits<uint64_t>::max());
+        CHECK(histogram.percentile(50) == 0);
+        CHECK(histogram.percentile(100) == std::numeric_limits<uint64_t>::max());
+    }
+
+    SECTION("Merge")
+    {
+        auto other = LatencyHistogram{};
+        histogram.record(10);
+        other.record(20);
+        other.record(30);
+        histogram.merge(other);
+        CHECK(histogram.count() == 3);
+        CHECK(histogram.min() == 10);
+        CHECK(histogram.max() == 30);
+        CHECK(histogram.percentile(50) == 20);
+
+        histogram.reset();
+        CHECK(histogram.count() == 0);
+    }
+}
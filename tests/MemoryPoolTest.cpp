@@ -0,0 +1,106 @@
+#include <MemoryPool.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // Counts live instances to check that the pooled objects are constructed and destroyed.
+    struct Tracked
+    {
+        static inline int alive = 0;
+        std::array<uint64_t, 8> payload{};
+
+        explicit Tracked(uint64_t value)
+        {
+            payload.front() = value;
+            alive++;
+        }
+
+        ~Tracked() { alive--; }
+    };
+} // namespace
+
+TEST_CASE("MemoryPool")
+{
+    SECTION("Blocks are reused")
+    {
+        auto pool = MemoryPool{};
+        void* first = pool.allocate(24);
+        void* second = pool.allocate(24);
+        CHECK(first != second);
+        CHECK(pool.block_count() == 2);
+
+        pool.deallocate(first, 24);
+        CHECK(pool.free_count() == 1);
+        CHECK(pool.allocate(24) == first);
+        CHECK(pool.free_count() == 0);
+        CHECK(pool.block_count() == 2);
+
+        // Other sizes are not pooled.
+        void* other = pool.allocate(100);
+        CHECK(pool.block_count() == 2);
+        pool.deallocate(other, 100);
+        CHECK(pool.free_count() == 0);
+
+        pool.deallocate(first, 24);
+        pool.deallocate(second, 24);
+        CHECK(pool.free_count() == 2);
+    }
+
+    SECTION("Small blocks")
+    {
+        // Smaller than the free list link.
+        auto pool = MemoryPool{};
+        void* block = pool.allocate(1);
+        pool.deallocate(block, 1);
+        CHECK(pool.allocate(1) == block);
+        pool.deallocate(block, 1);
+    }
+
+    SECTION("Pool allocator")
+    {
+        auto pool = std::make_shared<MemoryPool>();
+        const auto* first_address = std::allocate_shared<Tracked>(PoolAllocator<Tracked>(pool), 1).get();
+        CHECK(pool->block_count() == 1);
+        CHECK(pool->free_count() == 1);
+        CHECK(Tracked::alive == 0);
+
+        // The control block and the object share the same pooled block.
+        auto object = std::allocate_shared<Tracked>(PoolAllocator<Tracked>(pool), 2);
+        CHECK(object.get() == first_address);
+        CHECK(object->payload.front() == 2);
+        CHECK(pool->block_count() == 1);
+
+        // Objects keep the pool alive.
+        pool.reset();
+        CHECK(Tracked::alive == 1);
+        object.reset();
+        CHECK(Tracked::alive == 0);
+    }
+
+    SECTION("Object pool")
+    {
+        auto pool = ObjectPool<Tracked>{};
+        std::vector<ObjectPool<Tracked>::Ptr> objects;
+        for (uint64_t i = 0; i < 10; i++)
+        {
+            objects.push_back(pool.make(i));
+        }
+        CHECK(Tracked::alive == 10);
+        CHECK(objects.back()->payload.front() == 9);
+
+        objects.clear();
+        CHECK(Tracked::alive == 0);
+        CHECK(pool.memory().free_count() == 10);
+
+        for (uint64_t i = 0; i < 10; i++)
+        {
+            objects.push_back(pool.make(i));
+        }
+        CHECK(pool.memory().block_count() == 10);
+        CHECK(pool.memory().free_count() == 0);
+    }
+}
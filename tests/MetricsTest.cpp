@@ -0,0 +1,82 @@
+#include <CommandHandlerStub.hpp>
+#include <Metrics.hpp>
+#include <PacketBuilder.hpp>
+#include <PacketParser.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std::string_literals;
+
+// Change of a counter since the snapshot was taken. Other tests record metrics too, so only differences are checked.
+static uint64_t delta(const metrics::Snapshot &before, metrics::Counter counter)
+{
+    return metrics::collect().counter(counter) - before.counter(counter);
+}
+
+TEST_CASE("Metrics")
+{
+    if constexpr (!metrics::enabled)
+    {
+        SKIP("Built without metrics");
+    }
+    const auto before = metrics::collect();
+
+    SECTION("Parser counters")
+    {
+        auto handler = CommandHandlerStub{};
+        auto parser = PacketParser<CommandHandlerStub>{handler};
+        auto broken_crc = make_packet("\x00\x02\x10"s);
+        broken_crc.back() ^= 1;
+        const auto data = "noise"s + make_packet("\x00\x01\x02hi"s) + make_packet("\x00\x02\x10"s) + broken_crc +
+                          make_packet("\x00\x03\x01\x02\x03"s) + make_packet("\x00\x07\x00"s);
+        parser(std::span(data));
+
+        CHECK(delta(before, metrics::Counter::command_1) == 1);
+        CHECK(delta(before, metrics::Counter::command_2) == 1);
+        CHECK(delta(before, metrics::Counter::command_3) == 1);
+        CHECK(delta(before, metrics::Counter::crc_failures) == 1);
+        CHECK(delta(before, metrics::Counter::unknown_command_ids) == 1);
+        CHECK(delta(before, metrics::Counter::skipped_bytes) == parser.skipped_bytes());
+    }
+
+    SECTION("Read scope")
+    {
+        auto handler = CommandHandlerStub{};
+        auto parser = PacketParser<CommandHandlerStub>{handler};
+        const auto data = make_packet("\x00\x02\x10"s) + make_packet("\x00\x02\x11"s);
+        {
+            const metrics::ReadScope scope(data.size());
+            parser(std::span(data));
+        }
+        const auto after = metrics::collect();
+        CHECK(delta(before, metrics::Counter::reads) == 1);
+        CHECK(delta(before, metrics::Counter::bytes_read) == data.size());
+        const auto &packets_per_read = after.histogram(metrics::Histogram::packets_per_read);
+        CHECK(packets_per_read.count() - before.histogram(metrics::Histogram::packets_per_read).count() == 1);
+        CHECK(packets_per_read.max() >= 2);
+        CHECK(after.histogram(metrics::Histogram::handler_time_ns).count() >
+              before.histogram(metrics::Histogram::handler_time_ns).count());
+    }
+
+    SECTION("Threads are summed")
+    {
+        std::thread([] { metrics::add(metrics::Counter::connections_opened, 3); }).join();
+        std::thread([] { metrics::add(metrics::Counter::connections_opened, 4); }).join();
+        CHECK(delta(before, metrics::Counter::connections_opened) == 7);
+    }
+
+    SECTION("JSON")
+    {
+        auto stream = std::ostringstream{};
+        metrics::write_json(stream, metrics::collect());
+        const auto json = stream.str();
+        CHECK(json.starts_with("{\"connections_opened\":"));
+        CHECK(json.find("\"connections_active\":") != std::string::npos);
+        CHECK(json.find("\"handler_time_ns\":{\"count\":") != std::string::npos);
+        CHECK(json.ends_with("}}\n"));
+    }
+}
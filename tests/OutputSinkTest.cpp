@@ -0,0 +1,108 @@
+#include <OutputSink.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <fcntl.h>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Reads everything from the file descriptor until EOF.
+static std::string read_all(int fd)
+{
+    std::string result;
+    char buffer[4096];
+    ssize_t length = 0;
+    while ((length = ::read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        result.append(buffer, length);
+    }
+    return result;
+}
+
+TEST_CASE("OutputSink")
+{
+    SECTION("Lines of several threads are not interleaved")
+    {
+        constexpr int thread_count = 4;
+        constexpr int line_count = 20000;
+        std::FILE* file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        {
+            // Tiny blocks to make every line cross block boundaries at some point.
+            auto sink = OutputSink{fileno(file), {.flush_size = 100, .block_count = 4}};
+            std::vector<std::jthread> threads;
+            for (int t = 0; t < thread_count; t++)
+            {
+                threads.emplace_back(
+                    [&sink, t]
+                    {
+                        auto buffer = OutputSink::Buffer{sink};
+                        auto stream = std::ostream{&buffer};
+                        for (int i = 0; i < line_count; i++)
+                        {
+                            stream << "thread " << t << " line " << i << '\n';
+                            if (i % 1000 == 0)
+                            {
+                                stream.flush();
+                            }
+                        }
+                    });
+            }
+        }
+        std::rewind(file);
+        auto input = std::istringstream{read_all(fileno(file))};
+        std::fclose(file);
+
+        std::vector<int> next_line(thread_count, 0);
+        std::string word_thread, word_line;
+        int t = 0, i = 0;
+        while (input >> word_thread >> t >> word_line >> i)
+        {
+            REQUIRE(word_thread == "thread");
+            REQUIRE(word_line == "line");
+            REQUIRE(t >= 0);
+            REQUIRE(t < thread_count);
+            REQUIRE(i == next_line[t]);
+            next_line[t]++;
+        }
+        CHECK(next_line == std::vector<int>(thread_count, line_count));
+    }
+
+    SECTION("Drop policy")
+    {
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        std::string line(99, 'x');
+        line += '\n';
+        constexpr int line_count = 10000;
+        std::string output;
+        {
+            std::jthread reader;
+            {
+                auto sink = OutputSink{fds[1], {.flush_size = 1000, .block_count = 2,
+                                                .overflow_policy = OutputSink::OverflowPolicy::drop}};
+                {
+                    // Nobody reads the pipe yet, so the writer gets stuck and the output is dropped instead of
+                    // blocking.
+                    auto buffer = OutputSink::Buffer{sink};
+                    auto stream = std::ostream{&buffer};
+                    for (int i = 0; i < line_count; i++)
+                    {
+                        stream << line;
+                    }
+                }
+                CHECK(sink.dropped_bytes() > 0);
+                // Let the writer finish.
+                reader = std::jthread([&output, fd = fds[0]] { output = read_all(fd); });
+            }
+            ::close(fds[1]);
+        }
+        ::close(fds[0]);
+        CHECK(!output.empty());
+        CHECK(output.size() < line.size() * line_count);
+        CHECK(output.size() % line.size() == 0);
+    }
+}
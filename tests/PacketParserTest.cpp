@@ -1,23 +1,66 @@
 #include <CommandHandlerStub.hpp>
+#include <PacketBuilder.hpp>
 #include <PacketParser.hpp>
-#include <boost/crc.hpp>
+#include <Responses.hpp>
+#include <algorithm>
 #include <catch2/catch_test_macros.hpp>
 #include <cstdint>
+#include <random>
 #include <span>
 #include <sstream>
 #include <string>
+#include <variant>
+#include <vector>
 
 using namespace std::string_literals;
 
-static std::string make_packet(const std::string &data)
+// A handler that opts into receiving command 1 data as a view.
+struct StringViewCommandHandlerStub : CommandHandlerStub
 {
-    boost::crc_16_type crc;
-    crc.process_bytes(data.data(), data.length());
-    const auto cs = crc.checksum();
-    const unsigned char low = cs & 0xff;
-    const unsigned char high = cs >> 8;
-    return "CMD"s + data + static_cast<char>(high) + static_cast<char>(low);
-}
+    void handle_command_1(std::string_view data_1)
+    {
+        call_sequence.push_back(1);
+        cmd_1.emplace_back(data_1);
+    }
+};
+
+// A handler that receives the commands in batches. Also implements the single command interface, which must not be
+// used by the parser.
+struct BatchCommandHandlerStub : StringViewCommandHandlerStub
+{
+    std::vector<std::size_t> batch_sizes;
+    int single_calls = 0;
+
+    void handle_batch(std::span<const Command> batch)
+    {
+        batch_sizes.push_back(batch.size());
+        for (const auto& command : batch)
+        {
+            if (const auto* cmd = std::get_if<Command1>(&command))
+            {
+                StringViewCommandHandlerStub::handle_command_1(cmd->data_1);
+            }
+            else if (const auto* cmd = std::get_if<Command2>(&command))
+            {
+                CommandHandlerStub::handle_command_2(cmd->data_2);
+            }
+            else if (const auto* cmd = std::get_if<Command3>(&command))
+            {
+                CommandHandlerStub::handle_command_3(cmd->data_3_1, cmd->data_3_2);
+            }
+        }
+    }
+
+    void handle_command_1(std::string_view) { single_calls++; }
+    void handle_command_2(uint8_t) { single_calls++; }
+    void handle_command_3(uint16_t, uint8_t) { single_calls++; }
+};
+
+static_assert(StringCommandHandler<CommandHandlerStub> && !StringViewCommandHandler<CommandHandlerStub>);
+static_assert(StringViewCommandHandler<StringViewCommandHandlerStub>);
+static_assert(CommandHandlerConcept<CommandHandlerStub> && CommandHandlerConcept<StringViewCommandHandlerStub>);
+static_assert(!BatchCommandHandler<CommandHandlerStub> && BatchCommandHandler<BatchCommandHandlerStub>);
+static_assert(CommandHandlerConcept<BatchCommandHandlerStub>);
 
 using vi = std::vector<int>;
 using vs = std::vector<std::string>;
@@ -147,6 +190,18 @@ TEST_CASE("PacketParser")
         CHECK(stub.cmd_3 == vp{{0x3456, 0x78}});
     }
 
+    SECTION("Skipped bytes")
+    {
+        auto packet = make_packet("\x00\x02\x12"s);
+        // Headers of the invalid packets are dropped as a whole, the rest is counted as skipped noise.
+        data << "garbage"s << packet << "CMD\x00\x09__"s << std::string(1000, 'C') << packet << "xyz"s;
+
+        parser(data.str());
+
+        CHECK(stub.call_sequence == vi{2, 2});
+        CHECK(parser.skipped_bytes() == 7 + 4 + 1000);
+    }
+
     SECTION("Nested command")
     {
         auto nested = make_packet("\x00\x01\x{03}QWE"s);
@@ -158,4 +213,274 @@ TEST_CASE("PacketParser")
         CHECK(stub.call_sequence == vi{1});
         CHECK(stub.cmd_1 == vs{nested});
     }
+
+    SECTION("Fragmented reads")
+    {
+        data << "CMDgarbageCCCCMCCCCMDDMCMDCC0123"s;
+        data << make_packet("\x00\x01\x{03}QWE"s);
+        data << make_packet("\x00\x02\x12"s);
+        data << "CMD\x00\x02\x03__CMDCMDC"s;
+        data << make_packet("\x00\x01\xff"s + std::string(255, 'X'));
+        data << make_packet("\x00\x03\x34\x56\x78"s);
+        data << "CMDCM"s;
+        data << make_packet("\x00\x01\x{03}QWE"s);
+        const auto stream = data.str();
+
+        parser(stream);
+        const auto expected = stub.call_sequence;
+        REQUIRE(expected == vi{1, 2, 1, 3, 1});
+
+        // Every chunk size must produce the same result as a single read, including the ones that are split inside
+        // the tail buffer and the ones that are larger than a max length packet.
+        for (std::size_t chunk_size = 1; chunk_size <= stream.size(); chunk_size++)
+        {
+            stub.clear();
+            for (std::size_t pos = 0; pos < stream.size(); pos += chunk_size)
+            {
+                parser(std::span(stream).subspan(pos, std::min(chunk_size, stream.size() - pos)));
+            }
+            CHECK(stub.call_sequence == expected);
+        }
+    }
+}
+
+TEST_CASE("PacketParser with string_view handler")
+{
+    auto stub = StringViewCommandHandlerStub{};
+    auto parser = PacketParser<StringViewCommandHandlerStub>{stub};
+
+    auto max_length_string = std::string(255, 'X');
+    const auto stream = make_packet("\x00\x01\x00"s) + make_packet("\x00\x01\x{05}ABCDE"s) +
+                        make_packet("\x00\x02\x12"s) + make_packet("\x00\x01\xff"s + max_length_string);
+
+    // Views into the received data and into the stitched tail buffer must both be valid during the call.
+    for (std::size_t chunk_size : {stream.size(), std::size_t{1}, std::size_t{7}, std::size_t{100}})
+    {
+        stub.clear();
+        for (std::size_t pos = 0; pos < stream.size(); pos += chunk_size)
+        {
+            parser(std::span(stream).subspan(pos, std::min(chunk_size, stream.size() - pos)));
+        }
+        CHECK(stub.call_sequence == vi{1, 1, 2, 1});
+        CHECK(stub.cmd_1 == vs{""s, "ABCDE"s, max_length_string});
+        CHECK(stub.cmd_2 == v8{0x12});
+    }
+}
+
+TEST_CASE("PacketParser with batch handler")
+{
+    auto stub = BatchCommandHandlerStub{};
+    auto parser = PacketParser<BatchCommandHandlerStub>{stub};
+
+    auto max_length_string = std::string(255, 'X');
+    const auto stream = make_packet("\x00\x01\x{05}ABCDE"s) + make_packet("\x00\x02\x12"s) + "CMDxx"s +
+                        make_packet("\x00\x03\x45\x67\x89"s) + make_packet("\x00\x01\xff"s + max_length_string);
+
+    SECTION("Single read")
+    {
+        parser(stream);
+
+        CHECK(stub.batch_sizes == std::vector<std::size_t>{4});
+        CHECK(stub.single_calls == 0);
+        CHECK(stub.call_sequence == vi{1, 2, 3, 1});
+        CHECK(stub.cmd_1 == vs{"ABCDE"s, max_length_string});
+        CHECK(stub.cmd_2 == v8{0x12});
+        CHECK(stub.cmd_3 == vp{{0x4567, 0x89}});
+    }
+
+    SECTION("No empty batches")
+    {
+        parser(std::span(stream).first(5));
+        parser(std::span(stream).subspan(5, 6));
+        CHECK(stub.batch_sizes.empty());
+
+        parser(std::span(stream).subspan(11));
+        CHECK(stub.batch_sizes == std::vector<std::size_t>{4});
+    }
+
+    SECTION("Fragmented reads")
+    {
+        // Records of a batch may refer both to the stitched tail buffer and to the received data.
+        for (std::size_t chunk_size = 1; chunk_size <= stream.size(); chunk_size++)
+        {
+            stub.clear();
+            for (std::size_t pos = 0; pos < stream.size(); pos += chunk_size)
+            {
+                parser(std::span(stream).subspan(pos, std::min(chunk_size, stream.size() - pos)));
+            }
+            CHECK(stub.call_sequence == vi{1, 2, 3, 1});
+            CHECK(stub.cmd_1 == vs{"ABCDE"s, max_length_string});
+            CHECK(stub.cmd_3 == vp{{0x4567, 0x89}});
+        }
+        CHECK(stub.single_calls == 0);
+    }
+}
+
+TEST_CASE("PacketParser bulk decoding")
+{
+    // Valid packets of all the commands mixed with noise, broken crcs, unknown ids and truncated packets.
+    std::mt19937 random(42);
+    auto data = std::ostringstream{};
+    for (int i = 0; i < 2000; i++)
+    {
+        auto packet = std::string{};
+        switch (random() % 3)
+        {
+        case 0:
+        {
+            const auto length = static_cast<char>(random() % 8);
+            packet = make_packet("\x00\x01"s + length + std::string(random() % 8, static_cast<char>('A' + i % 26)));
+            break;
+        }
+        case 1:
+            packet = make_packet("\x00\x02"s + static_cast<char>(i));
+            break;
+        default:
+            packet = make_packet("\x00\x03"s + static_cast<char>(i >> 8) + static_cast<char>(i) + '\x7f');
+        }
+        switch (random() % 10)
+        {
+        case 0:
+            packet.back() ^= 1;
+            break;
+        case 1:
+            packet.resize(random() % packet.size());
+            break;
+        case 2:
+            data << "CM\x00CMD\x00\x07"s;
+            break;
+        }
+        data << packet;
+    }
+    const auto stream = data.str();
+
+    auto expected_stub = CommandHandlerStub{};
+    auto expected_parser = PacketParser<CommandHandlerStub>{expected_stub};
+    expected_parser.set_bulk_decoding(false);
+    expected_parser(stream);
+    REQUIRE(expected_stub.call_sequence.size() > 1000);
+
+    // The fast path must not change the result, whichever way the stream is split into reads.
+    for (std::size_t chunk_size : {stream.size(), std::size_t{1}, std::size_t{7}, std::size_t{64}, std::size_t{1500}})
+    {
+        auto stub = CommandHandlerStub{};
+        auto parser = PacketParser<CommandHandlerStub>{stub};
+        for (std::size_t pos = 0; pos < stream.size(); pos += chunk_size)
+        {
+            parser(std::span(stream).subspan(pos, std::min(chunk_size, stream.size() - pos)));
+        }
+        CHECK(stub.call_sequence == expected_stub.call_sequence);
+        CHECK(stub.cmd_1 == expected_stub.cmd_1);
+        CHECK(stub.cmd_2 == expected_stub.cmd_2);
+        CHECK(stub.cmd_3 == expected_stub.cmd_3);
+        CHECK(parser.skipped_bytes() == expected_parser.skipped_bytes());
+
+        auto batch_stub = BatchCommandHandlerStub{};
+        auto batch_parser = PacketParser<BatchCommandHandlerStub>{batch_stub};
+        for (std::size_t pos = 0; pos < stream.size(); pos += chunk_size)
+        {
+            batch_parser(std::span(stream).subspan(pos, std::min(chunk_size, stream.size() - pos)));
+        }
+        CHECK(batch_stub.call_sequence == expected_stub.call_sequence);
+        CHECK(batch_stub.cmd_1 == expected_stub.cmd_1);
+        CHECK(batch_stub.single_calls == 0);
+    }
+}
+
+TEST_CASE("PacketParser decode_complete")
+{
+    using Parser = PacketParser<CommandHandlerStub>;
+    auto stub = CommandHandlerStub{};
+    auto deliver = [&stub](const auto& record) { record.deliver(stub); };
+
+    SECTION("Noise, invalid packets and an incomplete tail")
+    {
+        auto broken = make_packet("\x00\x02\x01"s);
+        broken.back() ^= 1;
+        const auto data = "xxCM"s + make_packet("\x00\x02\x12"s) + broken + "CMD\x00\x09"s +
+                          make_packet("\x00\x01\x{03}abc"s) + make_packet("\x00\x03\x45\x67\x89"s).substr(0, 6);
+        const auto counts = Parser::decode_complete(data, deliver);
+        CHECK(counts.packets == 2);
+        CHECK(counts.invalid == 2);
+        CHECK(stub.call_sequence == vi{2, 1});
+        CHECK(stub.cmd_2 == v8{0x12});
+        CHECK(stub.cmd_1 == vs{"abc"});
+    }
+
+    SECTION("Same packets as a parser of a single read")
+    {
+        const auto nested = make_packet("\x00\x02\x34"s);
+        const auto data = make_packet("\x00\x01"s + static_cast<char>(nested.size()) + nested) + nested;
+        auto expected = CommandHandlerStub{};
+        auto parser = PacketParser<CommandHandlerStub>{expected};
+        parser(data);
+        CHECK(Parser::decode_complete(data, deliver).packets == 2);
+        CHECK(stub.call_sequence == expected.call_sequence);
+        CHECK(stub.cmd_1 == expected.cmd_1);
+    }
+
+    SECTION("Empty data")
+    {
+        const auto counts = Parser::decode_complete(std::span<const char>{}, deliver);
+        CHECK(counts.packets == 0);
+        CHECK(counts.invalid == 0);
+    }
+}
+
+TEST_CASE("PacketParser responses")
+{
+    auto broken = make_packet("\x00\x02\x01"s);
+    broken.back() ^= 1;
+    const auto data = make_packet("\x00\x02\x12"s) + broken + make_packet("\x00\x09\x00"s) + "noise"s +
+                      make_packet("\x00\x01\x{03}abc"s);
+    const auto decode = [](const std::vector<char>& bytes)
+    {
+        std::vector<responses::Frame> frames;
+        for (std::size_t pos = 0; pos + responses::frame_length <= bytes.size(); pos += responses::frame_length)
+        {
+            frames.push_back(responses::parse(std::span<const char, responses::frame_length>(&bytes[pos], 8)).value());
+        }
+        return frames;
+    };
+
+    SECTION("Disabled by default")
+    {
+        auto stub = CommandHandlerStub{};
+        auto parser = PacketParser<CommandHandlerStub>{stub};
+        parser(data);
+        CHECK(parser.responses().empty());
+    }
+
+    SECTION("A frame per packet in the packet order")
+    {
+        using enum responses::Status;
+        const auto expected = std::vector<responses::Frame>{{accepted, 2}, {crc_failure, 2}, {unknown_command, 9},
+                                                            {accepted, 1}};
+        for (std::size_t chunk_size : {data.size(), std::size_t{1}})
+        {
+            auto stub = CommandHandlerStub{};
+            auto parser = PacketParser<CommandHandlerStub>{stub};
+            parser.enable_responses(true);
+            for (std::size_t pos = 0; pos < data.size(); pos += chunk_size)
+            {
+                parser(std::span(data).subspan(pos, std::min(chunk_size, data.size() - pos)));
+            }
+            CHECK(parser.responses().size() == expected.size() * responses::frame_length);
+            CHECK(decode(parser.responses()) == expected);
+        }
+    }
+
+    SECTION("Broken frames")
+    {
+        auto frame = std::vector<char>{};
+        responses::append(frame, responses::Status::crc_failure, 0x1234);
+        REQUIRE(frame.size() == responses::frame_length);
+        CHECK(std::string(frame.data(), 3) == "NAK");
+        for (std::size_t i = 0; i < frame.size(); i++)
+        {
+            auto broken_frame = frame;
+            broken_frame[i] ^= 0x10;
+            CHECK(!responses::parse(std::span<const char, responses::frame_length>(broken_frame.data(), 8)));
+        }
+    }
 }
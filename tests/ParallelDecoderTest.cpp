@@ -0,0 +1,152 @@
+#include <CommandHandlerStub.hpp>
+#include <PacketBuilder.hpp>
+#include <ParallelDecoder.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace std::string_literals;
+
+// Collects the commands of the batches in order.
+struct BatchStub
+{
+    std::vector<int> call_sequence;
+    std::vector<std::string> cmd_1;
+    std::size_t batches = 0;
+
+    void handle_batch(std::span<const Command> batch)
+    {
+        batches++;
+        for (const auto& command : batch)
+        {
+            call_sequence.push_back(static_cast<int>(command.index()) + 1);
+            if (const auto* cmd = std::get_if<Command1>(&command))
+            {
+                cmd_1.emplace_back(cmd->data_1);
+            }
+        }
+    }
+};
+
+// Valid packets mixed with noise, broken crcs, unknown ids, truncated packets and packets nested in command 1 data.
+static std::string make_stream(std::mt19937& random, int packet_count)
+{
+    std::string stream;
+    for (int i = 0; i < packet_count; i++)
+    {
+        auto packet = std::string{};
+        switch (random() % 4)
+        {
+        case 0:
+        {
+            const auto length = static_cast<char>(random() % 8);
+            packet = make_packet("\x00\x01"s + length + std::string(random() % 8, static_cast<char>('A' + i % 26)));
+            break;
+        }
+        case 1:
+            packet = make_packet("\x00\x02"s + static_cast<char>(i));
+            break;
+        case 2:
+            packet = make_packet("\x00\x03"s + static_cast<char>(i >> 8) + static_cast<char>(i) + '\x7f');
+            break;
+        default:
+        {
+            const auto nested = make_packet("\x00\x02"s + static_cast<char>(i));
+            packet = make_packet("\x00\x01"s + static_cast<char>(nested.size() + 2) + "xx"s + nested);
+            break;
+        }
+        }
+        switch (random() % 8)
+        {
+        case 0:
+            packet.back() ^= 1;
+            break;
+        case 1:
+            packet.resize(random() % packet.size());
+            break;
+        case 2:
+            stream += "CM\x00CMD\x00\x07"s;
+            break;
+        }
+        stream += packet;
+    }
+    return stream;
+}
+
+TEST_CASE("ParallelDecoder")
+{
+    std::mt19937 random(7);
+    const auto stream = make_stream(random, 3000);
+
+    auto expected = CommandHandlerStub{};
+    auto parser = PacketParser<CommandHandlerStub>{expected};
+    parser(stream);
+    REQUIRE(expected.call_sequence.size() > 1500);
+
+    SECTION("Same commands as a sequential parse for any chunking")
+    {
+        // Tiny chunks start inside packets, nested packets and noise all the time.
+        const auto chunk_sizes = std::vector<std::size_t>{1, 3, 7, 20, 64, 1000, stream.size(), stream.size() + 1};
+        for (const auto chunk_size : chunk_sizes)
+        {
+            for (const auto threads : {std::size_t{1}, std::size_t{3}})
+            {
+                auto stub = CommandHandlerStub{};
+                auto decoder =
+                    ParallelDecoder<CommandHandlerStub>{stub, {.threads = threads, .chunk_size = chunk_size}};
+                decoder(stream);
+                CHECK(stub.call_sequence == expected.call_sequence);
+                CHECK(stub.cmd_1 == expected.cmd_1);
+                CHECK(stub.cmd_2 == expected.cmd_2);
+                CHECK(stub.cmd_3 == expected.cmd_3);
+                CHECK(decoder.packets() == expected.call_sequence.size());
+            }
+        }
+    }
+
+    SECTION("Batch handler")
+    {
+        auto stub = BatchStub{};
+        auto decoder = ParallelDecoder<BatchStub>{stub, {.threads = 4, .chunk_size = 500}};
+        decoder(stream);
+        CHECK(stub.call_sequence == expected.call_sequence);
+        CHECK(stub.cmd_1 == expected.cmd_1);
+        CHECK(stub.batches > 1);
+    }
+
+    SECTION("Packet straddling the chunks with a valid packet inside")
+    {
+        const auto nested = make_packet("\x00\x02\x12"s);
+        const auto outer =
+            make_packet("\x00\x01"s + static_cast<char>(nested.size() + 10) + std::string(10, '_') + nested);
+        const auto data = outer + make_packet("\x00\x03\x01\x02\x03"s);
+        for (std::size_t chunk_size = 1; chunk_size <= data.size(); chunk_size++)
+        {
+            auto stub = CommandHandlerStub{};
+            auto decoder = ParallelDecoder<CommandHandlerStub>{stub, {.threads = 2, .chunk_size = chunk_size}};
+            decoder(data);
+            CHECK(stub.call_sequence == std::vector<int>{1, 3});
+        }
+    }
+
+    SECTION("Empty and incomplete streams")
+    {
+        auto stub = CommandHandlerStub{};
+        auto decoder = ParallelDecoder<CommandHandlerStub>{stub, {.threads = 2, .chunk_size = 4}};
+        decoder(std::span<const char>{});
+        decoder(make_packet("\x00\x01\x{05}ABCDE"s).substr(0, 10));
+        CHECK(stub.call_sequence.empty());
+    }
+
+    SECTION("Invalid options")
+    {
+        auto stub = CommandHandlerStub{};
+        CHECK_THROWS_AS((ParallelDecoder<CommandHandlerStub>{stub, {.threads = 0}}), std::invalid_argument);
+        CHECK_THROWS_AS((ParallelDecoder<CommandHandlerStub>{stub, {.chunk_size = 0}}), std::invalid_argument);
+    }
+}
@@ -0,0 +1,111 @@
+#include <Commands.hpp>
+#include <Protocol.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <variant>
+
+using namespace std::string_literals;
+
+namespace
+{
+    // A command that is not part of the server protocol: u32 little endian, u16 big endian, u16 prefixed chars.
+    struct Command7
+    {
+        static constexpr uint16_t id = 7;
+        using fields = protocol::Fields<protocol::U32Le, protocol::U16, protocol::LengthPrefixed<protocol::U16>>;
+
+        uint32_t value;
+        uint16_t flags;
+        std::string_view name;
+    };
+
+    // A command without data.
+    struct Command9
+    {
+        static constexpr uint16_t id = 9;
+        using fields = protocol::Fields<>;
+    };
+
+    using ExtendedProtocol = protocol::Table<Command1, Command2, Command3, Command7, Command9>;
+
+    // Remembers the last visited record.
+    struct Visitor
+    {
+        ExtendedProtocol::variant* result;
+
+        template <typename Record>
+        void operator()(const Record& record) const
+        {
+            *result = record;
+        }
+    };
+
+    ExtendedProtocol::variant decode(uint16_t id, const std::string& data)
+    {
+        auto result = ExtendedProtocol::variant{};
+        ExtendedProtocol::decoders<Visitor>[id](data.data(), Visitor{&result});
+        return result;
+    }
+} // namespace
+
+static_assert(Protocol::min_data_length == 1);
+static_assert(Protocol::max_data_length == 1 + 255);
+static_assert(Command3::fields::fixed && Command3::fields::offsets[1] == 2);
+static_assert(!Command1::fields::fixed);
+static_assert(ExtendedProtocol::min_data_length == 0);
+static_assert(ExtendedProtocol::max_data_length == 4 + 2 + 2 + 65535);
+static_assert(ExtendedProtocol::index_of<Command7> == 3);
+
+TEST_CASE("Protocol")
+{
+    SECTION("Integers")
+    {
+        const auto data = "\x12\x34\x56\x78"s;
+        CHECK(protocol::U8::decode(data.data()) == 0x12);
+        CHECK(protocol::U16::decode(data.data()) == 0x1234);
+        CHECK(protocol::U16Le::decode(data.data()) == 0x3412);
+        CHECK(protocol::U32::decode(data.data()) == 0x12345678);
+        CHECK(protocol::U32Le::decode(data.data()) == 0x78563412);
+        CHECK(protocol::U8::decode("\xff") == 0xff);
+    }
+
+    SECTION("Length rules")
+    {
+        CHECK(Protocol::find(0) == nullptr);
+        CHECK(Protocol::find(4) == nullptr);
+        CHECK(Protocol::find(0xffff) == nullptr);
+        REQUIRE(Protocol::find(3) != nullptr);
+        CHECK(Protocol::find(3)->fixed == 3);
+        REQUIRE(Protocol::find(1) != nullptr);
+        CHECK(Protocol::find(1)->fixed == 0);
+        CHECK(Protocol::find(1)->min == 1);
+        CHECK(Protocol::find(1)->compute("\x05hello") == 6);
+
+        REQUIRE(ExtendedProtocol::find(7) != nullptr);
+        CHECK(ExtendedProtocol::find(7)->min == 8);
+        CHECK(ExtendedProtocol::find(7)->compute("\x01\x00\x00\x00\x00\x02\x01\x00") == 8 + 256);
+        REQUIRE(ExtendedProtocol::find(9) != nullptr);
+        CHECK(ExtendedProtocol::find(9)->compute("") == 0);
+    }
+
+    SECTION("Decoding")
+    {
+        // The decoded strings refer to the data.
+        const auto data_1 = "\x03" "abc"s;
+        const auto cmd_1 = std::get<Command1>(decode(1, data_1));
+        CHECK(cmd_1.data_1 == "abc");
+        CHECK(std::get<Command2>(decode(2, "\x80"s)).data_2 == 0x80);
+        const auto cmd_3 = std::get<Command3>(decode(3, "\x0a\x12\xab"s));
+        CHECK(cmd_3.data_3_1 == 0x0a12);
+        CHECK(cmd_3.data_3_2 == 0xab);
+        const auto data_7 = "\x01\x02\x00\x00\x00\x10\x00\x04name"s;
+        const auto cmd_7 = std::get<Command7>(decode(7, data_7));
+        CHECK(cmd_7.value == 0x0201);
+        CHECK(cmd_7.flags == 0x10);
+        CHECK(cmd_7.name == "name");
+        CHECK(std::holds_alternative<Command9>(decode(9, "")));
+        CHECK(ExtendedProtocol::decoders<Visitor>[4] == nullptr);
+    }
+}
@@ -0,0 +1,243 @@
+#include <RecordingHandler.hpp>
+#include <ShmProducer.hpp>
+#include <ShmRing.hpp>
+#include <ShmRingServer.hpp>
+#include <array>
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    // Attaches to the ring the way the server does, through duplicates of its descriptors.
+    std::unique_ptr<ShmRing> attach(const ShmRing& ring)
+    {
+        const auto descriptors = ring.descriptors();
+        return std::make_unique<ShmRing>(::dup(descriptors[0]), ::dup(descriptors[1]), ::dup(descriptors[2]));
+    }
+
+    std::string read_all(ShmRing& ring)
+    {
+        std::string result;
+        for (const auto part : ring.readable())
+        {
+            result.append(part.data(), part.size());
+        }
+        ring.consume(result.size());
+        return result;
+    }
+
+    tcp_server::stream_protocol::socket connect(boost::asio::io_context& io_context, const std::string& path)
+    {
+        auto socket = tcp_server::stream_protocol::socket{io_context};
+        socket.connect(tcp_server::stream_protocol::endpoint{path});
+        return socket;
+    }
+
+    // Sends the descriptors like ShmProducer does, but any number of them.
+    template <std::size_t Count>
+    void send_descriptors(tcp_server::stream_protocol::socket& socket, const std::array<int, Count>& descriptors)
+    {
+        char byte = 0;
+        iovec data{&byte, 1};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(descriptors))]{};
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        auto* cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(descriptors));
+        std::memcpy(CMSG_DATA(cmsg), descriptors.data(), sizeof(descriptors));
+        REQUIRE(::sendmsg(socket.native_handle(), &message, MSG_NOSIGNAL) == 1);
+    }
+} // namespace
+
+TEST_CASE("ShmRing")
+{
+    const auto capacity = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto producer = ShmRing{capacity};
+    auto consumer = attach(producer);
+    REQUIRE(consumer->capacity() == capacity);
+
+    SECTION("Wraps around")
+    {
+        const auto data = make_data(capacity * 3);
+        std::string received;
+        for (std::size_t position = 0; position < data.size();)
+        {
+            // Odd write sizes, so the writes and reads straddle the end of the data area.
+            const auto length = std::min<std::size_t>(777, data.size() - position);
+            position += producer.write(std::span(data).subspan(position, length));
+            received += read_all(*consumer);
+        }
+        CHECK(received == data);
+    }
+
+    SECTION("Full ring")
+    {
+        const auto data = make_data(capacity + 10);
+        CHECK(producer.write(data) == capacity);
+        CHECK(producer.write(data) == 0);
+        CHECK(producer.prepare_space_wait());
+        CHECK(consumer->readable()[0].size() == capacity);
+        consumer->consume(10);
+        // The consumer has signalled the waiting producer.
+        uint64_t count = 0;
+        CHECK(::read(producer.space_event(), &count, sizeof(count)) == sizeof(count));
+        CHECK(!producer.prepare_space_wait());
+        CHECK(producer.write(data) == 10);
+    }
+
+    SECTION("Wakeups only when waiting")
+    {
+        uint64_t count = 0;
+        CHECK(consumer->prepare_data_wait());
+        CHECK(producer.write(std::string("abc")) == 3);
+        CHECK(::read(consumer->data_event(), &count, sizeof(count)) == sizeof(count));
+        CHECK(!consumer->prepare_data_wait());
+        CHECK(producer.write(std::string("def")) == 3);
+        CHECK(::read(consumer->data_event(), &count, sizeof(count)) < 0);
+        CHECK(read_all(*consumer) == "abcdef");
+    }
+
+    SECTION("Invalid rings")
+    {
+        CHECK_THROWS_AS(ShmRing{capacity + 1}, std::invalid_argument);
+        CHECK_THROWS_AS(ShmRing{0}, std::invalid_argument);
+
+        // Not sealed, the producer could shrink it under the consumer's reads.
+        const int memory = ::memfd_create("unsealed", MFD_CLOEXEC);
+        REQUIRE(memory >= 0);
+        REQUIRE(::ftruncate(memory, static_cast<off_t>(shm_ring::control_size + capacity)) == 0);
+        const auto descriptors = producer.descriptors();
+        CHECK_THROWS_AS((ShmRing{memory, ::dup(descriptors[1]), ::dup(descriptors[2])}), std::runtime_error);
+    }
+}
+
+TEST_CASE("ShmRingServer")
+{
+    const auto path =
+        (std::filesystem::temp_directory_path() / ("shm_ring_test_" + std::to_string(::getpid()))).string();
+    boost::asio::io_context io_context{1};
+    auto received = Received{};
+    auto factory = RecordingFactory{received};
+    auto server = tcp_server::ShmRingServer<RecordingFactory>{io_context, factory, path};
+    const auto data = make_data(1024 * 1024);
+
+    SECTION("Transfer through a ring smaller than the data")
+    {
+        std::jthread producer(
+            [&path, &data]
+            {
+                auto ring = ShmProducer{path, 16 * 1024};
+                // Some writes fill the ring and wait for the server.
+                for (std::size_t position = 0; position < data.size(); position += 5000)
+                {
+                    ring.write(std::span(data).subspan(position, std::min<std::size_t>(5000, data.size() - position)));
+                }
+            });
+        while (received.data.size() < data.size() && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+        {
+        }
+        REQUIRE(received.connections.size() == 1);
+        CHECK(received.connections[0] == data);
+    }
+
+    SECTION("Data written before closing is decoded")
+    {
+        {
+            auto first = ShmProducer{path, 64 * 1024};
+            auto second = ShmProducer{path, 64 * 1024};
+            first.write(std::string("first"));
+            second.write(std::string("second"));
+        }
+        // Accept the connections still waiting in the backlog.
+        while (received.data.size() < 11 && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+        {
+        }
+        server.stop();
+        io_context.run_for(std::chrono::seconds(5));
+        CHECK(io_context.stopped());
+        REQUIRE(received.connections.size() == 2);
+        CHECK(received.connections[0] + received.connections[1] == "firstsecond");
+    }
+
+    SECTION("The producer notices a stopped server")
+    {
+        auto producer = std::unique_ptr<ShmProducer>{};
+        {
+            boost::asio::io_context other_context{1};
+            auto other = tcp_server::ShmRingServer<RecordingFactory>{other_context, factory, path + "_other"};
+            producer = std::make_unique<ShmProducer>(path + "_other", 16 * 1024);
+            other_context.run_for(std::chrono::milliseconds(100));
+        }
+        // The ring fills up and nobody is left to free it.
+        CHECK_THROWS_AS(producer->write(data), std::runtime_error);
+    }
+
+    SECTION("Connections without a ring are dropped")
+    {
+        {
+            boost::asio::io_context client_context;
+            auto socket = tcp_server::stream_protocol::socket{client_context};
+            socket.connect(tcp_server::stream_protocol::endpoint{path});
+            boost::asio::write(socket, boost::asio::buffer("x", 1));
+        }
+        io_context.run_for(std::chrono::milliseconds(100));
+        server.stop();
+        io_context.run_for(std::chrono::seconds(5));
+        CHECK(io_context.stopped());
+        CHECK(received.connections.empty());
+    }
+
+    SECTION("Every descriptor of a rejected producer is closed")
+    {
+        auto ring = ShmRing{16 * 1024};
+        const auto descriptors = ring.descriptors();
+        std::array<int, 2> extra{};
+        REQUIRE(::pipe2(extra.data(), O_CLOEXEC | O_NONBLOCK) == 0);
+        boost::asio::io_context client_context;
+        auto socket = connect(client_context, path);
+        send_descriptors(socket, std::array{descriptors[0], descriptors[1], descriptors[2], extra[1]});
+        ::close(extra[1]);
+        io_context.run_for(std::chrono::milliseconds(100));
+        CHECK(received.connections.empty());
+        // The server's copy of the pipe is closed, so the pipe is at its end instead of empty.
+        char byte = 0;
+        CHECK(::read(extra[0], &byte, 1) == 0);
+        ::close(extra[0]);
+    }
+
+    SECTION("A blocking data event is made non-blocking")
+    {
+        auto ring = ShmRing{16 * 1024};
+        const auto descriptors = ring.descriptors();
+        REQUIRE(::fcntl(descriptors[1], F_SETFL, ::fcntl(descriptors[1], F_GETFL) & ~O_NONBLOCK) == 0);
+        boost::asio::io_context client_context;
+        auto socket = connect(client_context, path);
+        send_descriptors(socket, descriptors);
+        CHECK(ring.write(std::string("ring")) == 4);
+        while (received.data.size() < 4 && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+        {
+        }
+        REQUIRE(received.connections.size() == 1);
+        CHECK(received.connections[0] == "ring");
+        // The descriptors share the flag with the duplicates received by the server.
+        CHECK((::fcntl(descriptors[1], F_GETFL) & O_NONBLOCK) != 0);
+    }
+}
@@ -0,0 +1,517 @@
+#include <Metrics.hpp>
+#include <RecordingHandler.hpp>
+#include <TcpServer.hpp>
+#include <UnixServer.hpp>
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#ifdef SERVER_WITH_IO_URING
+#include <IoUring.hpp>
+#include <UringTcpServer.hpp>
+#endif
+
+namespace
+{
+    // Sends the data from a separate thread and runs the server until everything is received.
+    template <typename Server, typename Options>
+    void transfer(const Options& options, const std::string& data, Received& received)
+    {
+        boost::asio::io_context io_context{1};
+        auto factory = RecordingFactory{received};
+        auto server = Server{io_context, factory, 0, false, options};
+        std::jthread client(
+            [&data, port = server.port()]
+            {
+                boost::asio::io_context client_context;
+                auto socket = tcp_server::tcp::socket{client_context};
+                socket.connect({boost::asio::ip::make_address("127.0.0.1"), port});
+                boost::asio::write(socket, boost::asio::buffer(data));
+            });
+        while (received.data.size() < data.size() && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+        {
+        }
+    }
+
+    // Records the data like RecordingHandler and sends it back as its responses.
+    struct EchoHandler
+    {
+        Received& received;
+        std::vector<char> echo{};
+
+        void operator()(std::span<char> data)
+        {
+            received.data.append(data.data(), data.size());
+            echo.insert(echo.end(), data.begin(), data.end());
+        }
+
+        std::vector<char>& responses() { return echo; }
+    };
+
+    struct EchoFactory
+    {
+        Received& received;
+
+        auto operator()() { return std::make_unique<EchoHandler>(received); }
+    };
+
+    static_assert(tcp_server::ResponseSource<EchoHandler> && !tcp_server::ResponseSource<RecordingHandler>);
+
+    using Server = tcp_server::TcpServer<RecordingFactory>;
+} // namespace
+
+TEST_CASE("AdaptiveBuffer")
+{
+    auto buffer = tcp_server::AdaptiveBuffer{256, 1024};
+    CHECK(buffer.data().size() == 256);
+
+    SECTION("Grows on full reads up to the limit")
+    {
+        buffer.record_read(256);
+        CHECK(buffer.data().size() == 512);
+        buffer.record_read(511);
+        CHECK(buffer.data().size() == 512);
+        buffer.record_read(512);
+        CHECK(buffer.data().size() == 1024);
+        buffer.record_read(1024);
+        CHECK(buffer.data().size() == 1024);
+    }
+
+    SECTION("Shrinks after many small reads")
+    {
+        buffer.record_read(256);
+        buffer.record_read(512);
+        REQUIRE(buffer.data().size() == 1024);
+
+        // A larger read in between restarts the count.
+        for (int i = 0; i < 15; i++)
+        {
+            buffer.record_read(10);
+        }
+        buffer.record_read(600);
+        for (int i = 0; i < 15; i++)
+        {
+            buffer.record_read(10);
+        }
+        CHECK(buffer.data().size() == 1024);
+        buffer.record_read(10);
+        CHECK(buffer.data().size() == 512);
+
+        for (int i = 0; i < 100; i++)
+        {
+            buffer.record_read(1);
+        }
+        CHECK(buffer.data().size() == 256);
+    }
+
+    SECTION("Empty")
+    {
+        auto empty = tcp_server::AdaptiveBuffer{0, 0};
+        CHECK(empty.data().empty());
+    }
+}
+
+TEST_CASE("TcpServer")
+{
+    const auto data = make_data(1024 * 1024);
+    auto received = Received{};
+
+    SECTION("Adaptive buffers")
+    {
+        transfer<Server>(tcp_server::ReceiveOptions{.min_buffer_size = 256, .max_buffer_size = 64 * 1024}, data,
+                         received);
+        CHECK(received.data == data);
+        CHECK(received.read_sizes.front() <= 256);
+        CHECK(std::ranges::max(received.read_sizes) <= 64 * 1024);
+        // The buffer must have grown for the bulk transfer.
+        CHECK(std::ranges::max(received.read_sizes) > 256);
+    }
+
+    SECTION("Shared buffer")
+    {
+        transfer<Server>(
+            tcp_server::ReceiveOptions{.min_buffer_size = 256, .max_buffer_size = 16 * 1024, .shared_buffer = true},
+            data, received);
+        CHECK(received.data == data);
+        CHECK(std::ranges::max(received.read_sizes) <= 16 * 1024);
+    }
+
+    SECTION("Socket options and receive timestamps")
+    {
+        const auto before = metrics::collect().histogram(metrics::Histogram::receive_latency_ns).count();
+        transfer<Server>(
+            tcp_server::ReceiveOptions{
+                .min_buffer_size = 256,
+                .max_buffer_size = 64 * 1024,
+                .socket = {.no_delay = true, .quick_ack = true, .receive_buffer = 256 * 1024,
+                           .receive_timestamps = true},
+            },
+            data, received);
+        CHECK(received.data == data);
+        // The sessions read with timestamps into their own buffers, which still grow for the bulk transfer.
+        CHECK(std::ranges::max(received.read_sizes) > 256);
+        if constexpr (metrics::enabled)
+        {
+            const auto after = metrics::collect();
+            CHECK(after.histogram(metrics::Histogram::receive_latency_ns).count() > before);
+        }
+    }
+
+    SECTION("Sessions end with the connection or the io_context")
+    {
+        // Counts the live buffer handlers, which are owned by the sessions.
+        struct TrackingHandler
+        {
+            int& live;
+
+            explicit TrackingHandler(int& live) : live{live} { live++; }
+
+            ~TrackingHandler() { live--; }
+
+            void operator()(std::span<char>) {}
+        };
+        int live = 0;
+        auto factory = [&live] { return std::make_unique<TrackingHandler>(live); };
+        {
+            boost::asio::io_context io_context{1};
+            auto server = tcp_server::TcpServer<decltype(factory)>{io_context, factory, 0};
+            auto client = tcp_server::tcp::socket{io_context};
+            client.connect({boost::asio::ip::make_address("127.0.0.1"), server.port()});
+            boost::asio::write(client, boost::asio::buffer(data.data(), 1000));
+            while (live == 0 && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+            {
+            }
+            CHECK(live == 1);
+            client.close();
+            while (live == 1 && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+            {
+            }
+            CHECK(live == 0);
+
+            // The session of an open connection is freed along with its pending read.
+            client.connect({boost::asio::ip::make_address("127.0.0.1"), server.port()});
+            while (live == 0 && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+            {
+            }
+            CHECK(live == 1);
+        }
+        CHECK(live == 0);
+    }
+
+    SECTION("Invalid options")
+    {
+        boost::asio::io_context io_context{1};
+        auto factory = RecordingFactory{received};
+        CHECK_THROWS_AS((tcp_server::TcpServer<RecordingFactory>{io_context, factory, 0, false,
+                                                                  {.min_buffer_size = 1024, .max_buffer_size = 256}}),
+                        std::invalid_argument);
+    }
+}
+
+#ifdef SERVER_WITH_IO_URING
+TEST_CASE("UringTcpServer")
+{
+    if (!IoUring::multishot_recv_supported())
+    {
+        SKIP("io_uring multishot receive is not supported by the kernel");
+    }
+    using UringServer = tcp_server::UringTcpServer<RecordingFactory>;
+    const auto data = make_data(1024 * 1024);
+    auto received = Received{};
+
+    SECTION("Transfer")
+    {
+        transfer<UringServer>(tcp_server::UringOptions{.buffer_count = 64, .buffer_size = 4096}, data, received);
+        CHECK(received.data == data);
+        CHECK(std::ranges::max(received.read_sizes) <= 4096);
+    }
+
+    SECTION("Buffer shortage")
+    {
+        // The kernel runs out of buffers and ends the multishot requests, they must be re-armed.
+        transfer<UringServer>(tcp_server::UringOptions{.buffer_count = 2, .buffer_size = 256}, data, received);
+        CHECK(received.data == data);
+    }
+
+    SECTION("Socket options")
+    {
+        transfer<UringServer>(
+            tcp_server::UringOptions{
+                .buffer_count = 64,
+                .buffer_size = 4096,
+                .socket = {.no_delay = true, .quick_ack = true, .receive_buffer = 256 * 1024},
+            },
+            data, received);
+        CHECK(received.data == data);
+        boost::asio::io_context io_context{1};
+        auto factory = RecordingFactory{received};
+        CHECK_THROWS_AS((UringServer{io_context, factory, 0, false, {.socket = {.receive_timestamps = true}}}),
+                        std::invalid_argument);
+    }
+
+    SECTION("Many connections")
+    {
+        boost::asio::io_context io_context{1};
+        auto factory = RecordingFactory{received};
+        auto server = UringServer{io_context, factory, 0};
+        constexpr int client_count = 50;
+        {
+            std::jthread clients(
+                [port = server.port()]
+                {
+                    boost::asio::io_context client_context;
+                    std::vector<tcp_server::tcp::socket> sockets;
+                    for (int i = 0; i < client_count; i++)
+                    {
+                        sockets.emplace_back(client_context)
+                            .connect({boost::asio::ip::make_address("127.0.0.1"), port});
+                    }
+                    for (auto& socket : sockets)
+                    {
+                        boost::asio::write(socket, boost::asio::buffer("0123456789", 10));
+                    }
+                });
+            while (received.data.size() < client_count * 10 && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+            {
+            }
+        }
+        CHECK(received.data.size() == client_count * 10);
+
+        // The connections are closed by now, the server leaves the io_context once it is stopped.
+        server.stop();
+        io_context.run_for(std::chrono::seconds(5));
+        CHECK(io_context.stopped());
+    }
+
+    SECTION("More connections to re-arm than the submission queue holds")
+    {
+        // Two buffers for all the connections: most receive requests end with ENOBUFS in the same pass and are
+        // re-armed through a queue of two entries.
+        boost::asio::io_context io_context{1};
+        auto factory = RecordingFactory{received};
+        auto server =
+            UringServer{io_context, factory, 0, false, {.queue_depth = 2, .buffer_count = 2, .buffer_size = 256}};
+        constexpr int client_count = 32;
+        const auto client_data = std::string_view(data).substr(0, 64 * 1024);
+        {
+            std::jthread clients(
+                [port = server.port(), client_data]
+                {
+                    boost::asio::io_context client_context;
+                    std::vector<tcp_server::tcp::socket> sockets;
+                    for (int i = 0; i < client_count; i++)
+                    {
+                        sockets.emplace_back(client_context)
+                            .connect({boost::asio::ip::make_address("127.0.0.1"), port});
+                    }
+                    for (std::size_t position = 0; position < client_data.size(); position += 4096)
+                    {
+                        for (auto& socket : sockets)
+                        {
+                            boost::asio::write(socket, boost::asio::buffer(client_data.substr(position, 4096)));
+                        }
+                    }
+                });
+            while (received.data.size() < client_count * client_data.size() &&
+                   io_context.run_one_for(std::chrono::seconds(5)) > 0)
+            {
+            }
+        }
+        REQUIRE(received.connections.size() == client_count);
+        for (const auto& connection : received.connections)
+        {
+            CHECK(connection == client_data);
+        }
+    }
+
+    SECTION("Invalid options")
+    {
+        boost::asio::io_context io_context{1};
+        auto factory = RecordingFactory{received};
+        CHECK_THROWS_AS((UringServer{io_context, factory, 0, false, {.buffer_count = 1000}}), std::invalid_argument);
+        CHECK_THROWS_AS((UringServer{io_context, factory, 0, false, {.buffer_count = 65536}}), std::invalid_argument);
+        CHECK_THROWS_AS((UringServer{io_context, factory, 0, false, {.buffer_size = 0}}), std::invalid_argument);
+        CHECK_THROWS_AS((UringServer{io_context, factory, 0, false, {.buffer_size = std::size_t{1} << 32}}),
+                        std::invalid_argument);
+    }
+}
+#endif
+
+TEST_CASE("UnixServer")
+{
+    using UnixServer = tcp_server::UnixServer<RecordingFactory>;
+    const auto path =
+        (std::filesystem::temp_directory_path() / ("unix_server_test_" + std::to_string(::getpid()))).string();
+    const auto data = make_data(256 * 1024);
+    auto received = Received{};
+    boost::asio::io_context io_context{1};
+    auto factory = RecordingFactory{received};
+
+    // Sends the data through a new connection and runs the server until it is received.
+    auto send = [&](const std::string& payload)
+    {
+        const auto expected = received.data.size() + payload.size();
+        std::jthread client(
+            [&payload, &path]
+            {
+                boost::asio::io_context client_context;
+                auto socket = tcp_server::stream_protocol::socket{client_context};
+                socket.connect(tcp_server::stream_protocol::endpoint{path});
+                boost::asio::write(socket, boost::asio::buffer(payload));
+            });
+        while (received.data.size() < expected && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+        {
+        }
+    };
+
+    SECTION("Transfer")
+    {
+        {
+            auto server = UnixServer{io_context, factory, path, {.shared_buffer = true}};
+            CHECK(server.path() == path);
+            send(data);
+            CHECK(received.data == data);
+        }
+        CHECK(!std::filesystem::exists(path));
+    }
+
+    SECTION("A stale socket file is replaced")
+    {
+        {
+            // A socket that was closed without removing its file, as after a crash.
+            auto stale = tcp_server::stream_protocol::acceptor{io_context, tcp_server::stream_protocol::endpoint{path}};
+        }
+        REQUIRE(std::filesystem::exists(path));
+        auto server = UnixServer{io_context, factory, path};
+        send(data);
+        CHECK(received.data == data);
+    }
+
+    SECTION("Sharing the socket")
+    {
+        auto server = UnixServer{io_context, factory, path};
+        boost::asio::io_context other_context{1};
+        auto other = UnixServer{other_context, factory, server};
+        server.stop();
+        // The first server is not accepting any more, the connection is taken by the other one.
+        io_context.run_for(std::chrono::milliseconds(100));
+        io_context.restart();
+        std::jthread client(
+            [&path]
+            {
+                boost::asio::io_context client_context;
+                auto socket = tcp_server::stream_protocol::socket{client_context};
+                socket.connect(tcp_server::stream_protocol::endpoint{path});
+                boost::asio::write(socket, boost::asio::buffer("0123456789", 10));
+            });
+        while (received.data.size() < 10 && other_context.run_one_for(std::chrono::seconds(5)) > 0)
+        {
+        }
+        CHECK(received.data == "0123456789");
+    }
+}
+
+TEST_CASE("Responses")
+{
+    const auto data = make_data(1024 * 1024);
+    auto received = Received{};
+    boost::asio::io_context io_context{1};
+    auto factory = EchoFactory{received};
+
+    // The client writes and reads at the same time, every byte must come back in order.
+    auto echo = [&](const tcp_server::ReceiveOptions& options)
+    {
+        auto server = tcp_server::TcpServer<EchoFactory>{io_context, factory, 0, false, options};
+        std::string echoed(data.size(), '\0');
+        std::atomic<bool> done = false;
+        std::jthread client(
+            [&, port = server.port()]
+            {
+                boost::asio::io_context client_context;
+                auto socket = tcp_server::tcp::socket{client_context};
+                socket.connect({boost::asio::ip::make_address("127.0.0.1"), port});
+                {
+                    std::jthread writer([&] { boost::asio::write(socket, boost::asio::buffer(data)); });
+                    boost::asio::read(socket, boost::asio::buffer(echoed));
+                }
+                done = true;
+            });
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!done && std::chrono::steady_clock::now() < deadline)
+        {
+            io_context.run_one_for(std::chrono::milliseconds(100));
+        }
+        CHECK(received.data == data);
+        CHECK(echoed == data);
+    };
+
+    SECTION("Adaptive buffers")
+    {
+        echo({.max_pending_responses = 4096});
+    }
+
+    SECTION("Shared buffer")
+    {
+        echo({.shared_buffer = true, .max_pending_responses = 4096});
+    }
+
+    SECTION("Reading pauses while the client does not read")
+    {
+        const auto path =
+            (std::filesystem::temp_directory_path() / ("responses_test_" + std::to_string(::getpid()))).string();
+        auto server = tcp_server::UnixServer<EchoFactory>{io_context, factory, path, {.max_pending_responses = 4096}};
+        const auto pauses = metrics::local().counter(metrics::Counter::read_pauses);
+        boost::asio::io_context client_context;
+        auto socket = tcp_server::stream_protocol::socket{client_context};
+        socket.connect(tcp_server::stream_protocol::endpoint{path});
+        socket.non_blocking(true);
+        const auto large = make_data(16 * 1024 * 1024);
+        std::size_t sent = 0;
+        boost::system::error_code ec;
+        for (int i = 0; i < 200; i++)
+        {
+            sent += socket.write_some(boost::asio::buffer(large.data() + sent, large.size() - sent), ec);
+            io_context.run_for(std::chrono::milliseconds(1));
+        }
+        // The server stops reading instead of queueing the responses without bound.
+        const auto paused_at = received.data.size();
+        CHECK(sent < large.size());
+        CHECK(paused_at < 4 * 1024 * 1024);
+        io_context.run_for(std::chrono::milliseconds(50));
+        CHECK(received.data.size() == paused_at);
+        if constexpr (metrics::enabled)
+        {
+            CHECK(metrics::local().counter(metrics::Counter::read_pauses) > pauses);
+        }
+
+        // Reading the responses resumes the transfer.
+        std::string echoed;
+        std::array<char, 64 * 1024> buffer{};
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+        while (echoed.size() < large.size() && std::chrono::steady_clock::now() < deadline)
+        {
+            if (sent < large.size())
+            {
+                sent += socket.write_some(boost::asio::buffer(large.data() + sent, large.size() - sent), ec);
+            }
+            const auto length = socket.read_some(boost::asio::buffer(buffer), ec);
+            echoed.append(buffer.data(), ec ? 0 : length);
+            io_context.poll();
+            io_context.restart();
+        }
+        CHECK(echoed == large);
+    }
+}
@@ -0,0 +1,92 @@
+#include <PacketBuilder.hpp>
+#include <PacketParser.hpp>
+#include <Telemetry.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::string_literals;
+
+using Stats = TelemetryTable::KeyStats;
+using vk = std::vector<Stats>;
+
+TEST_CASE("TelemetryTable")
+{
+    auto table = TelemetryTable{};
+    CHECK(table.snapshot().empty());
+
+    SECTION("Single shard")
+    {
+        auto &shard = table.add_shard();
+        shard.record(7, 10, 1);
+        shard.record(7, 3, 2);
+        shard.record(7, 5, 3);
+        shard.record(0xffff, 200, 4);
+        CHECK(table.snapshot() == vk{{7, 3, 18, 3, 10, 5}, {0xffff, 1, 200, 200, 200, 200}});
+    }
+
+    SECTION("Shards are merged, the last value is the latest one")
+    {
+        auto &first = table.add_shard();
+        auto &second = table.add_shard();
+        first.record(1, 50, 10);
+        second.record(1, 20, 5);
+        second.record(2, 0, 5);
+        first.record(2, 255, 1);
+        CHECK(table.snapshot() == vk{{1, 2, 70, 20, 50, 50}, {2, 2, 255, 0, 255, 0}});
+    }
+
+    SECTION("Snapshots while the threads record")
+    {
+        constexpr int samples = 100000;
+        std::vector<std::jthread> writers;
+        for (int t = 0; t < 4; t++)
+        {
+            writers.emplace_back(
+                [&table]
+                {
+                    auto aggregator = TelemetryAggregator{table};
+                    for (int i = 0; i < samples; i++)
+                    {
+                        aggregator.handle_command_3(static_cast<uint16_t>(i % 100), 1);
+                    }
+                });
+        }
+        for (int i = 0; i < 10; i++)
+        {
+            for (const auto &key : table.snapshot())
+            {
+                CHECK(key.count <= 4 * samples / 100);
+                CHECK(key.min == 1);
+                CHECK(key.max == 1);
+            }
+        }
+        writers.clear();
+        const auto snapshot = table.snapshot();
+        REQUIRE(snapshot.size() == 100);
+        for (const auto &key : snapshot)
+        {
+            CHECK(key.count == 4 * samples / 100);
+            CHECK(key.sum == key.count);
+        }
+    }
+}
+
+TEST_CASE("TelemetryAggregator")
+{
+    auto table = TelemetryTable{};
+    auto aggregator = TelemetryAggregator{table};
+    auto parser = PacketParser<TelemetryAggregator>{aggregator};
+    parser(make_packet("\x00\x03\x12\x34\x05"s) + make_packet("\x00\x01\x02hi"s) + make_packet("\x00\x02\x07"s) +
+           make_packet("\x00\x03\x12\x34\x01"s) + make_packet("\x00\x03\x00\x01\xff"s));
+    const auto snapshot = table.snapshot();
+    CHECK(snapshot == vk{{0x0001, 1, 255, 255, 255, 255}, {0x1234, 2, 6, 1, 5, 1}});
+
+    auto json = std::ostringstream{};
+    write_json(json, snapshot);
+    CHECK(json.str() == "{\"telemetry\":[{\"key\":1,\"count\":1,\"sum\":255,\"min\":255,\"max\":255,\"last\":255},"
+                        "{\"key\":4660,\"count\":2,\"sum\":6,\"min\":1,\"max\":5,\"last\":1}]}\n");
+}
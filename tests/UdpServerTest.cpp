@@ -0,0 +1,180 @@
+#include <CommandHandlerStub.hpp>
+#include <PacketBuilder.hpp>
+#include <UdpServer.hpp>
+#include <boost/asio.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace
+{
+    // Counts the batches and passes the commands on to the stub interface.
+    struct BatchStub : CommandHandlerStub
+    {
+        std::size_t batches = 0;
+
+        void handle_batch(std::span<const Command> batch)
+        {
+            batches++;
+            for (const auto& command : batch)
+            {
+                std::visit([this](const auto& record) { record.deliver(static_cast<CommandHandlerStub&>(*this)); },
+                           command);
+            }
+        }
+    };
+
+    using udp = tcp_server::udp;
+
+    // A client socket bound to the loopback address.
+    udp::socket make_client(boost::asio::io_context& io_context)
+    {
+        auto socket = udp::socket{io_context};
+        socket.open(udp::v4());
+        socket.bind({boost::asio::ip::make_address("127.0.0.1"), 0});
+        return socket;
+    }
+
+    // Runs the server until the handler has received the expected number of commands.
+    template <typename Handler>
+    void receive(boost::asio::io_context& io_context, const Handler& handler, std::size_t commands)
+    {
+        while (handler.call_sequence.size() < commands && io_context.run_one_for(std::chrono::seconds(5)) > 0)
+        {
+        }
+    }
+
+    // Statistics of the source with the given port.
+    tcp_server::UdpSourceStats find_source(const std::vector<tcp_server::UdpSourceStats>& sources,
+                                           tcp_server::ip::port_type port)
+    {
+        const auto it = std::find_if(sources.begin(), sources.end(),
+                                     [port](const auto& source) { return source.source.port() == port; });
+        REQUIRE(it != sources.end());
+        return *it;
+    }
+} // namespace
+
+TEST_CASE("UdpServer")
+{
+    boost::asio::io_context io_context{1};
+    const auto packet_1 = make_packet("\x00\x01\x{03}abc"s);
+    const auto packet_2 = make_packet("\x00\x02\x12"s);
+    const auto packet_3 = make_packet("\x00\x03\x45\x67\x89"s);
+
+    SECTION("Packets of every datagram are decoded, incomplete packets are dropped")
+    {
+        auto stub = CommandHandlerStub{};
+        auto server = tcp_server::UdpServer<CommandHandlerStub>{io_context, stub, 0};
+        const auto destination = udp::endpoint{boost::asio::ip::make_address("127.0.0.1"), server.port()};
+        auto client = make_client(io_context);
+        auto broken = packet_2;
+        broken.back() ^= 1;
+        // The second datagram starts with the rest of the incomplete packet of the first one.
+        client.send_to(boost::asio::buffer("noise"s + packet_1 + packet_2 + packet_3.substr(0, 6)), destination);
+        client.send_to(boost::asio::buffer(packet_3.substr(6) + broken + packet_3), destination);
+        client.send_to(boost::asio::buffer(std::string{}), destination);
+        receive(io_context, stub, 3);
+        io_context.poll(); // the empty datagram
+
+        CHECK(stub.call_sequence == std::vector<int>{1, 2, 3});
+        CHECK(stub.cmd_1 == std::vector<std::string>{"abc"});
+        CHECK(stub.cmd_3 == std::vector<std::pair<uint16_t, uint8_t>>{{0x4567, 0x89}});
+
+        const auto sources = server.sources();
+        REQUIRE(sources.size() == 1);
+        CHECK(sources[0].source == client.local_endpoint());
+        CHECK(sources[0].datagrams == 3);
+        CHECK(sources[0].packets == 3);
+        CHECK(sources[0].invalid_packets == 1);
+        CHECK(sources[0].truncated == 0);
+        CHECK(sources[0].bytes == 5 + packet_1.size() + packet_2.size() + broken.size() + 2 * packet_3.size());
+    }
+
+    SECTION("Batches and per-source statistics")
+    {
+        auto stub = BatchStub{};
+        auto server = tcp_server::UdpServer<BatchStub>{io_context, stub, 0, false, {.batch_size = 4}};
+        const auto destination = udp::endpoint{boost::asio::ip::make_address("127.0.0.1"), server.port()};
+        auto first = make_client(io_context);
+        auto second = make_client(io_context);
+        for (int i = 0; i < 10; i++)
+        {
+            first.send_to(boost::asio::buffer(packet_2 + packet_2), destination);
+            second.send_to(boost::asio::buffer(packet_3), destination);
+        }
+        receive(io_context, stub, 30);
+
+        CHECK(stub.call_sequence.size() == 30);
+        // Datagrams of a call are passed in one batch, so there are at least as many batches as calls.
+        CHECK(stub.batches >= 5);
+        CHECK(stub.batches < 20);
+        const auto sources = server.sources();
+        CHECK(sources.size() == 2);
+        CHECK(find_source(sources, first.local_endpoint().port()).packets == 20);
+        CHECK(find_source(sources, second.local_endpoint().port()).datagrams == 10);
+    }
+
+    SECTION("Sources beyond the limit are counted together")
+    {
+        auto stub = CommandHandlerStub{};
+        auto server = tcp_server::UdpServer<CommandHandlerStub>{io_context, stub, 0, false, {.max_sources = 1}};
+        const auto destination = udp::endpoint{boost::asio::ip::make_address("127.0.0.1"), server.port()};
+        auto first = make_client(io_context);
+        auto second = make_client(io_context);
+        auto third = make_client(io_context);
+        first.send_to(boost::asio::buffer(packet_2), destination);
+        receive(io_context, stub, 1);
+        second.send_to(boost::asio::buffer(packet_2), destination);
+        third.send_to(boost::asio::buffer(packet_2), destination);
+        receive(io_context, stub, 3);
+
+        const auto sources = server.sources();
+        CHECK(sources.size() == 2);
+        CHECK(find_source(sources, first.local_endpoint().port()).datagrams == 1);
+        CHECK(find_source(sources, 0).datagrams == 2);
+    }
+
+    SECTION("Truncated datagrams")
+    {
+        auto stub = CommandHandlerStub{};
+        auto server = tcp_server::UdpServer<CommandHandlerStub>{io_context, stub, 0, false, {.datagram_size = 12}};
+        const auto destination = udp::endpoint{boost::asio::ip::make_address("127.0.0.1"), server.port()};
+        auto client = make_client(io_context);
+        // Only the first packet fits into the buffer.
+        client.send_to(boost::asio::buffer(packet_2 + packet_2 + packet_2), destination);
+        receive(io_context, stub, 1);
+        io_context.poll();
+
+        CHECK(stub.call_sequence == std::vector<int>{2});
+        const auto sources = server.sources();
+        REQUIRE(sources.size() == 1);
+        CHECK(sources[0].truncated == 1);
+    }
+
+    SECTION("Stop")
+    {
+        auto stub = CommandHandlerStub{};
+        auto server = tcp_server::UdpServer<CommandHandlerStub>{io_context, stub, 0};
+        server.stop();
+        CHECK(io_context.run_for(std::chrono::seconds(1)) <= 1);
+        CHECK(io_context.stopped());
+    }
+
+    SECTION("Invalid options")
+    {
+        auto stub = CommandHandlerStub{};
+        using Server = tcp_server::UdpServer<CommandHandlerStub>;
+        CHECK_THROWS_AS((Server{io_context, stub, 0, false, {.batch_size = 0}}), std::invalid_argument);
+        CHECK_THROWS_AS((Server{io_context, stub, 0, false, {.batch_size = 1025}}), std::invalid_argument);
+        CHECK_THROWS_AS((Server{io_context, stub, 0, false, {.datagram_size = 0}}), std::invalid_argument);
+    }
+}
@@ -0,0 +1,46 @@
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <istream>
+
+#include <BinaryCommandReader.hpp>
+#include <CommandPrinter.hpp>
+
+// Converts the binary output of the server (--output-format binary) back to the text format, e.g. for debugging.
+int main(int argc, char* argv[])
+{
+    if (argc > 2 || (argc == 2 && (std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0)))
+    {
+        std::cerr << "Usage: " << argv[0] << " [file]\n"
+                  << "Prints the commands of a binary server output file, or of stdin, as text to stdout.\n";
+        return argc == 2 ? 0 : 1;
+    }
+    try
+    {
+        std::ifstream file;
+        if (argc == 2)
+        {
+            file.open(argv[1], std::ios::binary);
+            if (!file)
+            {
+                std::cerr << "Cannot open " << argv[1] << '\n';
+                return 1;
+            }
+        }
+        std::istream& input = argc == 2 ? file : std::cin;
+        std::ios::sync_with_stdio(false);
+        auto reader = BinaryCommandReader{input};
+        const auto printer = CommandPrinter{std::cout};
+        for (auto commands = reader.next(); !commands.empty(); commands = reader.next())
+        {
+            printer.handle_batch(commands);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
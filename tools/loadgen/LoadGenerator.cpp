@@ -0,0 +1,297 @@
+#include "LoadGenerator.hpp"
+
+#include <Crc16Arc.hpp>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <random>
+#include <span>
+
+using boost::asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+// A connection repeatedly sending pipeline batches. Kept alive by its pending handlers.
+class LoadGenerator::Connection : public std::enable_shared_from_this<Connection>
+{
+    LoadGenerator& generator_;
+    tcp::socket socket_;
+    boost::asio::steady_timer timer_;
+    std::mt19937 random_;
+    std::discrete_distribution<int> command_distribution_;
+    std::bernoulli_distribution corrupt_distribution_;
+    // Time between the batches of this connection if the rate is limited.
+    clock_type::duration interval_{};
+    clock_type::time_point next_batch_{};
+    // The current batch, its split into writes and the progress of writing it.
+    std::string batch_;
+    std::vector<std::size_t> writes_;
+    std::size_t write_index_ = 0;
+    std::size_t write_offset_ = 0;
+    uint64_t batch_valid_ = 0;
+    uint64_t batch_timestamped_ = 0;
+    uint64_t packets_since_connect_ = 0;
+
+public:
+    Connection(LoadGenerator& generator, boost::asio::io_context& io_context, std::size_t index) :
+        generator_{generator}, socket_{io_context}, timer_{io_context}, random_{static_cast<uint32_t>(index)},
+        command_distribution_{generator.options_.mix.begin(), generator.options_.mix.end()},
+        corrupt_distribution_{generator.options_.corrupt}
+    {
+        const auto& options = generator_.options_;
+        if (options.rate > 0)
+        {
+            const auto seconds = static_cast<double>(options.pipeline * options.connections) / options.rate;
+            interval_ = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(seconds));
+        }
+    }
+
+    void start()
+    {
+        // Spread the first batches of the connections over the interval to avoid synchronized bursts.
+        const auto offset = std::uniform_int_distribution<clock_type::rep>(0, interval_.count())(random_);
+        next_batch_ = clock_type::now() + offset * clock_type::duration(1);
+        connect();
+    }
+
+private:
+    [[nodiscard]] bool stopping() const { return generator_.stopping_.load(std::memory_order_relaxed); }
+
+    void connect()
+    {
+        boost::asio::async_connect(socket_, generator_.endpoints_,
+                                   [self = shared_from_this()](boost::system::error_code ec, const tcp::endpoint&)
+                                   {
+                                       if (ec)
+                                       {
+                                           self->fail();
+                                           return;
+                                       }
+                                       self->socket_.set_option(tcp::no_delay(true), ec);
+                                       self->generator_.stats_.connects.fetch_add(1, std::memory_order_relaxed);
+                                       self->packets_since_connect_ = 0;
+                                       self->schedule_batch();
+                                   });
+    }
+
+    // Closes the socket and tries again a bit later.
+    void fail()
+    {
+        generator_.stats_.errors.fetch_add(1, std::memory_order_relaxed);
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+        if (stopping())
+        {
+            return;
+        }
+        timer_.expires_after(std::chrono::milliseconds(100));
+        timer_.async_wait(
+            [self = shared_from_this()](const boost::system::error_code& ec)
+            {
+                if (!ec && !self->stopping())
+                {
+                    self->connect();
+                }
+            });
+    }
+
+    void schedule_batch()
+    {
+        if (stopping())
+        {
+            return;
+        }
+        if (interval_ == clock_type::duration::zero())
+        {
+            send_batch();
+            return;
+        }
+        // Do not try to catch up after long stalls, e.g. when the server did not read for a while.
+        next_batch_ = std::max(next_batch_, clock_type::now() - interval_);
+        timer_.expires_at(next_batch_);
+        next_batch_ += interval_;
+        timer_.async_wait(
+            [self = shared_from_this()](const boost::system::error_code& ec)
+            {
+                if (!ec)
+                {
+                    self->send_batch();
+                }
+            });
+    }
+
+    void send_batch()
+    {
+        build_batch();
+        split_batch();
+        write_index_ = 0;
+        write_offset_ = 0;
+        write_next();
+    }
+
+    void write_next()
+    {
+        if (write_index_ == writes_.size())
+        {
+            batch_written();
+            return;
+        }
+        const auto size = writes_[write_index_];
+        boost::asio::async_write(socket_, boost::asio::buffer(batch_.data() + write_offset_, size),
+                                 [self = shared_from_this(), size](boost::system::error_code ec, std::size_t)
+                                 {
+                                     if (ec)
+                                     {
+                                         self->fail();
+                                         return;
+                                     }
+                                     self->write_index_++;
+                                     self->write_offset_ += size;
+                                     self->write_next();
+                                 });
+    }
+
+    void batch_written()
+    {
+        const auto& options = generator_.options_;
+        auto& stats = generator_.stats_;
+        stats.packets.fetch_add(options.pipeline, std::memory_order_relaxed);
+        stats.bytes.fetch_add(batch_.size(), std::memory_order_relaxed);
+        stats.valid.fetch_add(batch_valid_, std::memory_order_relaxed);
+        stats.timestamped.fetch_add(batch_timestamped_, std::memory_order_relaxed);
+        packets_since_connect_ += options.pipeline;
+        if (options.churn > 0 && packets_since_connect_ >= options.churn)
+        {
+            boost::system::error_code ignored;
+            socket_.shutdown(tcp::socket::shutdown_send, ignored);
+            socket_.close(ignored);
+            if (!stopping())
+            {
+                connect();
+            }
+            return;
+        }
+        schedule_batch();
+    }
+
+    void build_batch()
+    {
+        batch_.clear();
+        writes_.clear();
+        batch_valid_ = 0;
+        batch_timestamped_ = 0;
+        const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch());
+        auto byte = [this] { return static_cast<char>(std::uniform_int_distribution<int>(0, 255)(random_)); };
+        for (std::size_t i = 0; i < generator_.options_.pipeline; i++)
+        {
+            const auto start = batch_.size();
+            const auto cmd_id = static_cast<uint16_t>(command_distribution_(random_) + 1);
+            const bool corrupt = corrupt_distribution_(random_);
+            batch_ += "CMD";
+            batch_ += static_cast<char>(cmd_id >> 8);
+            batch_ += static_cast<char>(cmd_id & 0xff);
+            switch (cmd_id)
+            {
+            case 1:
+            {
+                char timestamp[32] = "ts=";
+                const auto end = std::to_chars(timestamp + 3, std::end(timestamp), now.count()).ptr;
+                batch_ += static_cast<char>(end - timestamp);
+                batch_.append(timestamp, end);
+                batch_timestamped_ += corrupt ? 0 : 1;
+                break;
+            }
+            case 2:
+                batch_ += byte();
+                break;
+            default:
+                batch_ += byte();
+                batch_ += byte();
+                batch_ += byte();
+                break;
+            }
+            auto crc = Crc16Arc::update(0, std::span(batch_).subspan(start + 3));
+            if (corrupt)
+            {
+                crc ^= 0xa5a5;
+            }
+            else
+            {
+                batch_valid_++;
+            }
+            batch_ += static_cast<char>(crc >> 8);
+            batch_ += static_cast<char>(crc & 0xff);
+            writes_.push_back(batch_.size() - start); // packet sizes, used for Mode::packet
+        }
+    }
+
+    // Replaces the packet sizes in writes_ with the sizes of the socket writes.
+    void split_batch()
+    {
+        const auto& fragmentation = generator_.options_.fragmentation;
+        auto split = [this](auto next_size)
+        {
+            writes_.clear();
+            for (std::size_t offset = 0; offset < batch_.size();)
+            {
+                const auto size = std::min(next_size(), batch_.size() - offset);
+                writes_.push_back(size);
+                offset += size;
+            }
+        };
+        switch (fragmentation.mode)
+        {
+        case Fragmentation::Mode::none:
+            writes_.assign(1, batch_.size());
+            break;
+        case Fragmentation::Mode::packet:
+            break;
+        case Fragmentation::Mode::fixed:
+            split([&fragmentation] { return fragmentation.size; });
+            break;
+        case Fragmentation::Mode::random:
+            split(
+                [this, &fragmentation]
+                { return std::uniform_int_distribution<std::size_t>(1, fragmentation.size)(random_); });
+            break;
+        }
+    }
+};
+
+LoadGenerator::LoadGenerator(const LoadOptions& options, unsigned int threads) : options_{options}
+{
+    boost::asio::io_context io_context;
+    tcp::resolver resolver(io_context);
+    endpoints_ = resolver.resolve(options_.host, std::to_string(options_.port));
+    for (unsigned int i = 0; i < std::max(1u, threads); i++)
+    {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+}
+
+LoadGenerator::~LoadGenerator() { stop(); }
+
+void LoadGenerator::start()
+{
+    for (std::size_t i = 0; i < options_.connections; i++)
+    {
+        auto& worker = *workers_[i % workers_.size()];
+        std::make_shared<Connection>(*this, worker.io_context, i)->start();
+    }
+    for (auto& worker : workers_)
+    {
+        worker->thread = std::jthread([&io_context = worker->io_context] { io_context.run(); });
+    }
+}
+
+void LoadGenerator::stop()
+{
+    stopping_ = true;
+    for (auto& worker : workers_)
+    {
+        worker->io_context.stop();
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How the data of a pipeline batch is split into socket writes.
+struct Fragmentation
+{
+    enum class Mode
+    {
+        none,   // the whole batch in one write
+        packet, // one write per packet
+        fixed,  // writes of `size` bytes regardless of the packet boundaries
+        random, // writes of 1..`size` bytes
+    };
+
+    Mode mode = Mode::none;
+    std::size_t size = 0;
+};
+
+// What the generated traffic looks like.
+struct LoadOptions
+{
+    std::string host = "127.0.0.1";
+    uint16_t port = 12345;
+    // Number of concurrent connections, distributed over the threads.
+    std::size_t connections = 100;
+    // Relative weights of the command ids 1, 2 and 3.
+    std::array<double, 3> mix{1, 1, 1};
+    // Number of packets a connection writes before waiting for the next batch.
+    std::size_t pipeline = 16;
+    Fragmentation fragmentation{};
+    // Total packet rate of all the connections in packets per second, 0 for as fast as possible.
+    double rate = 0;
+    // A connection is closed and opened again after this many packets, 0 to keep it open.
+    uint64_t churn = 0;
+    // Probability of a packet to carry a wrong checksum.
+    double corrupt = 0;
+};
+
+/**
+ * Sends generated packets to a server over many concurrent connections.
+ *
+ * Every thread runs its own io_context with a share of the connections. A connection repeatedly builds a pipeline
+ * batch of random packets, writes it (in fragments if requested) and starts the next batch once the previous one was
+ * written, optionally paced to the requested total rate. Valid command 1 packets carry "ts=<nanoseconds>" with the
+ * steady clock time of the batch creation, so the latency can be measured on the server output (see OutputMatcher).
+ *
+ * The counters are updated by the generator threads and may be read from any thread while the generator runs.
+ */
+class LoadGenerator
+{
+public:
+    struct Stats
+    {
+        // Packets and bytes completely written to the sockets.
+        std::atomic<uint64_t> packets{0};
+        std::atomic<uint64_t> bytes{0};
+        // Written packets with a correct checksum, i.e. the expected number of server output lines.
+        std::atomic<uint64_t> valid{0};
+        // Written valid command 1 packets, i.e. the expected number of latency samples.
+        std::atomic<uint64_t> timestamped{0};
+        // Established connections, including the reconnects caused by churn or errors.
+        std::atomic<uint64_t> connects{0};
+        // Failed connection attempts and writes. The connection is retried after a short delay.
+        std::atomic<uint64_t> errors{0};
+    };
+
+    /**
+     * Resolves the server address. Nothing is sent before start().
+     *
+     * @param options traffic description
+     * @param threads number of generator threads
+     */
+    LoadGenerator(const LoadOptions& options, unsigned int threads);
+    ~LoadGenerator();
+
+    LoadGenerator(const LoadGenerator&) = delete;
+    LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+    // Opens the connections and starts sending.
+    void start();
+
+    // Stops sending and closes the connections. Batches that are being written are abandoned.
+    void stop();
+
+    [[nodiscard]] const Stats& stats() const { return stats_; }
+
+private:
+    class Connection;
+
+    // A thread with an io_context serving a share of the connections.
+    struct Worker
+    {
+        boost::asio::io_context io_context{1};
+        std::jthread thread;
+    };
+
+    LoadOptions options_;
+    boost::asio::ip::tcp::resolver::results_type endpoints_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    Stats stats_;
+    std::atomic<bool> stopping_{false};
+};
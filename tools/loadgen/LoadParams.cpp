@@ -0,0 +1,120 @@
+#include "LoadParams.hpp"
+
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <charconv>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace po = boost::program_options;
+
+// Parses "w1,w2,w3" command weights.
+static std::optional<std::array<double, 3>> parse_mix(std::string_view text)
+{
+    std::array<double, 3> mix{};
+    double total = 0;
+    for (std::size_t i = 0; i < mix.size(); i++)
+    {
+        const auto separator = std::min(text.find(','), text.size());
+        const auto [end, ec] = std::from_chars(text.data(), text.data() + separator, mix[i]);
+        if (ec != std::errc() || end != text.data() + separator || mix[i] < 0)
+        {
+            return std::nullopt;
+        }
+        total += mix[i];
+        text.remove_prefix(std::min(separator + 1, text.size()));
+    }
+    return text.empty() && total > 0 ? std::optional(mix) : std::nullopt;
+}
+
+// Parses none, packet, random or a number of bytes.
+static std::optional<Fragmentation> parse_fragmentation(const std::string& text)
+{
+    constexpr std::size_t max_random_size = 64;
+    if (text == "none")
+    {
+        return Fragmentation{Fragmentation::Mode::none};
+    }
+    if (text == "packet")
+    {
+        return Fragmentation{Fragmentation::Mode::packet};
+    }
+    if (text == "random")
+    {
+        return Fragmentation{Fragmentation::Mode::random, max_random_size};
+    }
+    std::size_t size = 0;
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), size);
+    if (ec != std::errc() || end != text.data() + text.size() || size == 0)
+    {
+        return std::nullopt;
+    }
+    return Fragmentation{Fragmentation::Mode::fixed, size};
+}
+
+LoadParams::LoadParams(int argc, char* argv[])
+{
+    int port = load.port;
+    int connections = static_cast<int>(load.connections);
+    int pipeline = static_cast<int>(load.pipeline);
+    int64_t churn = 0;
+    std::string mix = "1,1,1";
+    std::string fragment = "none";
+
+    // Define options and provide help text
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "Show help message")
+        ("host", po::value<std::string>(&load.host), "Server address. 127.0.0.1 by default.")
+        ("port,p", po::value<int>(&port), "Server port. 12345 by default.")
+        ("connections,c", po::value<int>(&connections), "Number of concurrent connections. 100 by default.")
+        ("threads,t", po::value<int>(&threads), "Number of generator threads. 1 by default.")
+        ("duration,d", po::value<double>(&duration), "Test duration in seconds. 10 by default.")
+        ("rate,r", po::value<double>(&load.rate), "Total packet rate limit in packets per second. Unlimited by "
+                                                  "default.")
+        ("mix", po::value<std::string>(&mix), "Relative weights of the command ids 1, 2 and 3. 1,1,1 by default.")
+        ("pipeline", po::value<int>(&pipeline), "Number of packets a connection writes at once. 16 by default.")
+        ("fragment", po::value<std::string>(&fragment), "How the packets are split into writes: none (one write per "
+                                                        "pipeline batch), packet, random (1..64 bytes) or a number "
+                                                        "of bytes. none by default.")
+        ("churn", po::value<int64_t>(&churn), "Reconnect after this many packets. Never by default.")
+        ("corrupt", po::value<double>(&load.corrupt), "Share of packets with a wrong checksum (0..1). 0 by default.")
+        ("latency", po::bool_switch(&latency), "Read the server output from stdin and measure the latency of the "
+                                               "timestamped command 1 packets, e.g. server | loadgen --latency.")
+        ("drain", po::value<int>(&drain), "Time in milliseconds to wait for the remaining server output after the "
+                                          "test. 1000 by default.")
+        ("json", po::bool_switch(&json), "Print the summary as JSON.");
+
+    // Parse command line
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    // Handle help request
+    if (vm.contains("help"))
+    {
+        std::cout << desc << '\n';
+        no_run = true;
+    }
+
+    const auto parsed_mix = parse_mix(mix);
+    const auto parsed_fragmentation = parse_fragmentation(fragment);
+    if (port < 1 || port > 65535 || connections < 1 || threads < 1 || duration <= 0 || load.rate < 0 ||
+        pipeline < 1 || churn < 0 || load.corrupt < 0 || load.corrupt > 1 || drain < 0 || !parsed_mix ||
+        !parsed_fragmentation)
+    {
+        std::cerr << "Error: Invalid parameters.\n";
+        std::cerr << desc << '\n';
+        no_run = true;
+        invalid = true;
+        return;
+    }
+    load.port = static_cast<uint16_t>(port);
+    load.connections = static_cast<std::size_t>(connections);
+    load.pipeline = static_cast<std::size_t>(pipeline);
+    load.churn = static_cast<uint64_t>(churn);
+    load.mix = *parsed_mix;
+    load.fragmentation = *parsed_fragmentation;
+}
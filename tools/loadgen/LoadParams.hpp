@@ -0,0 +1,33 @@
+#pragma once
+#include "LoadGenerator.hpp"
+
+/**
+ * Command line options of the load generator.
+ */
+struct LoadParams
+{
+    /**
+     * Parses the provided options into member variables.
+     * Prints help message or parameter validation errors if necessary.
+     *
+     * @param argc from main function
+     * @param argv from main function
+     */
+    LoadParams(int argc, char* argv[]);
+    // What to send and where.
+    LoadOptions load{};
+    // Number of generator threads.
+    int threads{1};
+    // Test duration in seconds.
+    double duration{10};
+    // true if the server output should be read from stdin to measure the latency.
+    bool latency{};
+    // Time in milliseconds to wait for the remaining server output after the test.
+    int drain{1000};
+    // true if the summary should be printed as JSON.
+    bool json{};
+    // true if the program should terminate after parsing the command line options.
+    bool no_run{};
+    // true if parameter validation error was encountered.
+    bool invalid{};
+};
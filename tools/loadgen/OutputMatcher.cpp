@@ -0,0 +1,76 @@
+#include "OutputMatcher.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <poll.h>
+#include <unistd.h>
+
+OutputMatcher::OutputMatcher(int fd) :
+    fd_{fd},
+    start_{std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+               .count()}
+{
+    thread_ = std::jthread([this] { run_(); });
+}
+
+OutputMatcher::~OutputMatcher() { stop(); }
+
+void OutputMatcher::stop()
+{
+    stopping_ = true;
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void OutputMatcher::run_()
+{
+    char buffer[64 * 1024];
+    while (!stopping_)
+    {
+        // Wake up regularly to notice stop().
+        pollfd poll_fd{fd_, POLLIN, 0};
+        const int ready = ::poll(&poll_fd, 1, 50);
+        if (ready <= 0)
+        {
+            continue;
+        }
+        const auto size = ::read(fd_, buffer, sizeof(buffer));
+        if (size <= 0)
+        {
+            return; // the server has exited
+        }
+        // The lines of a read arrived together, one timestamp is enough.
+        const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now().time_since_epoch())
+                             .count();
+        pending_.append(buffer, static_cast<std::size_t>(size));
+        std::size_t begin = 0;
+        for (auto end = pending_.find('\n'); end != std::string::npos; end = pending_.find('\n', begin))
+        {
+            process_(std::string_view(pending_).substr(begin, end - begin), now);
+            begin = end + 1;
+        }
+        pending_.erase(0, begin);
+    }
+}
+
+void OutputMatcher::process_(std::string_view line, int64_t now)
+{
+    lines_.fetch_add(1, std::memory_order_relaxed);
+    constexpr std::string_view prefix = "0x0001 ts=";
+    if (!line.starts_with(prefix))
+    {
+        return;
+    }
+    int64_t sent = 0;
+    const auto [end, ec] = std::from_chars(line.data() + prefix.size(), line.data() + line.size(), sent);
+    if (ec != std::errc() || end != line.data() + line.size() || sent < start_)
+    {
+        return; // a command 1 packet from another client or an earlier run
+    }
+    histogram_.record(static_cast<uint64_t>(std::max<int64_t>(0, now - sent)));
+    samples_.fetch_add(1, std::memory_order_relaxed);
+}
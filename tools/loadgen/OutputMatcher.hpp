@@ -0,0 +1,56 @@
+#pragma once
+#include <LatencyHistogram.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * Reads the server output and measures the send-to-output latency of the timestamped command 1 packets.
+ *
+ * Every "0x0001 ts=<nanoseconds>" line is matched against the current steady clock time, so the server and the load
+ * generator must run on the same host. Lines timestamped before the matcher was created come from an earlier run and
+ * are left out. The latency includes the output batching of the server, run it with a short --flush-interval to
+ * measure the processing itself.
+ */
+class OutputMatcher
+{
+    int fd_;
+    // Steady clock time of the creation in nanoseconds.
+    int64_t start_;
+    std::string pending_;
+    LatencyHistogram histogram_;
+    std::atomic<uint64_t> lines_{0};
+    std::atomic<uint64_t> samples_{0};
+    std::atomic<bool> stopping_{false};
+    std::jthread thread_;
+
+    void run_();
+    // Records the latency if the line is a timestamped command 1. `now` is the steady clock time in nanoseconds.
+    void process_(std::string_view line, int64_t now);
+
+public:
+    /**
+     * Starts reading the file descriptor on a background thread.
+     *
+     * @param fd readable file descriptor with the server output, e.g. STDIN_FILENO.
+     */
+    explicit OutputMatcher(int fd);
+    ~OutputMatcher();
+
+    OutputMatcher(const OutputMatcher&) = delete;
+    OutputMatcher& operator=(const OutputMatcher&) = delete;
+
+    // Stops reading. Must be called before accessing the histogram.
+    void stop();
+
+    // Number of output lines read so far.
+    [[nodiscard]] uint64_t lines() const { return lines_.load(std::memory_order_relaxed); }
+
+    // Number of latency samples recorded so far, i.e. of the timestamped packets of this run found in the output.
+    [[nodiscard]] uint64_t samples() const { return samples_.load(std::memory_order_relaxed); }
+
+    // Latencies in nanoseconds. Only valid after stop().
+    [[nodiscard]] const LatencyHistogram& histogram() const { return histogram_; }
+};
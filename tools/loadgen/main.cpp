@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+
+#include "LoadGenerator.hpp"
+#include "LoadParams.hpp"
+#include "OutputMatcher.hpp"
+
+using std::chrono::steady_clock;
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+// Every connection needs a file descriptor, the default soft limit is often 1024.
+static void raise_file_limit(std::size_t connections)
+{
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    {
+        return;
+    }
+    const auto needed = static_cast<rlim_t>(connections + 64);
+    if (limit.rlim_cur < needed)
+    {
+        limit.rlim_cur = std::min(needed, limit.rlim_max);
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+        if (limit.rlim_cur < needed)
+        {
+            std::cerr << "Warning: the open file limit " << limit.rlim_cur << " is too low for " << connections
+                      << " connections\n";
+        }
+    }
+}
+
+// Final numbers of a run.
+struct Summary
+{
+    double seconds;
+    const LoadGenerator::Stats& stats;
+    const OutputMatcher* matcher;
+
+    [[nodiscard]] double rate(uint64_t value) const { return static_cast<double>(value) / seconds; }
+
+    // Share of the valid timestamped packets that appeared in the server output. Only those lines can be told apart
+    // from the output of other clients, so the share of the other commands is not known. Packets are counted once
+    // their whole batch is written, the delivered part of a batch cut off by the end of the run is left out.
+    [[nodiscard]] double delivery() const
+    {
+        const auto timestamped = stats.timestamped.load();
+        const auto delivered = std::min(matcher->samples(), timestamped);
+        return timestamped > 0 ? static_cast<double>(delivered) / static_cast<double>(timestamped) : 0.0;
+    }
+
+    [[nodiscard]] double microseconds(uint64_t nanoseconds) const { return static_cast<double>(nanoseconds) / 1e3; }
+
+    void print_text(std::ostream& out) const
+    {
+        out << std::fixed << std::setprecision(1);
+        out << "Duration:     " << seconds << " s\n";
+        out << "Connects:     " << stats.connects << ", errors: " << stats.errors << '\n';
+        out << "Packets:      " << stats.packets << " (" << rate(stats.packets) << "/s), valid: " << stats.valid
+            << '\n';
+        out << "Bytes:        " << stats.bytes << " (" << rate(stats.bytes) / 1e6 << " MB/s)\n";
+        if (matcher == nullptr)
+        {
+            return;
+        }
+        const auto& histogram = matcher->histogram();
+        out << "Output lines: " << matcher->lines() << ", " << delivery() * 100
+            << "% of the timestamped packets delivered\n";
+        out << "Latency (us): samples " << histogram.count() << " of " << stats.timestamped << ", mean "
+            << histogram.mean() / 1e3 << ", p50 " << microseconds(histogram.percentile(50)) << ", p90 "
+            << microseconds(histogram.percentile(90)) << ", p99 " << microseconds(histogram.percentile(99))
+            << ", p99.9 " << microseconds(histogram.percentile(99.9)) << ", max " << microseconds(histogram.max())
+            << '\n';
+    }
+
+    void print_json(std::ostream& out) const
+    {
+        out << std::fixed << std::setprecision(3);
+        out << "{\n";
+        out << "  \"seconds\": " << seconds << ",\n";
+        out << "  \"connects\": " << stats.connects << ",\n";
+        out << "  \"errors\": " << stats.errors << ",\n";
+        out << "  \"packets\": " << stats.packets << ",\n";
+        out << "  \"packets_per_second\": " << rate(stats.packets) << ",\n";
+        out << "  \"valid_packets\": " << stats.valid << ",\n";
+        out << "  \"bytes\": " << stats.bytes << ",\n";
+        out << "  \"bytes_per_second\": " << rate(stats.bytes);
+        if (matcher != nullptr)
+        {
+            const auto& histogram = matcher->histogram();
+            out << ",\n";
+            out << "  \"output_lines\": " << matcher->lines() << ",\n";
+            out << "  \"delivery\": " << delivery() << ",\n";
+            out << "  \"latency_us\": {\"samples\": " << histogram.count() << ", \"expected\": " << stats.timestamped
+                << ", \"mean\": " << histogram.mean() / 1e3 << ", \"p50\": " << microseconds(histogram.percentile(50))
+                << ", \"p90\": " << microseconds(histogram.percentile(90))
+                << ", \"p99\": " << microseconds(histogram.percentile(99))
+                << ", \"p99_9\": " << microseconds(histogram.percentile(99.9))
+                << ", \"max\": " << microseconds(histogram.max()) << "}";
+        }
+        out << "\n}\n";
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const auto params = LoadParams(argc, argv);
+        if (params.no_run)
+        {
+            return params.invalid ? 1 : 0;
+        }
+        raise_file_limit(params.load.connections);
+        std::signal(SIGINT, [](int) { interrupted = 1; });
+        // Writes to a connection closed by the server must fail instead of killing the process.
+        std::signal(SIGPIPE, SIG_IGN);
+
+        std::unique_ptr<OutputMatcher> matcher;
+        if (params.latency)
+        {
+            matcher = std::make_unique<OutputMatcher>(STDIN_FILENO);
+        }
+        LoadGenerator generator(params.load, static_cast<unsigned int>(params.threads));
+        const auto& stats = generator.stats();
+
+        // Progress goes to stderr once a second, stdout is reserved for the summary.
+        const auto start = steady_clock::now();
+        const auto end = start + std::chrono::duration_cast<steady_clock::duration>(
+                                     std::chrono::duration<double>(params.duration));
+        generator.start();
+        auto next_report = start + std::chrono::seconds(1);
+        uint64_t reported_packets = 0;
+        while (!interrupted && steady_clock::now() < end)
+        {
+            std::this_thread::sleep_until(std::min(next_report, end));
+            if (steady_clock::now() >= next_report)
+            {
+                const auto packets = stats.packets.load();
+                std::cerr << "packets/s: " << packets - reported_packets << ", connects: " << stats.connects
+                          << ", errors: " << stats.errors;
+                if (matcher)
+                {
+                    std::cerr << ", output lines: " << matcher->lines();
+                }
+                std::cerr << '\n';
+                reported_packets = packets;
+                next_report += std::chrono::seconds(1);
+            }
+        }
+        generator.stop();
+        const auto seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+        // Wait for the output of the last packets.
+        if (matcher)
+        {
+            const auto drain_end = steady_clock::now() + std::chrono::milliseconds(params.drain);
+            while (!interrupted && matcher->samples() < stats.timestamped && steady_clock::now() < drain_end)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            matcher->stop();
+        }
+
+        const auto summary = Summary{seconds, stats, matcher.get()};
+        if (params.json)
+        {
+            summary.print_json(std::cout);
+        }
+        else
+        {
+            summary.print_text(std::cout);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}